@@ -40,12 +40,26 @@
 #include <time.h>
 
 #include "calcurse.h"
-#include "sha1.h"
 
 #define APPT_TIME_LENGTH 25
 
 llist_ts_t alist_p;
 
+/*
+ * Interval index over alist_p: the appointments sorted by start time,
+ * together with the running maximum of their end times. It is rebuilt
+ * lazily after the list has been modified. As readers share the list lock,
+ * the rebuild is done under a mutex of its own.
+ */
+static struct {
+	struct apoint **apt;
+	time_t *maxend;
+	unsigned count;
+	unsigned size;
+	int valid;
+} apoint_index;
+static pthread_mutex_t apoint_index_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 void apoint_free(struct apoint *apt)
 {
 	mem_free(apt->mesg);
@@ -66,6 +80,7 @@ struct apoint *apoint_dup(struct apoint *in)
 		apt->note = mem_strdup(in->note);
 	else
 		apt->note = NULL;
+	apt->digest.valid = 0;
 
 	return apt;
 }
@@ -73,6 +88,7 @@ struct apoint *apoint_dup(struct apoint *in)
 void apoint_llist_init(void)
 {
 	LLIST_TS_INIT(&alist_p);
+	apoint_index.valid = 0;
 }
 
 /*
@@ -84,6 +100,15 @@ void apoint_llist_free(void)
 {
 	LLIST_TS_FREE_INNER(&alist_p, apoint_free);
 	LLIST_TS_FREE(&alist_p);
+
+	if (apoint_index.apt) {
+		mem_free(apoint_index.apt);
+		mem_free(apoint_index.maxend);
+	}
+	apoint_index.apt = NULL;
+	apoint_index.maxend = NULL;
+	apoint_index.count = apoint_index.size = 0;
+	apoint_index.valid = 0;
 }
 
 static int apoint_cmp(struct apoint *a, struct apoint *b)
@@ -100,8 +125,126 @@ static int apoint_cmp(struct apoint *a, struct apoint *b)
 	return strcmp(a->mesg, b->mesg);
 }
 
-struct apoint *apoint_new(char *mesg, char *note, time_t start, long dur,
-			  char state)
+/* Sort a list of appointments once all items of a bulk load were appended. */
+void apoint_llist_sort(llist_t *l)
+{
+	LLIST_SORT(l, apoint_cmp);
+}
+
+/* Merge n sorted lists of appointments into the appointment list. */
+void apoint_llist_merge(llist_t *lists, unsigned n)
+{
+	LLIST_TS_LOCK(&alist_p);
+	LLIST_TS_MERGE(&alist_p, lists, n, apoint_cmp);
+	apoint_index.valid = 0;
+	LLIST_TS_UNLOCK(&alist_p);
+}
+
+/* Move an appointment whose start time was changed to its new position. */
+void apoint_reorder(struct apoint *apt)
+{
+	LLIST_TS_LOCK(&alist_p);
+	LLIST_TS_REORDER(&alist_p, apt, apoint_cmp);
+	apoint_index.valid = 0;
+	LLIST_TS_UNLOCK(&alist_p);
+}
+
+/* Last second an appointment belongs to (see apoint_inday()). */
+static time_t apoint_end(struct apoint *apt)
+{
+	return apt->dur > 0 ? apt->start + apt->dur - 1 : apt->start;
+}
+
+static int apoint_start_cmp(struct apoint **a, struct apoint **b)
+{
+	return (*a)->start < (*b)->start ? -1 : ((*a)->start > (*b)->start);
+}
+
+static void apoint_index_build(void)
+{
+	llist_item_t *i;
+	unsigned n = 0, sorted = 1;
+
+	LLIST_TS_FOREACH(&alist_p, i)
+		n++;
+	if (n > apoint_index.size) {
+		if (apoint_index.apt) {
+			mem_free(apoint_index.apt);
+			mem_free(apoint_index.maxend);
+		}
+		apoint_index.size = 2 * n;
+		apoint_index.apt = mem_malloc(apoint_index.size *
+					      sizeof(struct apoint *));
+		apoint_index.maxend = mem_malloc(apoint_index.size *
+						 sizeof(time_t));
+	}
+	apoint_index.count = n;
+
+	n = 0;
+	LLIST_TS_FOREACH(&alist_p, i) {
+		apoint_index.apt[n] = LLIST_TS_GET_DATA(i);
+		if (n > 0 && apoint_index.apt[n]->start <
+		    apoint_index.apt[n - 1]->start)
+			sorted = 0;
+		n++;
+	}
+	if (!sorted)
+		qsort(apoint_index.apt, n, sizeof(struct apoint *),
+		      (int (*)(const void *, const void *))apoint_start_cmp);
+
+	for (n = 0; n < apoint_index.count; n++) {
+		apoint_index.maxend[n] = apoint_end(apoint_index.apt[n]);
+		if (n > 0 && apoint_index.maxend[n - 1] > apoint_index.maxend[n])
+			apoint_index.maxend[n] = apoint_index.maxend[n - 1];
+	}
+	apoint_index.valid = 1;
+}
+
+/*
+ * Find the appointments that may overlap the period [start, end]. On return,
+ * *apts points to the first of the returned number of candidates, which are
+ * sorted by start time. Candidates still have to be checked against the
+ * period, e.g. with apoint_inday(). The result is only valid as long as the
+ * alist_p lock, which must be held by the caller, is not released.
+ */
+unsigned apoint_find_range(time_t start, time_t end, struct apoint ***apts)
+{
+	unsigned lo, hi, l, h, m;
+
+	pthread_mutex_lock(&apoint_index_mutex);
+	if (!apoint_index.valid)
+		apoint_index_build();
+	pthread_mutex_unlock(&apoint_index_mutex);
+
+	/* First candidate: the running maximum of end times reaches start. */
+	l = 0;
+	h = apoint_index.count;
+	while (l < h) {
+		m = l + (h - l) / 2;
+		if (apoint_index.maxend[m] < start)
+			l = m + 1;
+		else
+			h = m;
+	}
+	lo = l;
+
+	/* Last candidate: the last appointment starting no later than end. */
+	h = apoint_index.count;
+	while (l < h) {
+		m = l + (h - l) / 2;
+		if (apoint_index.apt[m]->start <= end)
+			l = m + 1;
+		else
+			h = m;
+	}
+	hi = l;
+
+	*apts = apoint_index.apt + lo;
+	return hi - lo;
+}
+
+struct apoint *apoint_alloc(char *mesg, char *note, time_t start, long dur,
+			    char state)
 {
 	struct apoint *apt;
 
@@ -111,9 +254,19 @@ struct apoint *apoint_new(char *mesg, char *note, time_t start, long dur,
 	apt->state = state;
 	apt->start = start;
 	apt->dur = dur;
+	apt->digest.valid = 0;
+
+	return apt;
+}
+
+struct apoint *apoint_new(char *mesg, char *note, time_t start, long dur,
+			  char state)
+{
+	struct apoint *apt = apoint_alloc(mesg, note, start, dur, state);
 
 	LLIST_TS_LOCK(&alist_p);
 	LLIST_TS_ADD_SORTED(&alist_p, apt, apoint_cmp);
+	apoint_index.valid = 0;
 	LLIST_TS_UNLOCK(&alist_p);
 
 	return apt;
@@ -147,45 +300,60 @@ void apoint_sec2str(struct apoint *o, time_t day, char *start, char *end)
 	}
 }
 
-char *apoint_tostr(struct apoint *o)
+/* Append the start or end of an appointment, "mm/dd/yyyy @ hh:mm". */
+void apoint_append_time(struct string *s, time_t t)
 {
-	struct string s;
 	struct tm lt;
-	time_t t;
-
-	string_init(&s);
 
-	t = o->start;
-	localtime_r(&t, &lt);
-	string_catf(&s, "%02u/%02u/%04u @ %02u:%02u", lt.tm_mon + 1,
-		lt.tm_mday, 1900 + lt.tm_year, lt.tm_hour, lt.tm_min);
+	date_localtime(&t, &lt);
+	string_catdate(s, &lt);
+	string_cat(s, " @ ");
+	string_catnum(s, lt.tm_hour, 2);
+	string_catc(s, ':');
+	string_catnum(s, lt.tm_min, 2);
+}
 
-	t = o->start + o->dur;
-	localtime_r(&t, &lt);
-	string_catf(&s, " -> %02u/%02u/%04u @ %02u:%02u", lt.tm_mon + 1,
-		lt.tm_mday, 1900 + lt.tm_year, lt.tm_hour, lt.tm_min);
+/* Append an appointment in the format of the data file. */
+void apoint_append(struct string *s, struct apoint *o)
+{
+	apoint_append_time(s, o->start);
+	string_cat(s, " -> ");
+	apoint_append_time(s, o->start + o->dur);
+
+	if (o->note) {
+		string_catc(s, '>');
+		string_cat(s, o->note);
+		string_catc(s, ' ');
+	}
 
-	if (o->note)
-		string_catf(&s, ">%s ", o->note);
+	string_catc(s, (o->state & APOINT_NOTIFY) ? '!' : '|');
+	string_cat(s, o->mesg);
+}
 
-	if (o->state & APOINT_NOTIFY)
-		string_catf(&s, "%c", '!');
-	else
-		string_catf(&s, "%c", '|');
+char *apoint_tostr(struct apoint *o)
+{
+	struct string s;
 
-	string_catf(&s, "%s", o->mesg);
+	string_init(&s);
+	apoint_append(&s, o);
 
 	return string_buf(&s);
 }
 
-char *apoint_hash(struct apoint *apt)
+/* Return the digest of an appointment, computing it on first use. */
+static struct item_digest *apoint_digest(struct apoint *apt)
 {
-	char *raw = apoint_tostr(apt);
-	char *sha1 = mem_malloc(SHA1_DIGESTLEN * 2 + 1);
-	sha1_digest(raw, sha1);
-	mem_free(raw);
+	if (!apt->digest.valid) {
+		char *raw = apoint_tostr(apt);
+		item_digest_compute(&apt->digest, raw);
+	}
 
-	return sha1;
+	return &apt->digest;
+}
+
+char *apoint_hash(struct apoint *apt)
+{
+	return item_digest_hex(apoint_digest(apt));
 }
 
 void apoint_write(struct apoint *o, FILE * f)
@@ -195,13 +363,11 @@ void apoint_write(struct apoint *o, FILE * f)
 	mem_free(str);
 }
 
-char *apoint_scan(FILE * f, struct tm start, struct tm end,
-			   char state, char *note, struct item_filter *filter)
+/* Load an appointment from file, or only check it if l is NULL. */
+char *apoint_scan(llist_t *l, char *mesg, struct tm start, struct tm end,
+			   char state, char *note)
 {
-	char buf[BUFSIZ], *newline;
 	time_t tstart, tend;
-	struct apoint *apt = NULL;
-	int cond;
 
 	if (!check_date(start.tm_year, start.tm_mon, start.tm_mday) ||
 	    !check_date(end.tm_year, end.tm_mon, end.tm_mday) ||
@@ -209,14 +375,6 @@ char *apoint_scan(FILE * f, struct tm start, struct tm end,
 	    !check_time(end.tm_hour, end.tm_min))
 		return _("illegal date in appointment");
 
-	/* Read the appointment description */
-	if (!fgets(buf, sizeof buf, f))
-		return _("error in appointment description");
-
-	newline = strchr(buf, '\n');
-	if (newline)
-		*newline = '\0';
-
 	start.tm_sec = end.tm_sec = 0;
 	start.tm_isdst = end.tm_isdst = -1;
 	start.tm_year -= 1900;
@@ -224,38 +382,53 @@ char *apoint_scan(FILE * f, struct tm start, struct tm end,
 	end.tm_year -= 1900;
 	end.tm_mon--;
 
-	tstart = mktime(&start);
-	tend = mktime(&end);
+	tstart = date_mktime(&start);
+	tend = date_mktime(&end);
 	if (tstart == -1 || tend == -1 || tstart > tend)
 		return _("date error in appointment");
 
-	/* Filter item. */
-	if (filter) {
-		cond = (
-		    !(filter->type_mask & TYPE_MASK_APPT) ||
-		    (filter->regex && regexec(filter->regex, buf, 0, 0, 0)) ||
-		    (filter->start_from != -1 && tstart < filter->start_from) ||
-		    (filter->start_to != -1 && tstart > filter->start_to) ||
-		    (filter->end_from != -1 && tend < filter->end_from) ||
-		    (filter->end_to != -1 && tend > filter->end_to)
-		);
-		if (filter->hash) {
-			apt = apoint_new(
-				buf, note, tstart, tend - tstart, state);
-			char *hash = apoint_hash(apt);
-			cond = cond || !hash_matches(filter->hash, hash);
-			mem_free(hash);
-		}
+	/* Appended unsorted, see apoint_llist_merge(). */
+	if (l)
+		LLIST_ADD(l, apoint_alloc(mesg, note, tstart, tend - tstart,
+					  state));
+	return NULL;
+}
 
-		if ((!filter->invert && cond) || (filter->invert && !cond)) {
-			if (filter->hash)
-				apoint_delete(apt);
-			return NULL;
-		}
+/* Check whether an appointment is selected by a filter. */
+static int apoint_filter_match(struct apoint *apt, struct item_filter *filter)
+{
+	time_t tstart = apt->start, tend = apt->start + apt->dur;
+	int cond;
+
+	cond = (
+	    !(filter->type_mask & TYPE_MASK_APPT) ||
+	    (filter->regex && regexec(filter->regex, apt->mesg, 0, 0, 0)) ||
+	    (filter->start_from != -1 && tstart < filter->start_from) ||
+	    (filter->start_to != -1 && tstart > filter->start_to) ||
+	    (filter->end_from != -1 && tend < filter->end_from) ||
+	    (filter->end_to != -1 && tend > filter->end_to)
+	);
+	if (filter->hash) {
+		cond = cond ||
+		    !item_digest_matches(filter->hash, apoint_digest(apt));
 	}
-	if (!apt)
-		apt = apoint_new(buf, note, tstart, tend - tstart, state);
-	return NULL;
+
+	return filter->invert ? cond : !cond;
+}
+
+/* Drop the appointments for which fn_match() returns false. */
+void apoint_llist_keep(void *data, llist_fn_match_t fn_match)
+{
+	LLIST_TS_LOCK(&alist_p);
+	LLIST_TS_FILTER(&alist_p, data, fn_match, apoint_free);
+	apoint_index.valid = 0;
+	LLIST_TS_UNLOCK(&alist_p);
+}
+
+/* Drop the appointments that are not selected by a filter. */
+void apoint_llist_filter(struct item_filter *filter)
+{
+	apoint_llist_keep(filter, (llist_fn_match_t)apoint_filter_match);
 }
 
 void apoint_delete(struct apoint *apt)
@@ -271,6 +444,8 @@ void apoint_delete(struct apoint *apt)
 	if (notify_bar())
 		need_check_notify = notify_same_item(apt->start);
 	LLIST_TS_REMOVE(&alist_p, i);
+	apoint_index.valid = 0;
+	notify_queue_remove(apt);
 	if (need_check_notify)
 		notify_check_next_app(0);
 
@@ -290,7 +465,7 @@ struct notify_app *apoint_check_next(struct notify_app *app, time_t start)
 {
 	llist_item_t *i;
 
-	LLIST_TS_LOCK(&alist_p);
+	LLIST_TS_RDLOCK(&alist_p);
 	i = LLIST_TS_FIND_FIRST(&alist_p, &start, apoint_starts_after);
 
 	if (i) {
@@ -317,8 +492,9 @@ void apoint_switch_notify(struct apoint *apt)
 	LLIST_TS_LOCK(&alist_p);
 
 	apt->state ^= APOINT_NOTIFY;
+	apt->digest.valid = 0;
 	if (notify_bar())
-		notify_check_added(apt->mesg, apt->start, apt->state);
+		notify_check_added(apt);
 
 	LLIST_TS_UNLOCK(&alist_p);
 }
@@ -329,11 +505,13 @@ void apoint_paste_item(struct apoint *apt, time_t date)
 
 	localtime_r((time_t *)&apt->start, &t);
 	apt->start = update_time_in_date(date, t.tm_hour, t.tm_min);
+	apt->digest.valid = 0;
 
 	LLIST_TS_LOCK(&alist_p);
 	LLIST_TS_ADD_SORTED(&alist_p, apt, apoint_cmp);
+	apoint_index.valid = 0;
 	LLIST_TS_UNLOCK(&alist_p);
 
 	if (notify_bar())
-		notify_check_added(apt->mesg, apt->start, apt->state);
+		notify_check_added(apt);
 }
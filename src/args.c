@@ -84,6 +84,7 @@ enum {
 	OPT_READ_ONLY,
 	OPT_STATUS,
 	OPT_DAEMON,
+	OPT_CLIENT,
 	OPT_INPUT_DATEFMT,
 	OPT_OUTPUT_DATEFMT
 };
@@ -143,6 +144,7 @@ static void help_arg(void)
 	putchar('\n');
 	printf("%s\n", _("Miscellaneous:"));
 	printf("%s\n", _("  -c, --calendar <file>   The calendar data file to use"));
+	printf("%s\n", _("  --client                Let the daemon answer -Q, -G, -n and -x"));
 	printf("%s\n", _("  -C, --confdir <dir>     The configuration directory to use"));
 	printf("%s\n", _("  --daemon                Run notification daemon in the background"));
 	printf("%s\n", _("  -D, --datadir <dir>     The data directory to use"));
@@ -273,10 +275,15 @@ date_arg_from_to(long from, long to, int add_line, const char *fmt_apt,
 		 int *limit)
 {
 	long date;
+	int n = 0;
+
+	/* Load the whole range at once. */
+	for (date = from; date <= to; date = date_sec_change(date, 0, 1))
+		n++;
+	day_store_items(from, 0, n);
 
 	for (date = from; date <= to; date = date_sec_change(date, 0, 1)) {
-		day_store_items(date, 0, 1);
-		if (day_item_count(0) == 0)
+		if (day_item_count_day(date) == 0)
 			continue;
 		if (add_line)
 			fputs("\n", stdout);
@@ -405,6 +412,7 @@ int parse_args(int argc, char **argv)
 	/* Command-line flags - NOTE that read_only is global */
 	int grep = 0, grep_filter = 0, purge = 0, query = 0, next = 0;
 	int status = 0, gc = 0, import = 0, export = 0, daemon = 0;
+	int client = 0;
 	/* Command line invocation */
 	int filter_opt = 0, format_opt = 0, query_range = 0, cmd_line = 0;
 	int start_from = 0, start_to = 0, end_from = 0, end_to = 0;
@@ -495,6 +503,7 @@ int parse_args(int argc, char **argv)
 		{"read-only", no_argument, NULL, OPT_READ_ONLY},
 		{"status", no_argument, NULL, OPT_STATUS},
 		{"daemon", no_argument, NULL, OPT_DAEMON},
+		{"client", no_argument, NULL, OPT_CLIENT},
 		{"input-datefmt", required_argument, NULL, OPT_INPUT_DATEFMT},
 		{"output-datefmt", required_argument, NULL, OPT_OUTPUT_DATEFMT},
 		{NULL, no_argument, NULL, 0}
@@ -659,6 +668,7 @@ int parse_args(int argc, char **argv)
 			if (regcomp(&reg, optarg, REG_EXTENDED))
 				EXIT(_("could not compile regular expression: %s"), optarg);
 			filter.regex = &reg;
+			filter.pattern = mem_strdup(optarg);
 			filter_opt = 1;
 			break;
 		/*
@@ -847,6 +857,9 @@ int parse_args(int argc, char **argv)
 			daemon = 1;
 			filter.type_mask = TYPE_MASK_APPT | TYPE_MASK_RECUR_APPT;
 			break;
+		case OPT_CLIENT:
+			client = 1;
+			break;
 		case OPT_INPUT_DATEFMT:
 			conf.input_datefmt = atoi(optarg);
 			EXIT_IF(conf.input_datefmt < 1 || conf.input_datefmt > 4,
@@ -875,6 +888,7 @@ int parse_args(int argc, char **argv)
 	    (filter_opt && !(grep + query + export)) ||
 	    (format_opt && !(grep + query + dump_imported)) ||
 	    (query_range && !query) ||
+	    (client && !(grep + query + next + export)) ||
 	    (purge && !filter.invert)
 	   )
 		EXIT(_("invalid argument combination"));
@@ -890,6 +904,14 @@ int parse_args(int argc, char **argv)
 	else if (range < 0)
 		from = date_sec_change(to, 0, range + 1);
 
+	/*
+	 * Let the daemon answer commands that do not change the data files, if
+	 * it is listening. They are run here otherwise.
+	 */
+	if (client && !cfile && !purge && !grep_filter &&
+	    (ret = dmon_query(argc, argv)) >= 0)
+		exit_calcurse(ret);
+
 	io_check_dir(path_ddir);
 	io_check_dir(path_notes);
 	io_check_dir(path_cdir);
@@ -901,11 +923,12 @@ int parse_args(int argc, char **argv)
 		io_check_file(path_apts);
 		io_check_file(path_todo);
 		io_check_file(path_conf);
-		io_load_data(&filter, FORCE);
 		if (purge || grep_filter) {
-			io_save_todo(path_todo);
-			io_save_apts(path_apts);
+			/* The journal records the items the filter drops. */
+			io_load_data(conf.journal ? NULL : &filter, FORCE);
+			io_save_filtered(&filter);
 		} else {
+			io_load_data(&filter, FORCE);
 			/*
 			 * Use default values for non-specified format strings.
 			 */
@@ -922,6 +945,7 @@ int parse_args(int argc, char **argv)
 		io_check_file(path_apts);
 		io_check_file(path_todo);
 		io_check_file(path_conf);
+		io_set_query(from, to);
 		io_load_data(&filter, FORCE);
 
 		/* Use default values for non-specified format strings. */
@@ -983,8 +1007,10 @@ int parse_args(int argc, char **argv)
 	}
 
 	/* Free filter parameters. */
-	if (filter.regex)
+	if (filter.regex) {
 		regfree(filter.regex);
+		mem_free(filter.pattern);
+	}
 
 	return non_interactive;
 }
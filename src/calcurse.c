@@ -261,8 +261,9 @@ static inline void key_generic_save(void)
 		ui_todo_load_items();
 		ui_todo_sel_reset();
 		day_do_storage(0);
+		notify_queue_reload();
 		notify_check_next_app(1);
-		ui_calendar_monthly_view_cache_set_invalid();
+		day_occupancy_invalidate();
 	}
 	wins_update(FLAG_ALL);
 	switch (ret) {
@@ -296,8 +297,9 @@ static inline void key_generic_reload(void)
 		ui_todo_load_items();
 		ui_todo_sel_reset();
 		day_do_storage(0);
+		notify_queue_reload();
 		notify_check_next_app(1);
-		ui_calendar_monthly_view_cache_set_invalid();
+		day_occupancy_invalidate();
 	}
 	wins_update(FLAG_ALL);
 	switch (ret) {
@@ -324,8 +326,10 @@ static inline void key_generic_import(void)
 {
 	wins_erase_status_bar();
 	io_import_data(IO_IMPORT_ICAL, NULL, NULL, NULL, NULL, NULL, NULL);
-	ui_calendar_monthly_view_cache_set_invalid();
+	day_occupancy_invalidate();
 	day_do_storage(0);
+	notify_queue_reload();
+	notify_check_next_app(0);
 	ui_todo_load_items();
 	wins_update(FLAG_ALL);
 }
@@ -780,7 +784,6 @@ int main(int argc, char **argv)
 	 * implicitly calling wrefresh() later (causing ncurses race conditions).
 	 */
 	wins_wrefresh(win[KEY].p);
-	ui_calendar_monthly_view_cache_set_invalid();
 	day_do_storage(1);
 	ui_todo_load_items();
 	ui_todo_sel_reset();
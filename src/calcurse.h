@@ -53,12 +53,14 @@
 #include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <regex.h>
 
 #include "llist.h"
 #include "vector.h"
 #include "htable.h"
 #include "llist_ts.h"
+#include "sha1.h"
 
 /* Internationalization. */
 #if ENABLE_NLS
@@ -92,6 +94,9 @@
 #define KEYS_PATH_NAME   "keys"
 #define CPID_PATH_NAME   ".calcurse.pid"
 #define DPID_PATH_NAME   ".daemon.pid"
+#define DSOCK_PATH_NAME  ".daemon.sock"
+#define SNAP_PATH_NAME   ".apts.snapshot"
+#define JOURNAL_SUFFIX   ".journal"
 #define DLOG_PATH_NAME   "daemon.log"
 #define NOTES_DIR_NAME   "notes/"
 #define HOOKS_DIR_NAME   "hooks/"
@@ -285,6 +290,8 @@ struct conf {
 	unsigned auto_save;
 	unsigned auto_gc;
 	unsigned periodic_save;
+	unsigned load_threads;
+	unsigned journal;
 	unsigned systemevents;
 	unsigned confirm_quit;
 	unsigned confirm_delete;
@@ -313,6 +320,7 @@ struct conf {
 struct dmon_conf {
 	unsigned enable;	/* launch daemon automatically when exiting */
 	unsigned log;		/* log daemon activity */
+	unsigned socket;	/* answer queries forwarded by --client */
 };
 
 /* Input date formats. */
@@ -353,6 +361,15 @@ struct date {
 
 #define ISLEAP(y) ((((y) % 4) == 0 && ((y) % 100) != 0) || ((y) % 400) == 0)
 
+/*
+ * SHA-1 of the text representation of an item, computed on first use. Must
+ * be reset by anything that changes the item.
+ */
+struct item_digest {
+	int valid;
+	uint8_t sha1[SHA1_DIGESTLEN];
+};
+
 /* Appointment definition. */
 struct apoint {
 	time_t start;		/* seconds since 1 jan 1970 */
@@ -365,6 +382,7 @@ struct apoint {
 
 	char *mesg;
 	char *note;
+	struct item_digest digest;
 };
 
 /* Event definition. */
@@ -373,6 +391,7 @@ struct event {
 	time_t day;		/* seconds since 1 jan 1970 */
 	char *mesg;
 	char *note;
+	struct item_digest digest;
 };
 
 /* Todo item definition. */
@@ -381,10 +400,15 @@ struct todo {
 	int id;
 	int completed;
 	char *note;
+	struct item_digest digest;
 };
 
-struct excp {
-	time_t st;		/* beggining of the considered day, in seconds */
+/* Exception days (EXDATE's) of a recurrent item. */
+typedef struct exc_list exc_list_t;
+struct exc_list {
+	unsigned count;
+	unsigned size;
+	time_t *st;		/* beginnings of the days, in ascending order */
 };
 
 enum recur_type {
@@ -407,9 +431,17 @@ struct rpt {
 	llist_t bymonth;	/* BYMONTH list */
 	llist_t bywday;		/* BY(WEEK)DAY list */
 	llist_t bymonthday;	/* BYMONTHDAY list */
-	llist_t exc;		/* EXDATE's */
+	exc_list_t exc;		/* EXDATE's */
+	/* Compiled BY* lists, see recur_rpt_compile(). */
+	unsigned bymonth_mask;		/* bit m: month m */
+	uint64_t bymonthday_mask;	/* bit d: day d, bit 31 + d: day -d */
+	uint64_t bywday_pos[WEEKINDAYS];	/* bit 0: every, bit n: n-th */
+	uint64_t bywday_neg[WEEKINDAYS];	/* bit n: n-th last */
 };
 
+/* Callback for the occurrences of a recurrence rule. */
+typedef int (*recur_fn_occurrence_t) (time_t, void *);
+
 /* Types of integers in rrule lists. */
 typedef enum {
 	BYMONTH,
@@ -423,22 +455,24 @@ typedef enum {
 /* Recurrent appointment definition. */
 struct recur_apoint {
 	struct rpt *rpt;	/* recurrence rule */
-	llist_t exc;		/* recurrence exceptions (NOT rpt->exc) */
+	exc_list_t exc;		/* recurrence exceptions (NOT rpt->exc) */
 	time_t start;		/* start time */
 	long dur;		/* duration */
 	char state;		/* item state */
 	char *mesg;		/* description */
 	char *note;		/* attached note */
+	struct item_digest digest;	/* cached hash */
 };
 
 /* Recurrent event definition. */
 struct recur_event {
 	struct rpt *rpt;	/* recurrence rule */
-	llist_t exc;		/* recurrence exceptions (NOT rpt->exc) */
+	exc_list_t exc;		/* recurrence exceptions (NOT rpt->exc) */
 	int id;			/* event type */
 	time_t day;		/* day of the event */
 	char *mesg;		/* description */
 	char *note;		/* attached note */
+	struct item_digest digest;	/* cached hash */
 };
 
 /* Generic pointer data type for appointments and events. */
@@ -493,6 +527,7 @@ struct item_filter {
 	int priority;
 	int completed;
 	int uncompleted;
+	char *pattern;		/* source of regex */
 };
 
 /* Generic item description (to hold appointments, events...). */
@@ -782,14 +817,22 @@ struct apoint *apoint_dup(struct apoint *);
 void apoint_free(struct apoint *);
 void apoint_llist_init(void);
 void apoint_llist_free(void);
+void apoint_llist_sort(llist_t *);
+void apoint_llist_merge(llist_t *, unsigned);
+void apoint_llist_keep(void *, llist_fn_match_t);
+void apoint_llist_filter(struct item_filter *);
+void apoint_reorder(struct apoint *);
+unsigned apoint_find_range(time_t, time_t, struct apoint ***);
+struct apoint *apoint_alloc(char *, char *, time_t, long, char);
 struct apoint *apoint_new(char *, char *, time_t, long, char);
 unsigned apoint_inday(struct apoint *, time_t *);
 void apoint_sec2str(struct apoint *, time_t, char *, char *);
+void apoint_append_time(struct string *, time_t);
+void apoint_append(struct string *, struct apoint *);
 char *apoint_tostr(struct apoint *);
 char *apoint_hash(struct apoint *);
 void apoint_write(struct apoint *, FILE *);
-char *apoint_scan(FILE *, struct tm, struct tm, char, char *,
-			   struct item_filter *);
+char *apoint_scan(llist_t *, char *, struct tm, struct tm, char, char *);
 void apoint_delete(struct apoint *);
 struct notify_app *apoint_check_next(struct notify_app *, time_t);
 void apoint_switch_notify(struct apoint *);
@@ -817,7 +860,6 @@ void ui_calendar_store_current_date(struct date *);
 void ui_calendar_init_slctd_day(void);
 struct date *ui_calendar_get_slctd_day(void);
 void ui_calendar_set_slctd_day(struct date);
-void ui_calendar_monthly_view_cache_set_invalid(void);
 void ui_calendar_update_panel(void);
 void ui_calendar_goto_today(void);
 void ui_calendar_change_day(int);
@@ -851,15 +893,21 @@ char *day_item_get_note(struct day_item *);
 void day_item_erase_note(struct day_item *);
 long day_item_get_duration(struct day_item *);
 int day_item_get_state(struct day_item *);
+char *day_item_tostr(struct day_item *);
+char *day_item_hash(struct day_item *);
+void day_item_forget_hash(struct day_item *);
 void day_item_add_exc(struct day_item *, time_t);
 void day_item_fork(struct day_item *, struct day_item *);
 void day_store_items(time_t, int, int);
 void day_display_item_date(struct day_item *, WINDOW *, int, time_t, int, int);
 void day_display_item(struct day_item *, WINDOW *, int, int, int, int);
+unsigned day_item_count_day(time_t);
 void day_write_stdout(time_t, const char *, const char *, const char *,
 		      const char *, int *);
 void day_do_storage(int day_changed);
 void day_popup_item(struct day_item *);
+void day_occupancy_touch(struct day_item *);
+void day_occupancy_invalidate(void);
 int day_check_if_item(struct date);
 unsigned day_chk_busy_slices(struct date, int, int *);
 struct day_item *day_cut_item(int);
@@ -873,6 +921,7 @@ void day_item_switch_notify(struct day_item *);
 /* dmon.c */
 void dmon_start(int);
 void dmon_stop(void);
+int dmon_query(int, char **);
 
 /* event.c */
 extern llist_t eventlist;
@@ -882,12 +931,18 @@ struct event *event_dup(struct event *);
 void event_free(struct event *);
 void event_llist_init(void);
 void event_llist_free(void);
+void event_llist_sort(llist_t *);
+void event_llist_merge(llist_t *, unsigned);
+void event_llist_keep(void *, llist_fn_match_t);
+void event_llist_filter(struct item_filter *);
+struct event *event_alloc(char *, char *, time_t, int);
 struct event *event_new(char *, char *, time_t, int);
 unsigned event_inday(struct event *, time_t *);
+void event_append(struct string *, struct event *);
 char *event_tostr(struct event *);
 char *event_hash(struct event *);
 void event_write(struct event *, FILE *);
-char *event_scan(FILE *, struct tm, int, char *, struct item_filter *);
+char *event_scan(llist_t *, char *, struct tm, int, char *);
 void event_delete(struct event *);
 void event_paste_item(struct event *, time_t);
 int event_dummy(struct day_item *);
@@ -916,8 +971,11 @@ void io_dump_apts(const char *, const char *, const char *, const char *);
 unsigned io_save_apts(const char *);
 void io_dump_todo(const char *);
 unsigned io_save_todo(const char *);
+void io_save_filtered(struct item_filter *);
 unsigned io_save_keys(void);
 int io_save_cal(enum save_type);
+void io_keep_data(void);
+void io_set_query(time_t, time_t);
 void io_load_app(struct item_filter *);
 void io_load_todo(struct item_filter *);
 int io_load_data(struct item_filter *, int);
@@ -945,6 +1003,8 @@ int io_file_cp(const char *, const char *);
 void io_unset_modified(void);
 void io_set_modified(void);
 int io_get_modified(void);
+void io_journal_update(const char *, struct day_item *);
+void io_journal_compact(void);
 
 /* keys.c */
 void keys_init(void);
@@ -1030,6 +1090,7 @@ void note_gc(void);
 
 /* notify.c */
 int notify_time_left(void);
+unsigned notify_wanted(int);
 unsigned notify_needs_reminder(void);
 void notify_update_app(time_t, char, char *);
 int notify_bar(void);
@@ -1041,11 +1102,18 @@ void notify_stop_main_thread(void);
 void notify_reinit_bar(void);
 unsigned notify_launch_cmd(void);
 void notify_update_bar(void);
+void notify_queue_build(int);
+void notify_queue_reload(void);
+void notify_queue_apoint(struct apoint *);
+void notify_queue_recur(struct recur_apoint *);
+void notify_queue_remove(void *);
+unsigned notify_queue_first(struct notify_app *, time_t);
+void notify_queue_pop(void);
+time_t notify_queue_until(void);
 unsigned notify_get_next(struct notify_app *);
-unsigned notify_get_next_bkgd(void);
 char *notify_app_txt(void);
 void notify_check_next_app(int);
-void notify_check_added(char *, time_t, char);
+void notify_check_added(struct apoint *);
 void notify_check_repeated(struct recur_apoint *);
 int notify_same_item(time_t);
 int notify_same_recur_item(struct recur_apoint *);
@@ -1059,10 +1127,13 @@ extern llist_ts_t recur_alist_p;
 extern llist_t recur_elist;
 void recur_free_int_list(llist_t *);
 void recur_int_list_dup(llist_t *, llist_t *);
-void recur_free_exc_list(llist_t *);
-void recur_exc_dup(llist_t *, llist_t *);
-int recur_str2exc(llist_t *, char *);
-char *recur_exc2str(llist_t *);
+void recur_rpt_compile(struct rpt *);
+void recur_exc_init(exc_list_t *);
+void recur_free_exc_list(exc_list_t *);
+void recur_add_exc(exc_list_t *, time_t);
+void recur_exc_dup(exc_list_t *, exc_list_t *);
+int recur_str2exc(exc_list_t *, char *);
+char *recur_exc2str(exc_list_t *);
 struct recur_event *recur_event_dup(struct recur_event *);
 struct recur_apoint *recur_apoint_dup(struct recur_apoint *);
 void recur_event_free_bkp(void);
@@ -1073,46 +1144,63 @@ void recur_apoint_llist_init(void);
 void recur_event_llist_init(void);
 void recur_apoint_llist_free(void);
 void recur_event_llist_free(void);
+void recur_apoint_llist_sort(llist_t *);
+void recur_event_llist_sort(llist_t *);
+void recur_apoint_llist_merge(llist_t *, unsigned);
+void recur_event_llist_merge(llist_t *, unsigned);
+void recur_apoint_llist_keep(void *, llist_fn_match_t);
+void recur_event_llist_keep(void *, llist_fn_match_t);
+void recur_apoint_llist_filter(struct item_filter *);
+void recur_event_llist_filter(struct item_filter *);
+struct recur_apoint *recur_apoint_alloc(char *, char *, time_t, long, char,
+					struct rpt *);
+struct recur_event *recur_event_alloc(char *, char *, time_t, int,
+				      struct rpt *);
 struct recur_apoint *recur_apoint_new(char *, char *, time_t, long, char,
 				      struct rpt *);
 struct recur_event *recur_event_new(char *, char *, time_t, int,
 				     struct rpt *);
 char recur_def2char(enum recur_type);
 int recur_char2def(char);
-char *recur_apoint_scan(FILE *, struct tm, struct tm, char,
-				       char *, struct item_filter *,
-				       struct rpt *);
-char *recur_event_scan(FILE *, struct tm, int, char *,
-				     struct item_filter *, struct rpt *);
+char *recur_apoint_scan(llist_t *, char *, struct tm, struct tm, char,
+				       char *, struct rpt *);
+char *recur_event_scan(llist_t *, char *, struct tm, int, char *,
+				     struct rpt *);
+void recur_apoint_append(struct string *, struct recur_apoint *);
 char *recur_apoint_tostr(struct recur_apoint *);
 char *recur_apoint_hash(struct recur_apoint *);
 void recur_apoint_write(struct recur_apoint *, FILE *);
+void recur_event_append(struct string *, struct recur_event *);
 char *recur_event_tostr(struct recur_event *);
 char *recur_event_hash(struct recur_event *);
 void recur_event_write(struct recur_event *, FILE *);
-void recur_save_data(FILE *);
-unsigned recur_item_find_occurrence(time_t, long, struct rpt *, llist_t *,
+unsigned recur_item_find_occurrence(time_t, long, struct rpt *, exc_list_t *,
 				    time_t, time_t *);
 unsigned recur_apoint_find_occurrence(struct recur_apoint *, time_t, time_t *);
 unsigned recur_event_find_occurrence(struct recur_event *, time_t, time_t *);
-unsigned recur_item_inday(time_t, long, struct rpt *, llist_t *, time_t);
+unsigned recur_item_inday(time_t, long, struct rpt *, exc_list_t *, time_t);
 unsigned recur_apoint_inday(struct recur_apoint *, time_t *);
 unsigned recur_event_inday(struct recur_event *, time_t *);
 void recur_event_add_exc(struct recur_event *, time_t);
 void recur_apoint_add_exc(struct recur_apoint *, time_t);
 void recur_event_erase(struct recur_event *);
 void recur_apoint_erase(struct recur_apoint *);
-void recur_bymonth(llist_t *, FILE *);
-void recur_bywday(enum recur_type, llist_t *, FILE *);
-void recur_bymonthday(llist_t *, FILE *);
-void recur_exc_scan(llist_t *, FILE *);
+char *recur_bymonth(llist_t *, char **);
+char *recur_bywday(enum recur_type, llist_t *, char **);
+char *recur_bymonthday(llist_t *, char **);
+char *recur_exc_scan(exc_list_t *, char **);
 void recur_apoint_check_next(struct notify_app *, time_t, time_t);
 void recur_apoint_switch_notify(struct recur_apoint *);
 void recur_event_paste_item(struct recur_event *, time_t);
 void recur_apoint_paste_item(struct recur_apoint *, time_t);
-int recur_next_occurrence(time_t, long, struct rpt *, llist_t *, time_t, time_t *);
-int recur_nth_occurrence(time_t, long, struct rpt *, llist_t *, int, time_t *);
-int recur_prev_occurrence(time_t, long, struct rpt *, llist_t *, time_t, time_t *);
+int recur_next_occurrence(time_t, long, struct rpt *, exc_list_t *, time_t,
+			  time_t *);
+int recur_nth_occurrence(time_t, long, struct rpt *, exc_list_t *, int,
+			 time_t *);
+int recur_prev_occurrence(time_t, long, struct rpt *, exc_list_t *, time_t,
+			  time_t *);
+int recur_item_occurrences(time_t, long, struct rpt *, exc_list_t *, time_t,
+			   time_t, recur_fn_occurrence_t, void *);
 
 
 /* sigs.c */
@@ -1126,6 +1214,10 @@ void string_init(struct string *);
 void string_reset(struct string *);
 int string_grow(struct string *, int);
 char *string_buf(struct string *);
+void string_catc(struct string *, char);
+void string_cat(struct string *, const char *);
+void string_catnum(struct string *, long, int);
+void string_catdate(struct string *, const struct tm *);
 int string_catf(struct string *, const char *, ...);
 int string_vcatf(struct string *, const char *, va_list);
 int string_printf(struct string *, const char *, ...);
@@ -1136,8 +1228,10 @@ int string_strftime(struct string *, const char *, const struct tm *);
 extern llist_t todolist;
 struct todo *todo_get_item(int, int);
 struct todo *todo_add(char *, int, int, char *);
+void todo_append(struct string *, struct todo *);
 char *todo_tostr(struct todo *);
 char *todo_hash(struct todo *);
+void todo_llist_filter(struct item_filter *);
 void todo_write(struct todo *, FILE *);
 void todo_delete_note(struct todo *);
 void todo_delete(struct todo *);
@@ -1272,12 +1366,25 @@ int asprintf(char **, const char *, ...);
 int starts_with(const char *, const char *);
 int starts_with_ci(const char *, const char *);
 int hash_matches(const char *, const char *);
+void item_digest_compute(struct item_digest *, char *);
+char *item_digest_hex(struct item_digest *);
+int item_digest_matches(const char *, struct item_digest *);
 long overflow_add(long, long, long *);
 long overflow_mul(long, long, long *);
 time_t next_wday(time_t, int);
 int wday_per_year(int, int);
 int wday_per_month(int, int, int);
+long days_from_civil(int, int, int);
+void civil_from_days(long, int *, int *, int *);
+int wday_from_days(long);
+void date_tz_reset(void);
+void date_localtime(const time_t *, struct tm *);
+time_t date_mktime(struct tm *);
 char *day_ins(char **, time_t);
+void scan_blank(char **);
+int scan_int(char **, int *);
+int scan_literal(char **, const char *);
+int scan_date(char **, int *, int *, int *);
 
 /* vars.c */
 extern int col, row;
@@ -1299,6 +1406,9 @@ extern char *path_keys;
 extern char *path_notes;
 extern char *path_cpid;
 extern char *path_dpid;
+extern char *path_dsock;
+extern char *path_snap;
+extern char *path_journal;
 extern char *path_dmon_log;
 extern char *path_hooks;
 extern struct conf conf;
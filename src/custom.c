@@ -538,6 +538,8 @@ enum {
 	AUTO_SAVE,
 	AUTO_GC,
 	PERIODIC_SAVE,
+	LOAD_THREADS,
+	JOURNAL,
 	SYSTEM_EVENTS,
 	CONFIRM_QUIT,
 	CONFIRM_DELETE,
@@ -568,6 +570,8 @@ static void print_general_option(int i, WINDOW *win, int y, int hilt, void *cb_d
 		"general.autosave = ",
 		"general.autogc = ",
 		"general.periodicsave = ",
+		"general.loadthreads = ",
+		"general.journal = ",
 		"general.systemevents = ",
 		"general.confirmquit = ",
 		"general.confirmdelete = ",
@@ -680,6 +684,22 @@ static void print_general_option(int i, WINDOW *win, int y, int hilt, void *cb_d
 			  _("(if not null, automatically save data every "
 			  "'periodic_save' minutes)"));
 		break;
+	case LOAD_THREADS:
+		custom_apply_attr(win, ATTR_HIGHEST);
+		mvwprintw(win, y, XPOS + strlen(opt[LOAD_THREADS]), "%d",
+			  conf.load_threads);
+		custom_remove_attr(win, ATTR_HIGHEST);
+		mvwaddstr(win, y + 1, XPOS,
+			  _("(number of threads reading the appointment file, "
+			  "0 for one per processor)"));
+		break;
+	case JOURNAL:
+		print_bool_option_incolor(win, conf.journal, y,
+					  XPOS + strlen(opt[JOURNAL]));
+		mvwaddstr(win, y + 1, XPOS,
+			  _("(append changes to a journal instead of rewriting "
+			  "the appointment file)"));
+		break;
 	case SYSTEM_EVENTS:
 		print_bool_option_incolor(win, conf.systemevents, y,
 					  XPOS + strlen(opt[SYSTEM_EVENTS]));
@@ -786,6 +806,8 @@ static void general_option_edit(int i)
 	const char *input_datefmt_prefix = _("Enter the date format: ");
 	const char *periodic_save_str =
 	    _("Enter the delay, in minutes, between automatic saves (0 to disable) ");
+	const char *load_threads_str =
+	    _("Enter the number of loader threads (0 for one per processor) ");
 	int val;
 	char *buf;
 
@@ -867,6 +889,18 @@ static void general_option_edit(int i)
 			}
 		}
 		break;
+	case LOAD_THREADS:
+		status_mesg(load_threads_str, "");
+		snprintf(buf, BUFSIZ, "%d", conf.load_threads);
+		if (updatestring(win[STA].p, &buf, 0, 1) == 0) {
+			val = atoi(buf);
+			if (val >= 0)
+				conf.load_threads = val;
+		}
+		break;
+	case JOURNAL:
+		conf.journal = !conf.journal;
+		break;
 	case SYSTEM_EVENTS:
 		conf.systemevents = !conf.systemevents;
 		break;
@@ -878,7 +912,6 @@ static void general_option_edit(int i)
 		break;
 	case FIRST_DAY_OF_WEEK:
 		ui_calendar_change_first_day_of_week();
-		ui_calendar_monthly_view_cache_set_invalid();
 		break;
 	case OUTPUT_DATE_FMT:
 		status_mesg(output_datefmt_str, "");
@@ -183,8 +183,9 @@ static int day_cmp(struct day_item **pa, struct day_item **pb)
 	return a->type - b->type;
 }
 
-/* Add an item to the current day list. */
-static void day_add_item(int type, time_t start, time_t order, union aptev_ptr item)
+/* Add an item to a day list, usually the current one. */
+static void day_add_item(vector_t *v, int type, time_t start, time_t order,
+			 union aptev_ptr item)
 {
 	struct day_item *day = mem_malloc(sizeof(struct day_item));
 	day->type = type;
@@ -192,7 +193,7 @@ static void day_add_item(int type, time_t start, time_t order, union aptev_ptr i
 	day->order = order;
 	day->item = item;
 
-	VECTOR_ADD(&day_items, day);
+	VECTOR_ADD(v, day);
 }
 
 /* Get the message of an item. */
@@ -258,6 +259,7 @@ void day_item_erase_note(struct day_item *day)
 	default:
 		break;
 	}
+	day_item_forget_hash(day);
 }
 
 /* Get the duration of an item. */
@@ -286,6 +288,61 @@ int day_item_get_state(struct day_item *day)
 	}
 }
 
+/* Get the line of an item, as written to the appointment file. */
+char *day_item_tostr(struct day_item *day)
+{
+	switch (day->type) {
+	case APPT:
+		return apoint_tostr(day->item.apt);
+	case EVNT:
+		return event_tostr(day->item.ev);
+	case RECUR_APPT:
+		return recur_apoint_tostr(day->item.rapt);
+	case RECUR_EVNT:
+		return recur_event_tostr(day->item.rev);
+	default:
+		return NULL;
+	}
+}
+
+/* Get the hash of an item. */
+char *day_item_hash(struct day_item *day)
+{
+	switch (day->type) {
+	case APPT:
+		return apoint_hash(day->item.apt);
+	case EVNT:
+		return event_hash(day->item.ev);
+	case RECUR_APPT:
+		return recur_apoint_hash(day->item.rapt);
+	case RECUR_EVNT:
+		return recur_event_hash(day->item.rev);
+	default:
+		return NULL;
+	}
+}
+
+/* Drop the cached hash of an item after it was modified. */
+void day_item_forget_hash(struct day_item *day)
+{
+	switch (day->type) {
+	case APPT:
+		day->item.apt->digest.valid = 0;
+		break;
+	case EVNT:
+		day->item.ev->digest.valid = 0;
+		break;
+	case RECUR_APPT:
+		day->item.rapt->digest.valid = 0;
+		break;
+	case RECUR_EVNT:
+		day->item.rev->digest.valid = 0;
+		break;
+	default:
+		break;
+	}
+}
+
 /* Add an exception to an item. */
 void day_item_add_exc(struct day_item *day, time_t date)
 {
@@ -327,121 +384,295 @@ void day_item_fork(struct day_item *day_in, struct day_item *day_out)
 	}
 }
 
+/* Find the day of the range [days[0], days[n]) a time belongs to. */
+static int day_range_find(time_t *days, int n, time_t t)
+{
+	int lo = 0, hi = n - 1, m;
+
+	while (lo < hi) {
+		m = lo + (hi - lo + 1) / 2;
+		if (days[m] <= t)
+			lo = m;
+		else
+			hi = m - 1;
+	}
+
+	return lo;
+}
+
+/*
+ * Items of one kind collected for all days of a range. Once bucketed, the
+ * items of day k are day[first[k]] to day[first[k + 1] - 1].
+ */
+struct day_stream {
+	vector_t items;
+	struct day_item **day;
+	unsigned *first;
+};
+
+static void day_stream_init(struct day_stream *s)
+{
+	VECTOR_INIT(&s->items, 16);
+	s->day = NULL;
+	s->first = NULL;
+}
+
+/* Free a stream, but not the items, which belong to the day vector. */
+static void day_stream_free(struct day_stream *s)
+{
+	VECTOR_FREE(&s->items);
+	if (s->day)
+		mem_free(s->day);
+	if (s->first)
+		mem_free(s->first);
+}
+
+/*
+ * Group the items of a stream by day, keeping their relative order. Unless
+ * the stream was produced in display order, each day is sorted as well.
+ */
+static void day_stream_bucket(struct day_stream *s, time_t *days, int n,
+			      int sorted)
+{
+	unsigned count = VECTOR_COUNT(&s->items), *pos, i;
+	struct day_item *day;
+	int *k, j;
+
+	s->first = mem_calloc(n + 1, sizeof(unsigned));
+	if (count == 0)
+		return;
+
+	k = mem_malloc(count * sizeof(int));
+	VECTOR_FOREACH(&s->items, i) {
+		day = VECTOR_NTH(&s->items, i);
+		k[i] = day_range_find(days, n, day->order);
+		s->first[k[i] + 1]++;
+	}
+	for (j = 0; j < n; j++)
+		s->first[j + 1] += s->first[j];
+
+	pos = mem_malloc(n * sizeof(unsigned));
+	memcpy(pos, s->first, n * sizeof(unsigned));
+	s->day = mem_malloc(count * sizeof(struct day_item *));
+	VECTOR_FOREACH(&s->items, i)
+		s->day[pos[k[i]]++] = VECTOR_NTH(&s->items, i);
+	mem_free(pos);
+	mem_free(k);
+
+	if (sorted)
+		return;
+	for (j = 0; j < n; j++) {
+		qsort(s->day + s->first[j], s->first[j + 1] - s->first[j],
+		      sizeof(struct day_item *), (vector_fn_cmp_t)day_cmp);
+	}
+}
+
+/* Number of items of a bucketed stream on day k. */
+static unsigned day_stream_count(struct day_stream *s, int k)
+{
+	return s->first[k + 1] - s->first[k];
+}
+
+/*
+ * Append the items of day k of two bucketed streams to the day vector,
+ * merging them in display order.
+ */
+static void day_stream_merge(struct day_stream *a, struct day_stream *b, int k)
+{
+	unsigned i = a->first[k], j = b->first[k];
+
+	while (i < a->first[k + 1] && j < b->first[k + 1]) {
+		if (day_cmp(&a->day[i], &b->day[j]) <= 0)
+			VECTOR_ADD(&day_items, a->day[i++]);
+		else
+			VECTOR_ADD(&day_items, b->day[j++]);
+	}
+	while (i < a->first[k + 1])
+		VECTOR_ADD(&day_items, a->day[i++]);
+	while (j < b->first[k + 1])
+		VECTOR_ADD(&day_items, b->day[j++]);
+}
+
 /*
- * Store the events for the selected day in structure pointed
- * by day_items. This is done by copying the events
- * from the general structure pointed by eventlist to the structure
- * dedicated to the selected day.
- * Returns the number of events for the selected day.
+ * Store the events for the days of the range in structure pointed by v. This
+ * is done by copying the events from the general structure pointed by
+ * eventlist, which is sorted by day and message, in a single pass.
  */
-static int day_store_events(time_t date)
+static void day_store_events(time_t *days, int n, vector_t *v)
 {
 	llist_item_t *i;
 	union aptev_ptr p;
-	int e_nb = 0;
 
-	LLIST_FIND_FOREACH_CONT(&eventlist, &date, event_inday, i) {
-		struct event *ev = LLIST_TS_GET_DATA(i);
+	LLIST_FOREACH(&eventlist, i) {
+		struct event *ev = LLIST_GET_DATA(i);
+
+		if (ev->day < days[0])
+			continue;
+		if (ev->day >= days[n])
+			break;
 
 		p.ev = ev;
-		day_add_item(EVNT, ev->day, ev->day, p);
-		e_nb++;
+		day_add_item(v, EVNT, ev->day, ev->day, p);
 	}
+}
 
-	return e_nb;
+/*
+ * State shared with the callbacks storing the occurrences of a recurrent item
+ * in a range of days. The days are given by their start times, with one extra
+ * entry for the start of the day after the range.
+ */
+struct day_range {
+	time_t *days;
+	int n;
+	vector_t *v;
+	union aptev_ptr p;
+	long dur;
+	int k;
+	/* Occurrence waiting to be stored, see day_add_recur_apoint(). */
+	time_t pending;
+	int pending_first, pending_last;
+};
+
+/* Find the day of the range a time belongs to, starting at day k. */
+static int day_range_index(struct day_range *r, int k, time_t t)
+{
+	while (k < r->n - 1 && r->days[k + 1] <= t)
+		k++;
+	return k;
+}
+
+static int day_add_recur_event(time_t occurrence, void *data)
+{
+	struct day_range *r = data;
+
+	day_add_item(r->v, RECUR_EVNT, occurrence, occurrence, r->p);
+
+	return 0;
 }
 
 /*
- * Store the recurrent events for the selected day in structure pointed
- * by day_items. This is done by copying the recurrent events
- * from the general structure pointed by recur_elist to the structure
- * dedicated to the selected day.
- * Returns the number of recurrent events for the selected day.
+ * Store the recurrent events for the days of the range in structure pointed
+ * by v. This is done by walking the occurrences of each recurrent event in
+ * the general structure pointed by recur_elist once for the whole range.
  */
-static int day_store_recur_events(time_t date)
+static void day_store_recur_events(time_t *days, int n, vector_t *v)
 {
 	llist_item_t *i;
-	union aptev_ptr p;
-	int e_nb = 0;
+	struct day_range r;
+
+	r.days = days;
+	r.n = n;
+	r.v = v;
 
-	LLIST_FIND_FOREACH(&recur_elist, &date, recur_event_inday, i) {
+	LLIST_FOREACH(&recur_elist, i) {
 		struct recur_event *rev = LLIST_TS_GET_DATA(i);
 
-		p.rev = rev;
-		time_t occurrence;
-		if (recur_event_find_occurrence(rev, date, &occurrence)) {
-			day_add_item(RECUR_EVNT, occurrence, occurrence, p);
-			e_nb++;
-		}
+		r.p.rev = rev;
+		recur_item_occurrences(rev->day, -1, rev->rpt, &rev->exc,
+				       days[0], days[n] - 1,
+				       day_add_recur_event, &r);
 	}
-
-	return e_nb;
 }
 
 /*
- * Store the apoints for the selected day in structure pointed
- * by day_items. This is done by copying the appointments
- * from the general structure pointed by alist_p to the
- * structure dedicated to the selected day.
- * Returns the number of appointments for the selected day.
+ * Store the apoints for the days of the range in structure pointed by v.
+ * This is done by copying the appointments that overlap the range from the
+ * general structure pointed by alist_p, in start time order, once per day
+ * they span.
  */
-static int day_store_apoints(time_t date)
+static void day_store_apoints(time_t *days, int n, vector_t *v)
 {
-	llist_item_t *i;
+	struct apoint **apts;
+	unsigned count, i;
 	union aptev_ptr p;
-	int a_nb = 0;
+	time_t end;
+	int k;
 
-	LLIST_TS_LOCK(&alist_p);
-	LLIST_TS_FIND_FOREACH(&alist_p, &date, apoint_inday, i) {
-		struct apoint *apt = LLIST_TS_GET_DATA(i);
+	LLIST_TS_RDLOCK(&alist_p);
+	count = apoint_find_range(days[0], days[n] - 1, &apts);
+	for (i = 0; i < count; i++) {
+		struct apoint *apt = apts[i];
 
 		p.apt = apt;
-		/*
-		 * For appointments continuing from the previous day, order is
-		 * set to midnight to sort it before appointments of the day.
-		 */
-		day_add_item(APPT,
-			     apt->start,
-			     apt->start < date ? date : apt->start,
-			     p);
-		a_nb++;
+		end = apt->dur > 0 ? apt->start + apt->dur - 1 : apt->start;
+		k = day_range_find(days, n, apt->start);
+		for (; k < n && days[k] <= end; k++) {
+			/*
+			 * For appointments continuing from the previous day,
+			 * order is set to midnight to sort it before
+			 * appointments of the day.
+			 */
+			day_add_item(v, APPT, apt->start, apt->start < days[k] ?
+				     days[k] : apt->start, p);
+		}
 	}
 	LLIST_TS_UNLOCK(&alist_p);
+}
+
+/* Store the pending occurrence for its days up to, but excluding, day k. */
+static void day_flush_recur_apoint(struct day_range *r, int k)
+{
+	int j;
+
+	for (j = r->pending_first; j <= r->pending_last && j < k; j++) {
+		/* As for appointments */
+		day_add_item(r->v, RECUR_APPT,
+			     r->pending,
+			     r->pending < r->days[j] ? r->days[j] : r->pending,
+			     r->p);
+	}
+	r->pending_first = j;
+}
+
+/*
+ * A multi-day occurrence may overlap the next ones. As before, only the most
+ * recent occurrence is shown on a day: the days of an occurrence are stored
+ * once it is known that no later occurrence starts on them.
+ */
+static int day_add_recur_apoint(time_t occurrence, void *data)
+{
+	struct day_range *r = data;
+	time_t end = r->dur > 0 ? occurrence + r->dur - 1 : occurrence;
+
+	r->k = day_range_index(r, r->k, occurrence);
+	day_flush_recur_apoint(r, r->k);
 
-	return a_nb;
+	r->pending = occurrence;
+	r->pending_first = r->k;
+	r->pending_last = day_range_index(r, r->k, end);
+
+	return 0;
 }
 
 /*
- * Store the recurrent apoints for the selected day in structure pointed
- * by day_items. This is done by copying the appointments
- * from the general structure pointed by recur_alist_p to the
- * structure dedicated to the selected day.
- * Returns the number of recurrent appointments for the selected day.
+ * Store the recurrent apoints for the days of the range in structure pointed
+ * by v, walking the occurrences of each item of the general structure pointed
+ * by recur_alist_p once.
  */
-static int day_store_recur_apoints(time_t date)
+static void day_store_recur_apoints(time_t *days, int n, vector_t *v)
 {
 	llist_item_t *i;
-	union aptev_ptr p;
-	time_t occurrence;
-	int a_nb = 0;
+	struct day_range r;
+
+	r.days = days;
+	r.n = n;
+	r.v = v;
 
-	LLIST_TS_LOCK(&recur_alist_p);
-	LLIST_TS_FIND_FOREACH(&recur_alist_p, &date, recur_apoint_inday, i) {
+	LLIST_TS_RDLOCK(&recur_alist_p);
+	LLIST_TS_FOREACH(&recur_alist_p, i) {
 		struct recur_apoint *rapt = LLIST_TS_GET_DATA(i);
 
-		p.rapt = rapt;
-		/* As for appointments */
-		if (recur_apoint_find_occurrence(rapt, date, &occurrence)) {
-			day_add_item(RECUR_APPT,
-				     occurrence,
-				     occurrence < date ? date : occurrence,
-				     p);
-			a_nb++;
-		}
+		r.p.rapt = rapt;
+		r.dur = rapt->dur;
+		r.k = 0;
+		r.pending_first = 0;
+		r.pending_last = -1;
+		recur_item_occurrences(rapt->start, rapt->dur, rapt->rpt,
+				       &rapt->exc, days[0], days[n] - 1,
+				       day_add_recur_apoint, &r);
+		day_flush_recur_apoint(&r, n);
 	}
 	LLIST_TS_UNLOCK(&recur_alist_p);
-
-	return a_nb;
 }
 
 /*
@@ -450,31 +681,72 @@ static int day_store_recur_apoints(time_t date)
  * recursive appointments and normal appointments.
  * The items are stored in the day_items vector; the number of events and
  * appointments in the vector is stored in day_items_nb,
+ *
+ * Each type is collected in a single sweep over the whole range, grouped by
+ * day and merged with the other type of the same kind, so that the day vector
+ * is built in display order without sorting it as a whole.
  */
 void
 day_store_items(time_t date, int include_captions, int n)
 {
+	struct day_stream ev, rev, apt, rapt;
 	unsigned apts, events;
 	union aptev_ptr p = { NULL }, d;
+	time_t *days;
 	int i;
 
 	day_free_vector();
 	day_init_vector();
 
+	if (n <= 0)
+		return;
+
+	/*
+	 * Days are delimited by the start of each calendar day: after a
+	 * change of UTC offset at midnight, the dates stepped through keep
+	 * a later time of day.
+	 */
+	days = mem_malloc((n + 1) * sizeof(time_t));
 	for (i = 0; i < n; i++, date = NEXTDAY(date)) {
 		if (YEAR1902_2037 && !check_sec(&date))
 			break;
+		days[i] = DAY(date);
+	}
+	n = i;
+	days[n] = DAY(date);
+	if (n == 0) {
+		mem_free(days);
+		return;
+	}
+
+	day_stream_init(&ev);
+	day_stream_init(&rev);
+	day_stream_init(&apt);
+	day_stream_init(&rapt);
+	day_store_events(days, n, &ev.items);
+	day_store_recur_events(days, n, &rev.items);
+	day_store_apoints(days, n, &apt.items);
+	day_store_recur_apoints(days, n, &rapt.items);
+	day_stream_bucket(&ev, days, n, 1);
+	day_stream_bucket(&rev, days, n, 0);
+	day_stream_bucket(&apt, days, n, 1);
+	day_stream_bucket(&rapt, days, n, 0);
+
+	for (i = 0; i < n; i++) {
+		date = days[i];
 
 		if (include_captions)
-			day_add_item(DAY_HEADING, 0, date, p);
+			day_add_item(&day_items, DAY_HEADING, 0, date, p);
+
+		events = day_stream_count(&ev, i) + day_stream_count(&rev, i);
+		apts = day_stream_count(&apt, i) + day_stream_count(&rapt, i);
 
-		events = day_store_recur_events(date);
-		events += day_store_events(date);
-		apts = day_store_recur_apoints(date);
-		apts += day_store_apoints(date);
+		day_stream_merge(&rev, &ev, i);
 
 		if (include_captions && events > 0 && apts > 0)
-			day_add_item(EVNT_SEPARATOR, 0, date, p);
+			day_add_item(&day_items, EVNT_SEPARATOR, 0, date, p);
+
+		day_stream_merge(&rapt, &apt, i);
 
 		day_items_nb += events + apts;
 
@@ -482,19 +754,24 @@ day_store_items(time_t date, int include_captions, int n)
 			/* Insert dummy event. */
 			d.ev = &dummy;
 			dummy.mesg = conf.empty_day;
-			day_add_item(EVNT, DUMMY, date, d);
+			day_add_item(&day_items, EVNT, DUMMY, date, d);
 			day_items_nb++;
 		}
 
 		if (include_captions) {
 			/* Empty line at end of day if appointments have one. */
 			if (apts == 0 && conf.empty_appt_line)
-				day_add_item(EMPTY_SEPARATOR, 0, ENDOFDAY(date), p);
-			day_add_item(END_SEPARATOR, 0, ENDOFDAY(date), p);
+				day_add_item(&day_items, EMPTY_SEPARATOR, 0,
+					     ENDOFDAY(date), p);
+			day_add_item(&day_items, END_SEPARATOR, 0,
+				     ENDOFDAY(date), p);
 		}
 	}
-
-	VECTOR_SORT(&day_items, day_cmp);
+	mem_free(days);
+	day_stream_free(&ev);
+	day_stream_free(&rev);
+	day_stream_free(&apt);
+	day_stream_free(&rapt);
 }
 
 /*
@@ -555,13 +832,48 @@ day_display_item(struct day_item *day, WINDOW *win, int incolor, int width,
 		custom_remove_attr(win, ATTR_HIGHEST);
 }
 
-/* Write the appointments and events for the selected day to stdout. */
+/*
+ * Return the position of the first item in the (sorted) day vector that is
+ * not ordered before t.
+ */
+static int day_item_lower_bound(time_t t)
+{
+	int lo = 0, hi = VECTOR_COUNT(&day_items), m;
+	struct day_item *day;
+
+	while (lo < hi) {
+		m = lo + (hi - lo) / 2;
+		day = VECTOR_NTH(&day_items, m);
+		if (day->order < t)
+			lo = m + 1;
+		else
+			hi = m;
+	}
+
+	return lo;
+}
+
+/*
+ * Return the number of items stored for one of the days loaded by
+ * day_store_items() without captions.
+ */
+unsigned day_item_count_day(time_t date)
+{
+	return day_item_lower_bound(DAY(NEXTDAY(date))) -
+	       day_item_lower_bound(DAY(date));
+}
+
+/*
+ * Write the appointments and events for the selected day to stdout. The day
+ * may be any of the days loaded by day_store_items() without captions.
+ */
 void day_write_stdout(time_t date, const char *fmt_apt, const char *fmt_rapt,
 		      const char *fmt_ev, const char *fmt_rev, int *limit)
 {
-	int i;
+	int i, last;
 
-	VECTOR_FOREACH(&day_items, i) {
+	last = day_item_lower_bound(DAY(NEXTDAY(date)));
+	for (i = day_item_lower_bound(DAY(date)); i < last; i++) {
 		if (*limit == 0)
 			break;
 		struct day_item *day = VECTOR_NTH(&day_items, i);
@@ -686,135 +998,295 @@ void day_popup_item(struct day_item *day)
 }
 
 /*
- * Check whether there is an item on a given day and return the colour
- * attribute for the item:
- * ATTR_TRUE if the selected day contains a regular event or appointment,
- * ATTR_LOW if the selected day does not contain a regular event or
- * appointment but an occurrence of a recurrent item. Returns 0 otherwise.
+ * The calendar panel needs, for every day it shows, whether the day has items
+ * and which parts of the day are busy. This is kept for a few whole years at a
+ * time. Each year is filled in a single sweep over the item lists and only the
+ * days touched by an edit are recomputed later on.
  */
-int day_check_if_item(struct date day)
+#define OCCUPANCY_YEARS		3
+#define OCCUPANCY_SLICES	48
+
+#define OCCUPANCY_REGULAR	1	/* regular event or appointment */
+#define OCCUPANCY_RECUR		2	/* occurrence of a recurrent item */
+#define OCCUPANCY_NOSLICES	4	/* busy slices cannot be drawn */
+
+struct day_occupancy {
+	int year;
+	unsigned used;
+	int n;
+	time_t days[YEARINDAYS + 2];
+	unsigned char mark[YEARINDAYS + 1];
+	uint64_t busy[YEARINDAYS + 1];
+};
+
+static struct day_occupancy occupancy[OCCUPANCY_YEARS];
+static unsigned occupancy_clock;
+static pthread_mutex_t occupancy_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Span of the days touched by edits since the occupancy was last updated. */
+static struct {
+	int set;
+	int open;
+	time_t start, end;
+} occupancy_dirty;
+
+/*
+ * Mark the slices of day k busy with an appointment starting at start and
+ * lasting dur seconds. The slices of the last second, if any, are left out.
+ */
+static void day_occupancy_busy(struct day_occupancy *o, int k, time_t start,
+			       long dur, int type)
 {
-	const time_t t = date2sec(day, 0, 0);
+	const time_t t = o->days[k];
+	const long slicelen = DAYINSEC / OCCUPANCY_SLICES;
+	long first, last;
 
-	if (LLIST_FIND_FIRST(&eventlist, (time_t *)&t, event_inday))
-		return ATTR_TRUE;
+	if (type == APPT && start >= t + DAYINSEC)
+		return;
 
-	LLIST_TS_LOCK(&alist_p);
-	if (LLIST_TS_FIND_FIRST(&alist_p, (time_t *)&t, apoint_inday)) {
-		LLIST_TS_UNLOCK(&alist_p);
-		return ATTR_TRUE;
+	first = start >= t ? get_item_time(start) : 0;
+	if (start + dur < t + DAYINSEC)
+		last = get_item_time(start + dur);
+	else
+		last = DAYINSEC - 1;
+
+	/*
+	 * If an item ends on 12:00, we do not want the 12:00 slot to be marked
+	 * busy.
+	 */
+	if (last > first)
+		last--;
+
+	first /= slicelen;
+	last /= slicelen;
+	if (last < first) {
+		o->mark[k] |= OCCUPANCY_NOSLICES;
+		return;
 	}
-	LLIST_TS_UNLOCK(&alist_p);
+	if (last >= OCCUPANCY_SLICES)
+		last = OCCUPANCY_SLICES - 1;
 
-	if (LLIST_FIND_FIRST(&recur_elist, (time_t *)&t, recur_event_inday))
-		return ATTR_LOW;
+	for (; first <= last; first++)
+		o->busy[k] |= (uint64_t)1 << first;
+}
 
-	LLIST_TS_LOCK(&recur_alist_p);
-	if (LLIST_TS_FIND_FIRST(&recur_alist_p, (time_t *)&t,
-				recur_apoint_inday)) {
-		LLIST_TS_UNLOCK(&recur_alist_p);
-		return ATTR_LOW;
+/* Recompute the occupancy of the days a to b - 1 of a cached year. */
+static void day_occupancy_fill(struct day_occupancy *o, int a, int b)
+{
+	vector_t v;
+	struct day_item *day;
+	unsigned i;
+	int k;
+
+	memset(o->mark + a, 0, (b - a) * sizeof(o->mark[0]));
+	memset(o->busy + a, 0, (b - a) * sizeof(o->busy[0]));
+
+	VECTOR_INIT(&v, 16);
+	day_store_events(o->days + a, b - a, &v);
+	day_store_recur_events(o->days + a, b - a, &v);
+	day_store_apoints(o->days + a, b - a, &v);
+	day_store_recur_apoints(o->days + a, b - a, &v);
+
+	VECTOR_FOREACH(&v, i) {
+		day = VECTOR_NTH(&v, i);
+		k = a + day_range_find(o->days + a, b - a, day->order);
+
+		if (day->type == EVNT || day->type == APPT)
+			o->mark[k] |= OCCUPANCY_REGULAR;
+		else
+			o->mark[k] |= OCCUPANCY_RECUR;
+		if (day->type == APPT || day->type == RECUR_APPT)
+			day_occupancy_busy(o, k, day->start,
+					   day_item_get_duration(day),
+					   day->type);
+		day_free(day);
 	}
-	LLIST_TS_UNLOCK(&recur_alist_p);
+	VECTOR_FREE(&v);
+}
 
-	return 0;
+/* Apply the pending edits to a cached year. */
+static void day_occupancy_flush(struct day_occupancy *o)
+{
+	time_t start = occupancy_dirty.start, end = occupancy_dirty.end;
+
+	if (start < o->days[0])
+		start = o->days[0];
+	if (occupancy_dirty.open || end >= o->days[o->n])
+		end = o->days[o->n] - 1;
+	if (start > end)
+		return;
+
+	day_occupancy_fill(o, day_range_find(o->days, o->n, start),
+			   day_range_find(o->days, o->n, end) + 1);
 }
 
-static unsigned fill_slices(int *slices, int slicesno, int first, int last)
+/*
+ * Return the occupancy of a year, computing it if needed. Must be called with
+ * the occupancy mutex held.
+ */
+static struct day_occupancy *day_occupancy_get(int year)
 {
+	struct day_occupancy *o = NULL;
+	struct date d = { 1, 1, year };
 	int i;
 
-	if (first < 0 || last < first)
-		return 0;
+	if (YEAR1902_2037 && (year < 1902 || year > 2037))
+		return NULL;
 
-	if (last >= slicesno)
-		last = slicesno - 1;	/* Appointment spanning more than one day. */
+	if (occupancy_dirty.set) {
+		for (i = 0; i < OCCUPANCY_YEARS; i++) {
+			if (occupancy[i].year)
+				day_occupancy_flush(&occupancy[i]);
+		}
+		occupancy_dirty.set = 0;
+	}
 
-	for (i = first; i <= last; i++)
-		slices[i] = 1;
+	for (i = 0; i < OCCUPANCY_YEARS; i++) {
+		if (occupancy[i].year == year) {
+			o = &occupancy[i];
+			break;
+		}
+		if (!o || occupancy[i].used < o->used)
+			o = &occupancy[i];
+	}
 
-	return 1;
+	if (o->year != year) {
+		o->year = year;
+		o->n = days_from_civil(year + 1, 1, 1) -
+		       days_from_civil(year, 1, 1);
+		o->days[0] = date2sec(d, 0, 0);
+		for (i = 0; i < o->n; i++)
+			o->days[i + 1] = NEXTDAY(o->days[i]);
+		day_occupancy_fill(o, 0, o->n);
+	}
+	o->used = ++occupancy_clock;
+
+	return o;
+}
+
+/* Index of a day in the occupancy of its year. */
+static int day_occupancy_index(struct date day)
+{
+	return days_from_civil(day.yyyy, day.mm, day.dd) -
+	       days_from_civil(day.yyyy, 1, 1);
 }
 
 /*
- * Fill in the 'slices' vector given as an argument with 1 if there is an
- * appointment in the corresponding time slice, 0 otherwise.
- * A 24 hours day is divided into 'slicesno' number of time slices.
+ * Note that the days covered by an item change. Must be called with the item
+ * as it is before it is modified or removed, and as it is after it has been
+ * modified or added.
  */
-unsigned day_chk_busy_slices(struct date day, int slicesno, int *slices)
+void day_occupancy_touch(struct day_item *p)
 {
-	const time_t t = date2sec(day, 0, 0);
-	llist_item_t *i;
-	int slicelen;
+	time_t start, end;
+	int open = 0;
 
-	slicelen = DAYINSEC / slicesno;
+	switch (p->type) {
+	case EVNT:
+		start = end = p->item.ev->day;
+		break;
+	case APPT:
+		start = p->item.apt->start;
+		end = start + p->item.apt->dur;
+		break;
+	case RECUR_EVNT:
+		start = end = p->item.rev->day;
+		open = 1;
+		break;
+	case RECUR_APPT:
+		start = end = p->item.rapt->start;
+		open = 1;
+		break;
+	default:
+		return;
+	}
+	start = DAY(start);
+
+	pthread_mutex_lock(&occupancy_mutex);
+	if (!occupancy_dirty.set) {
+		occupancy_dirty.set = 1;
+		occupancy_dirty.open = open;
+		occupancy_dirty.start = start;
+		occupancy_dirty.end = end;
+	} else {
+		occupancy_dirty.open |= open;
+		if (start < occupancy_dirty.start)
+			occupancy_dirty.start = start;
+		if (end > occupancy_dirty.end)
+			occupancy_dirty.end = end;
+	}
+	pthread_mutex_unlock(&occupancy_mutex);
+}
 
-#define  SLICENUM(tsec)  ((tsec) / slicelen % slicesno)
+/* Drop the occupancy of all years, e.g. after the items were reloaded. */
+void day_occupancy_invalidate(void)
+{
+	int i;
 
-	LLIST_TS_LOCK(&recur_alist_p);
-	LLIST_TS_FIND_FOREACH(&recur_alist_p, (time_t *)&t,
-			      recur_apoint_inday, i) {
-		struct recur_apoint *rapt = LLIST_TS_GET_DATA(i);
-		time_t occurrence;
-		time_t start, end;
+	pthread_mutex_lock(&occupancy_mutex);
+	for (i = 0; i < OCCUPANCY_YEARS; i++)
+		occupancy[i].year = 0;
+	occupancy_dirty.set = 0;
+	pthread_mutex_unlock(&occupancy_mutex);
+}
 
-		if (!recur_apoint_find_occurrence(rapt, t, &occurrence))
-			continue;
+/*
+ * Check whether there is an item on a given day and return the colour
+ * attribute for the item:
+ * ATTR_TRUE if the selected day contains a regular event or appointment,
+ * ATTR_LOW if the selected day does not contain a regular event or
+ * appointment but an occurrence of a recurrent item. Returns 0 otherwise.
+ */
+int day_check_if_item(struct date day)
+{
+	struct day_occupancy *o;
+	int mark = 0;
 
-		if (occurrence >= t)
-			start = get_item_time(occurrence);
-		else
-			start = 0;
+	pthread_mutex_lock(&occupancy_mutex);
+	o = day_occupancy_get(day.yyyy);
+	if (o)
+		mark = o->mark[day_occupancy_index(day)];
+	pthread_mutex_unlock(&occupancy_mutex);
 
-		if (occurrence + rapt->dur < t + DAYINSEC)
-			end = get_item_time(occurrence + rapt->dur);
-		else
-			end = DAYINSEC - 1;
-
-		/*
-		 * If an item ends on 12:00, we do not want the 12:00 slot to
-		 * be marked busy.
-		 */
-		if (end > start)
-			end--;
-
-		if (!fill_slices(slices, slicesno, SLICENUM(start),
-					SLICENUM(end))) {
-			LLIST_TS_UNLOCK(&recur_alist_p);
-			return 0;
-		}
+	if (mark & OCCUPANCY_REGULAR)
+		return ATTR_TRUE;
+	if (mark & OCCUPANCY_RECUR)
+		return ATTR_LOW;
+	return 0;
+}
+
+/*
+ * Fill in the 'slices' vector given as an argument with 1 if there is an
+ * appointment in the corresponding time slice, 0 otherwise.
+ * A 24 hours day is divided into 'slicesno' number of time slices, which must
+ * divide OCCUPANCY_SLICES.
+ */
+unsigned day_chk_busy_slices(struct date day, int slicesno, int *slices)
+{
+	struct day_occupancy *o;
+	uint64_t busy = 0;
+	int mark = 0, i;
+
+	EXIT_IF(slicesno <= 0 || OCCUPANCY_SLICES % slicesno,
+		_("unsupported number of time slices"));
+
+	pthread_mutex_lock(&occupancy_mutex);
+	o = day_occupancy_get(day.yyyy);
+	if (o) {
+		i = day_occupancy_index(day);
+		mark = o->mark[i];
+		busy = o->busy[i];
 	}
-	LLIST_TS_UNLOCK(&recur_alist_p);
+	pthread_mutex_unlock(&occupancy_mutex);
 
-	LLIST_TS_LOCK(&alist_p);
-	LLIST_TS_FIND_FOREACH(&alist_p, (time_t *)&t, apoint_inday, i) {
-		struct apoint *apt = LLIST_TS_GET_DATA(i);
-		time_t start = get_item_time(apt->start);
-		time_t end = get_item_time(apt->start + apt->dur);
+	if (mark & OCCUPANCY_NOSLICES)
+		return 0;
 
-		if (apt->start >= t + DAYINSEC)
-			break;
-		if (apt->start < t)
-			start = 0;
-		if (apt->start + apt->dur >= t + DAYINSEC)
-			end = DAYINSEC - 1;
-
-		/*
-		 * If an item ends on 12:00, we do not want the 12:00 slot to
-		 * be marked busy.
-		 */
-		if (end > start)
-			end--;
-
-		if (!fill_slices(slices, slicesno, SLICENUM(start),
-					SLICENUM(end))) {
-			LLIST_TS_UNLOCK(&alist_p);
-			return 0;
-		}
+	for (i = 0; i < OCCUPANCY_SLICES; i++) {
+		if (busy & ((uint64_t)1 << i))
+			slices[i / (OCCUPANCY_SLICES / slicesno)] = 1;
 	}
-	LLIST_TS_UNLOCK(&alist_p);
 
-#undef SLICENUM
 	return 1;
 }
 
@@ -935,6 +1407,7 @@ void day_edit_note(struct day_item *p, const char *editor)
 	default:
 		break;
 	}
+	day_item_forget_hash(p);
 }
 
 /* View a note previously attached to an appointment or event */
@@ -36,15 +36,23 @@
 
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <unistd.h>
 #include <paths.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
 #include <signal.h>
+#include <poll.h>
 
 #include "calcurse.h"
 
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
+
+/* Longest sleep when the wake-up time cannot be set on a timer. */
 #define DMON_SLEEP_TIME  60
 
 #define DMON_LOG(...) do {                                      \
@@ -64,15 +72,51 @@
 
 static unsigned data_loaded;
 
+/* The socket queries are received on, and the file it is bound to. */
+static int dmon_sock = -1;
+static ino_t dmon_sock_ino;
+
+/* Set in the processes answering a query, which must not forward it again. */
+static int dmon_served;
+
+/* Status sent back for a query the client has to evaluate itself. */
+#define DMON_DECLINED	255
+
+/* Written to by the signal handler to wake the daemon up. */
+static int dmon_pipe[2] = { -1, -1 };
+
+#ifdef HAVE_SYS_TIMERFD_H
+/* Expires at the time of the next notification, see dmon_wait(). */
+static int dmon_timer = -1;
+#endif
+
+static void dmon_unlisten(void)
+{
+	struct stat st;
+
+	close(dmon_sock);
+	dmon_sock = -1;
+	/* A new daemon may have replaced the socket already. */
+	if (stat(path_dsock, &st) == 0 && st.st_ino == dmon_sock_ino)
+		unlink(path_dsock);
+}
+
 static void dmon_sigs_hdlr(int sig)
 {
 	if (sig == SIGUSR1) {
+		int err = errno;
+
 		want_reload = 1;
+		/* It can only fail if full, which wakes the daemon up too. */
+		if (dmon_pipe[1] >= 0 && write(dmon_pipe[1], "", 1) < 0)
+			errno = err;
 		return;
 	}
 
 	if (data_loaded)
 		free_user_data();
+	if (dmon_sock >= 0)
+		dmon_unlisten();
 
 	DMON_LOG(_("terminated at %s with signal %d\n"), nowstr(), sig);
 
@@ -139,6 +183,13 @@ static unsigned daemonize(int status)
 	/* Write access for the owner only. */
 	umask(0022);
 
+	if (pipe(dmon_pipe) == 0) {
+		for (fd = 0; fd < 2; fd++) {
+			fcntl(dmon_pipe[fd], F_SETFL, O_NONBLOCK);
+			fcntl(dmon_pipe[fd], F_SETFD, FD_CLOEXEC);
+		}
+	}
+
 	if (!sigs_set_hdlr(SIGINT, dmon_sigs_hdlr)
 	    || !sigs_set_hdlr(SIGTERM, dmon_sigs_hdlr)
 	    || !sigs_set_hdlr(SIGALRM, dmon_sigs_hdlr)
@@ -149,6 +200,304 @@ static unsigned daemonize(int status)
 	return 1;
 }
 
+/*
+ * The current time, read from the clock timers are set on; time() may lag
+ * behind it and report a timer as expired early.
+ */
+static time_t dmon_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec;
+}
+
+/* Time at which to notify of an appointment. */
+static time_t dmon_due(struct notify_app *a)
+{
+	return a->time - MAX(nbar.cntdwn, 1);
+}
+
+/*
+ * Launch the notifications that are due. Return the time the next one is due,
+ * or the time the queue of upcoming appointments has to be extended.
+ */
+static time_t dmon_notify(time_t now)
+{
+	struct notify_app a;
+	time_t wake;
+
+	while (notify_queue_first(&a, now)) {
+		wake = dmon_due(&a);
+		if (wake > now) {
+			mem_free(a.txt);
+			return MIN(wake, notify_queue_until());
+		}
+		notify_update_app(a.time, a.state, a.txt);
+		if (notify_needs_reminder()) {
+			DMON_LOG(_("launching notification at %s for: "
+				   "\"%s\"\n"), nowstr(), notify_app_txt());
+			if (!notify_launch_cmd())
+				DMON_LOG(_("error while sending "
+					   "notification\n"));
+		}
+		mem_free(a.txt);
+		notify_queue_pop();
+	}
+
+	return notify_queue_until();
+}
+
+/* Fill in the address of the socket of the daemon. */
+static int dmon_sockaddr(struct sockaddr_un *addr)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (strlen(path_dsock) >= sizeof(addr->sun_path))
+		return 0;
+	strcpy(addr->sun_path, path_dsock);
+	return 1;
+}
+
+/* Listen for queries on a socket only the user has access to. */
+static void dmon_listen(void)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	mode_t mask;
+	int ret;
+
+	if (!dmon_sockaddr(&addr)) {
+		DMON_LOG(_("Socket path too long: %s\n"), path_dsock);
+		return;
+	}
+	if ((dmon_sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		DMON_LOG(_("Could not create socket: %s\n"), strerror(errno));
+		return;
+	}
+	fcntl(dmon_sock, F_SETFD, FD_CLOEXEC);
+
+	/* Left behind by a daemon that was killed. */
+	unlink(path_dsock);
+	mask = umask(0077);
+	ret = bind(dmon_sock, (struct sockaddr *)&addr, sizeof(addr));
+	umask(mask);
+	if (ret < 0 || listen(dmon_sock, SOMAXCONN) < 0 ||
+	    stat(path_dsock, &st) < 0) {
+		DMON_LOG(_("Could not listen on \"%s\": %s\n"), path_dsock,
+			 strerror(errno));
+		close(dmon_sock);
+		dmon_sock = -1;
+		return;
+	}
+	dmon_sock_ino = st.st_ino;
+}
+
+/*
+ * Read a query: the file descriptors of the standard output and error of the
+ * client, followed by its working directory, its time zone and the command
+ * line arguments, all terminated by a null character.
+ */
+static int dmon_read_query(int fd, int fds[2], struct string *s)
+{
+	union {
+		struct cmsghdr h;
+		char buf[CMSG_SPACE(2 * sizeof(int))];
+	} ctl;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char buf[BUFSIZ];
+	ssize_t n;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctl.buf;
+	msg.msg_controllen = sizeof(ctl.buf);
+
+	if ((n = recvmsg(fd, &msg, 0)) <= 0)
+		return 0;
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+	    cmsg->cmsg_type != SCM_RIGHTS ||
+	    cmsg->cmsg_len != CMSG_LEN(2 * sizeof(int)))
+		return 0;
+	memcpy(fds, CMSG_DATA(cmsg), 2 * sizeof(int));
+
+	do {
+		string_grow(s, s->len + n + 1);
+		memcpy(s->buf + s->len, buf, n);
+		s->len += n;
+		s->buf[s->len] = '\0';
+	} while ((n = read(fd, buf, sizeof(buf))) > 0);
+
+	return n == 0 && s->len > 0 && s->buf[s->len - 1] == '\0';
+}
+
+/*
+ * Run a query in a process of its own, which writes to the output of the
+ * client directly and may exit anywhere, and return its exit status.
+ */
+static unsigned char dmon_run(int fd, int fds[2], char *cwd, int argc,
+			      char **argv)
+{
+	int status;
+	pid_t pid;
+
+	pid = fork();
+	if (pid == 0) {
+		dup2(fds[0], STDOUT_FILENO);
+		dup2(fds[1], STDERR_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		close(fd);
+		EXIT_IF(*cwd && chdir(cwd) != 0, _("%s: %s"), cwd,
+			strerror(errno));
+
+		dmon_served = 1;
+		io_keep_data();
+		optind = 1;
+		status = parse_args(argc, argv) ? EXIT_SUCCESS : EXIT_FAILURE;
+		/* Freeing the items would copy all of them. */
+		fflush(stdout);
+		_exit(status);
+	}
+	if (pid > 0 && waitpid(pid, &status, 0) == pid &&
+	    WIFEXITED(status) && WEXITSTATUS(status) != DMON_DECLINED)
+		return WEXITSTATUS(status);
+	return EXIT_FAILURE;
+}
+
+/*
+ * Answer a query in a process of its own, and send the exit status of the
+ * command back. The items were loaded in the time zone of the daemon: queries
+ * from another time zone are declined, for the client to evaluate them.
+ */
+static void dmon_answer(int fd)
+{
+	struct string s;
+	char *p, *cwd, *tz, *dtz, **argv;
+	int fds[2], argc;
+	unsigned char ret;
+
+	sigs_set_hdlr(SIGINT, SIG_DFL);
+	sigs_set_hdlr(SIGTERM, SIG_DFL);
+	sigs_set_hdlr(SIGALRM, SIG_DFL);
+	sigs_set_hdlr(SIGQUIT, SIG_DFL);
+
+	string_init(&s);
+	if (!dmon_read_query(fd, fds, &s))
+		exit(EXIT_FAILURE);
+
+	argv = mem_calloc(s.len, sizeof(char *));
+	cwd = s.buf;
+	tz = cwd + strlen(cwd) + 1;
+	argc = 0;
+	for (p = tz + strlen(tz) + 1; p < s.buf + s.len; p += strlen(p) + 1)
+		argv[argc++] = p;
+	argv[argc] = NULL;
+	if (argc == 0)
+		exit(EXIT_FAILURE);
+
+	dtz = getenv("TZ");
+	if (strcmp(tz, dtz ? dtz : "") == 0) {
+		ret = dmon_run(fd, fds, cwd, argc, argv);
+	} else {
+		DMON_LOG(_("declining a query from time zone \"%s\"\n"), tz);
+		ret = DMON_DECLINED;
+	}
+	if (write(fd, &ret, 1) != 1)
+		exit(EXIT_FAILURE);
+	exit(EXIT_SUCCESS);
+}
+
+/* Answer a query, with the items of the data files as they are now. */
+static void dmon_serve(void)
+{
+	int fd;
+
+	if ((fd = accept(dmon_sock, NULL, NULL)) < 0)
+		return;
+	DMON_LOG(_("answering a query at %s\n"), nowstr());
+
+	if (io_reload_data() == IO_RELOAD_LOAD)
+		notify_queue_reload();
+
+	switch (fork()) {
+	case -1:
+		DMON_LOG(_("Could not fork: %s\n"), strerror(errno));
+		break;
+	case 0:
+		close(dmon_sock);
+		dmon_answer(fd);
+		break;
+	}
+	close(fd);
+}
+
+/*
+ * Sleep until the given time, or until a signal or a query is received. The
+ * time is set on a timer of the real-time clock where available, which also
+ * expires on time after the clock was set or the system suspended.
+ */
+static void dmon_wait(time_t wake)
+{
+	struct pollfd pfd[3];
+	struct timespec ts;
+	char buf[64];
+	int n = 0, timeout;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	if (wake - ts.tv_sec > DMON_SLEEP_TIME)
+		timeout = DMON_SLEEP_TIME * 1000;
+	else if (wake > ts.tv_sec)
+		timeout = (wake - ts.tv_sec) * 1000 - ts.tv_nsec / 1000000;
+	else
+		timeout = 0;
+
+#ifdef HAVE_SYS_TIMERFD_H
+	if (dmon_timer >= 0) {
+		struct itimerspec its;
+		int flags = TFD_TIMER_ABSTIME;
+
+#ifdef TFD_TIMER_CANCEL_ON_SET
+		flags |= TFD_TIMER_CANCEL_ON_SET;
+#endif
+		memset(&its, 0, sizeof(its));
+		its.it_value.tv_sec = wake;
+		if (timeout > 0 &&
+		    timerfd_settime(dmon_timer, flags, &its, NULL) == 0) {
+			pfd[n].fd = dmon_timer;
+			pfd[n++].events = POLLIN;
+			timeout = -1;
+		}
+	}
+#endif
+	if (dmon_pipe[0] >= 0) {
+		pfd[n].fd = dmon_pipe[0];
+		pfd[n++].events = POLLIN;
+	}
+	if (dmon_sock >= 0) {
+		pfd[n].fd = dmon_sock;
+		pfd[n++].events = POLLIN;
+	}
+
+	if (poll(pfd, n, timeout) <= 0)
+		return;
+	while (n-- > 0) {
+		if (!(pfd[n].revents & POLLIN))
+			continue;
+		if (pfd[n].fd == dmon_sock)
+			dmon_serve();
+		else
+			while (read(pfd[n].fd, buf, sizeof(buf)) > 0)
+				;
+	}
+}
+
 void dmon_start(int parent_exit_status)
 {
 	if (!daemonize(parent_exit_status))
@@ -172,42 +521,115 @@ void dmon_start(int parent_exit_status)
 	todo_init_list();
 	io_load_app(NULL);
 	data_loaded = 1;
+	if (dmon.socket)
+		dmon_listen();
+#ifdef HAVE_SYS_TIMERFD_H
+	dmon_timer = timerfd_create(CLOCK_REALTIME,
+				    TFD_NONBLOCK | TFD_CLOEXEC);
+#endif
+	notify_queue_build(1);
 
 	DMON_LOG(_("started at %s\n"), nowstr());
 	for (;;) {
-		int left;
+		time_t now, wake;
 
 		if (want_reload) {
 			want_reload = 0;
-			io_reload_data();
-			notify_check_next_app(1);
-		}
-
-		if (!notify_get_next_bkgd())
-			DMON_ABRT(_("error loading next appointment\n"));
-
-		left = notify_time_left();
-		if (left > 0 &&
-		    left <= MAX(DMON_SLEEP_TIME, nbar.cntdwn) &&
-		    notify_needs_reminder()) {
-			DMON_LOG(_("launching notification at %s for: \"%s\"\n"),
-				 nowstr(), notify_app_txt());
-			if (!notify_launch_cmd())
-				DMON_LOG(_("error while sending notification\n"));
+			if (io_reload_data() == IO_RELOAD_LOAD)
+				notify_queue_reload();
 		}
 
+		now = dmon_now();
+		wake = dmon_notify(now);
 		DMON_LOG(ngettext("sleeping at %s for %d second\n",
 				  "sleeping at %s for %d seconds\n",
-				  DMON_SLEEP_TIME), nowstr(),
-			 DMON_SLEEP_TIME);
-		psleep(DMON_SLEEP_TIME);
+				  wake - now), nowstr(), (int)(wake - now));
+		dmon_wait(wake);
 		DMON_LOG(_("awakened at %s\n"), nowstr());
-		/* Reap the user-defined notifications. */
+		/* Reap the notifications and answered queries. */
 		while (waitpid(0, NULL, WNOHANG) > 0)
 			;
 	}
 }
 
+/*
+ * Forward a command to the daemon, see dmon_answer(), and return its exit
+ * status. Return -1 if no daemon is listening or if it declined the command,
+ * for the command to be run here.
+ */
+int dmon_query(int argc, char **argv)
+{
+	union {
+		struct cmsghdr h;
+		char buf[CMSG_SPACE(2 * sizeof(int))];
+	} ctl;
+	struct sockaddr_un addr;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	struct string s;
+	char buf[BUFSIZ];
+	const char *tz;
+	int fd, i, fds[2] = { STDOUT_FILENO, STDERR_FILENO };
+	unsigned char ret = EXIT_FAILURE;
+	ssize_t n;
+	size_t off;
+
+	if (dmon_served || !dmon_sockaddr(&addr))
+		return -1;
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return -1;
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	string_init(&s);
+	if (getcwd(buf, sizeof(buf)))
+		string_cat(&s, buf);
+	string_catc(&s, '\0');
+	if ((tz = getenv("TZ")))
+		string_cat(&s, tz);
+	string_catc(&s, '\0');
+	for (i = 0; i < argc; i++) {
+		string_cat(&s, argv[i]);
+		string_catc(&s, '\0');
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctl, 0, sizeof(ctl));
+	iov.iov_base = s.buf;
+	iov.iov_len = s.len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctl.buf;
+	msg.msg_controllen = sizeof(ctl.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+	memcpy(CMSG_DATA(cmsg), fds, 2 * sizeof(int));
+
+	/* A daemon going away must not kill the client. */
+	sigs_set_hdlr(SIGPIPE, SIG_IGN);
+	if ((n = sendmsg(fd, &msg, 0)) < 0) {
+		mem_free(s.buf);
+		close(fd);
+		return -1;
+	}
+	for (off = n; off < s.len; off += n) {
+		if ((n = write(fd, s.buf + off, s.len - off)) < 0)
+			break;
+	}
+	mem_free(s.buf);
+
+	shutdown(fd, SHUT_WR);
+	if (n < 0 || read(fd, &ret, 1) != 1)
+		ret = EXIT_FAILURE;
+	close(fd);
+	return ret == DMON_DECLINED ? -1 : ret;
+}
+
 /*
  * Check if calcurse is running in background, and if yes, send a SIGINT
  * signal to stop it.
@@ -40,7 +40,6 @@
 #include <time.h>
 
 #include "calcurse.h"
-#include "sha1.h"
 
 llist_t eventlist;
 /* Dummy event for the APP panel for an otherwise empty day. */
@@ -65,6 +64,7 @@ struct event *event_dup(struct event *in)
 		ev->note = mem_strdup(in->note);
 	else
 		ev->note = NULL;
+	ev->digest.valid = 0;
 
 	return ev;
 }
@@ -90,8 +90,19 @@ static int event_cmp(struct event *a, struct event *b)
 	return strcmp(a->mesg, b->mesg);
 }
 
-/* Create a new event */
-struct event *event_new(char *mesg, char *note, time_t day, int id)
+/* Sort a list of events after a bulk load. */
+void event_llist_sort(llist_t *l)
+{
+	LLIST_SORT(l, event_cmp);
+}
+
+/* Merge n sorted lists of events into the event list. */
+void event_llist_merge(llist_t *lists, unsigned n)
+{
+	LLIST_MERGE(&eventlist, lists, n, event_cmp);
+}
+
+struct event *event_alloc(char *mesg, char *note, time_t day, int id)
 {
 	struct event *ev;
 
@@ -100,6 +111,15 @@ struct event *event_new(char *mesg, char *note, time_t day, int id)
 	ev->day = day;
 	ev->id = id;
 	ev->note = (note != NULL) ? mem_strdup(note) : NULL;
+	ev->digest.valid = 0;
+
+	return ev;
+}
+
+/* Create a new event */
+struct event *event_new(char *mesg, char *note, time_t day, int id)
+{
+	struct event *ev = event_alloc(mesg, note, day, id);
 
 	LLIST_ADD_SORTED(&eventlist, ev, event_cmp);
 
@@ -112,33 +132,48 @@ unsigned event_inday(struct event *i, time_t *start)
 	return (date_cmp_day(i->day, *start) == 0);
 }
 
+/* Append an event in the format of the data file. */
+void event_append(struct string *s, struct event *o)
+{
+	struct tm lt;
+
+	date_localtime(&o->day, &lt);
+	string_catdate(s, &lt);
+	string_cat(s, " [");
+	string_catnum(s, o->id, 0);
+	string_cat(s, "] ");
+	if (o->note != NULL) {
+		string_catc(s, '>');
+		string_cat(s, o->note);
+		string_catc(s, ' ');
+	}
+	string_cat(s, o->mesg);
+}
+
 char *event_tostr(struct event *o)
 {
 	struct string s;
-	struct tm lt;
-	time_t t;
 
 	string_init(&s);
-
-	t = o->day;
-	localtime_r(&t, &lt);
-	string_catf(&s, "%02u/%02u/%04u [%d] ", lt.tm_mon + 1, lt.tm_mday,
-		1900 + lt.tm_year, o->id);
-	if (o->note != NULL)
-		string_catf(&s, ">%s ", o->note);
-	string_catf(&s, "%s", o->mesg);
+	event_append(&s, o);
 
 	return string_buf(&s);
 }
 
-char *event_hash(struct event *ev)
+/* Return the digest of an event, computing it on first use. */
+static struct item_digest *event_digest(struct event *ev)
 {
-	char *raw = event_tostr(ev);
-	char *sha1 = mem_malloc(SHA1_DIGESTLEN * 2 + 1);
-	sha1_digest(raw, sha1);
-	mem_free(raw);
+	if (!ev->digest.valid) {
+		char *raw = event_tostr(ev);
+		item_digest_compute(&ev->digest, raw);
+	}
+
+	return &ev->digest;
+}
 
-	return sha1;
+char *event_hash(struct event *ev)
+{
+	return item_digest_hex(event_digest(ev));
 }
 
 void event_write(struct event *o, FILE * f)
@@ -148,27 +183,16 @@ void event_write(struct event *o, FILE * f)
 	mem_free(str);
 }
 
-/* Load the events from file */
-char *event_scan(FILE * f, struct tm start, int id, char *note,
-			 struct item_filter *filter)
+/* Load an event from file, or only check it if l is NULL. */
+char *event_scan(llist_t *l, char *mesg, struct tm start, int id,
+			 char *note)
 {
-	char buf[BUFSIZ], *nl;
-	time_t tstart, tend;
-	struct event *ev = NULL;
-	int cond;
+	time_t tstart;
 
 	if (!check_date(start.tm_year, start.tm_mon, start.tm_mday) ||
 	    !check_time(start.tm_hour, start.tm_min))
 		return _("illegal date in event");
 
-	/* Read the event description */
-	if (!fgets(buf, sizeof buf, f))
-		return _("error in appointment description");
-
-	nl = strchr(buf, '\n');
-	if (nl) {
-		*nl = '\0';
-	}
 	start.tm_hour = 0;
 	start.tm_min = 0;
 	start.tm_sec = 0;
@@ -176,39 +200,50 @@ char *event_scan(FILE * f, struct tm start, int id, char *note,
 	start.tm_year -= 1900;
 	start.tm_mon--;
 
-	tstart = mktime(&start);
+	tstart = date_mktime(&start);
 	if (tstart == -1)
 		return _("date error in event\n");
-	tend = ENDOFDAY(tstart);
-
-	/* Filter item. */
-	if (filter) {
-		cond = (
-		    !(filter->type_mask & TYPE_MASK_EVNT) ||
-		    (filter->regex && regexec(filter->regex, buf, 0, 0, 0)) ||
-		    (filter->start_from != -1 && tstart < filter->start_from) ||
-		    (filter->start_to != -1 && tstart > filter->start_to) ||
-		    (filter->end_from != -1 && tend < filter->end_from) ||
-		    (filter->end_to != -1 && tend > filter->end_to)
-		);
-		if (filter->hash) {
-			ev = event_new(buf, note, tstart, id);
-			char *hash = event_hash(ev);
-			cond = cond || !hash_matches(filter->hash, hash);
-			mem_free(hash);
-		}
-
-		if ((!filter->invert && cond) || (filter->invert && !cond)) {
-			if (filter->hash)
-				event_delete(ev);
-			return NULL;
-		}
-	}
-	if (!ev)
-		ev = event_new(buf, note, tstart, id);
+
+	/* Appended unsorted, see event_llist_merge(). */
+	if (l)
+		LLIST_ADD(l, event_alloc(mesg, note, tstart, id));
 	return NULL;
 }
 
+/* Check whether an event is selected by a filter. */
+static int event_filter_match(struct event *ev, struct item_filter *filter)
+{
+	time_t tstart = ev->day, tend = ENDOFDAY(ev->day);
+	int cond;
+
+	cond = (
+	    !(filter->type_mask & TYPE_MASK_EVNT) ||
+	    (filter->regex && regexec(filter->regex, ev->mesg, 0, 0, 0)) ||
+	    (filter->start_from != -1 && tstart < filter->start_from) ||
+	    (filter->start_to != -1 && tstart > filter->start_to) ||
+	    (filter->end_from != -1 && tend < filter->end_from) ||
+	    (filter->end_to != -1 && tend > filter->end_to)
+	);
+	if (filter->hash) {
+		cond = cond ||
+		    !item_digest_matches(filter->hash, event_digest(ev));
+	}
+
+	return filter->invert ? cond : !cond;
+}
+
+/* Drop the events for which fn_match() returns false. */
+void event_llist_keep(void *data, llist_fn_match_t fn_match)
+{
+	LLIST_FILTER(&eventlist, data, fn_match, event_free);
+}
+
+/* Drop the events that are not selected by a filter. */
+void event_llist_filter(struct item_filter *filter)
+{
+	event_llist_keep(filter, (llist_fn_match_t)event_filter_match);
+}
+
 /* Delete an event from the list. */
 void event_delete(struct event *ev)
 {
@@ -223,6 +258,7 @@ void event_delete(struct event *ev)
 void event_paste_item(struct event *ev, time_t date)
 {
 	ev->day = date;
+	ev->digest.valid = 0;
 	LLIST_ADD_SORTED(&eventlist, ev, event_cmp);
 }
 
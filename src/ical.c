@@ -277,7 +277,8 @@ static void ical_export_footer(FILE * stream)
 /* Export recurrent events. */
 static void ical_export_recur_events(FILE * stream, int export_uid)
 {
-	llist_item_t *i, *j;
+	llist_item_t *i;
+	unsigned k;
 	char ical_date[BUFSIZ], *hash;
 
 	LLIST_FOREACH(&recur_elist, i) {
@@ -291,14 +292,14 @@ static void ical_export_recur_events(FILE * stream, int export_uid)
 		date_sec2date_fmt(rev->day, ICALDATEFMT, ical_date);
 		fprintf(stream, "DTSTART;VALUE=DATE:%s\n", ical_date);
 		ical_export_rrule(stream, rev->rpt, EVENT, ical_date);
-		if (LLIST_FIRST(&rev->exc)) {
+		if (rev->exc.count) {
 			fputs("EXDATE;VALUE=DATE:", stream);
-			LLIST_FOREACH(&rev->exc, j) {
-				struct excp *exc = LLIST_GET_DATA(j);
-				date_sec2date_fmt(exc->st, ICALDATETIMEFMT,
-						  ical_date);
+			for (k = 0; k < rev->exc.count; k++) {
+				date_sec2date_fmt(rev->exc.st[k],
+						  ICALDATETIMEFMT, ical_date);
 				fprintf(stream, "%s", ical_date);
-				fputc(LLIST_NEXT(j) ? ',' : '\n', stream);
+				fputc(k + 1 < rev->exc.count ? ',' : '\n',
+				      stream);
 			}
 		}
 		ical_format_line(stream, "SUMMARY:", rev->mesg);
@@ -334,7 +335,8 @@ static void ical_export_events(FILE * stream, int export_uid)
 /* Export recurrent appointments. */
 static void ical_export_recur_apoints(FILE * stream, int export_uid)
 {
-	llist_item_t *i, *j;
+	llist_item_t *i;
+	unsigned k;
 	char ical_datetime[BUFSIZ], *hash;
 	time_t tod;
 
@@ -368,14 +370,15 @@ static void ical_export_recur_apoints(FILE * stream, int export_uid)
 				rapt->dur % MININSEC);
 		}
 		ical_export_rrule(stream, rapt->rpt, APPOINTMENT, ical_datetime);
-		if (LLIST_FIRST(&rapt->exc)) {
+		if (rapt->exc.count) {
 			fputs("EXDATE:", stream);
-			LLIST_FOREACH(&rapt->exc, j) {
-				struct excp *exc = LLIST_GET_DATA(j);
-				date_sec2date_fmt(exc->st + tod, ICALDATETIMEFMT,
+			for (k = 0; k < rapt->exc.count; k++) {
+				date_sec2date_fmt(rapt->exc.st[k] + tod,
+						  ICALDATETIMEFMT,
 						  ical_datetime);
 				fprintf(stream, "%s", ical_datetime);
-				fputc(LLIST_NEXT(j) ? ',' : '\n', stream);
+				fputc(k + 1 < rapt->exc.count ? ',' : '\n',
+				      stream);
 			}
 		}
 		ical_format_line(stream, "SUMMARY:", rapt->mesg);
@@ -514,7 +517,7 @@ static void ical_store_todo(int priority, int completed, char *mesg,
  */
 static void
 ical_store_event(char *mesg, char *note, time_t day, time_t end,
-		 struct rpt *rpt, llist_t *exc, const char *fmt_ev,
+		 struct rpt *rpt, exc_list_t *exc, const char *fmt_ev,
 		 const char *fmt_rev)
 {
 	const int EVENTID = 1;
@@ -531,6 +534,7 @@ ical_store_event(char *mesg, char *note, time_t day, time_t end,
 	 */
 	if (rpt) {
 		rpt->exc = *exc;
+		recur_exc_init(exc);
 		rev = recur_event_new(mesg, note, day, EVENTID, rpt);
 		if (fmt_rev)
 			print_recur_event(fmt_rev, day, rev);
@@ -558,6 +562,7 @@ ical_store_event(char *mesg, char *note, time_t day, time_t end,
 	LLIST_INIT(&tmp.bywday);
 	LLIST_INIT(&tmp.bymonthday);
 	tmp.exc = *exc;
+	recur_exc_init(exc);
 	rev = recur_event_new(mesg, note, day, EVENTID, &tmp);
 	if (fmt_rev)
 		print_recur_event(fmt_rev, day, rev);
@@ -569,7 +574,7 @@ cleanup:
 
 static void
 ical_store_apoint(char *mesg, char *note, time_t start, long dur,
-		  struct rpt *rpt, llist_t *exc, int has_alarm,
+		  struct rpt *rpt, exc_list_t *exc, int has_alarm,
 		  const char *fmt_apt, const char *fmt_rapt)
 {
 	char state = 0L;
@@ -602,6 +607,7 @@ ical_store_apoint(char *mesg, char *note, time_t start, long dur,
 				rpt->until = day;
 		}
 		rpt->exc = *exc;
+		recur_exc_init(exc);
 		rapt = recur_apoint_new(mesg, note, start, dur, state, rpt);
 		if (fmt_rapt)
 			print_recur_apoint(fmt_rapt, start, rapt->start, rapt);
@@ -1213,15 +1219,9 @@ static struct rpt *ical_read_rrule(FILE *log, char *rrulestr,
 		}
 	}
 
-	return rpt;
-}
+	recur_rpt_compile(rpt);
 
-static void ical_add_exc(llist_t * exc_head, time_t date)
-{
-	struct excp *exc = mem_malloc(sizeof(struct excp));
-	exc->st = date;
-
-	LLIST_ADD(exc_head, exc);
+	return rpt;
 }
 
 /*
@@ -1229,7 +1229,7 @@ static void ical_add_exc(llist_t * exc_head, time_t date)
  * recurring calendar component.
  */
 static int
-ical_read_exdate(llist_t * exc, FILE * log, char *exstr, unsigned *noskipped,
+ical_read_exdate(exc_list_t *exc, FILE * log, char *exstr, unsigned *noskipped,
 		 const int itemline, ical_vevent_e type)
 {
 	char *p, *q, *tzid = NULL;
@@ -1257,7 +1257,7 @@ ical_read_exdate(llist_t * exc, FILE * log, char *exstr, unsigned *noskipped,
 				 _("invalid exception."));
 			goto cleanup;
 		}
-		ical_add_exc(exc, t);
+		recur_add_exc(exc, t);
 		p = strchr(p, '\0') + 1;
 		n--;
 	}
@@ -1360,7 +1360,7 @@ ical_read_event(FILE * fdi, FILE * log, unsigned *noevents,
 	char *dtstart, *dtend, *duration, *rrule;
 	struct string s, exdate;
 	struct {
-		llist_t exc;
+		exc_list_t exc;
 		struct rpt *rpt;
 		int count;
 		char *mesg, *desc, *loc, *comm, *imp, *note;
@@ -1372,7 +1372,7 @@ ical_read_event(FILE * fdi, FILE * log, unsigned *noevents,
 
 	vevent_type = UNDEFINED;
 	memset(&vevent, 0, sizeof vevent);
-	LLIST_INIT(&vevent.exc);
+	recur_exc_init(&vevent.exc);
 	note = dtstart = dtend = duration = rrule = NULL;
 	skip_alarm = has_note = separator = has_exdate =0;
 	while (ical_readline(fdi, buf, lstore, lineno)) {
@@ -1712,7 +1712,7 @@ cleanup:
 		mem_free(vevent.mesg);
 	if (vevent.rpt)
 		mem_free(vevent.rpt);
-	LLIST_FREE(&vevent.exc);
+	recur_free_exc_list(&vevent.exc);
 }
 
 static void
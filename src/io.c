@@ -35,6 +35,7 @@
  */
 
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -44,9 +45,10 @@
 #include <math.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 
 #include "calcurse.h"
-#include "sha1.h"
 
 struct ht_keybindings_s {
 	const char *label;
@@ -65,9 +67,39 @@ HTABLE_PROTOTYPE(ht_keybindings, ht_keybindings_s)
     HTABLE_GENERATE(ht_keybindings, ht_keybindings_s, load_keys_ht_getkey,
 		load_keys_ht_compare)
 
+/* Amount of data written at once when saving a data file. */
+#define IO_SAVE_CHUNK	(64 * 1024)
+
+/* Status of a data file, as it was last loaded or saved. */
+struct io_file_stat {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	long mtime_nsec;
+};
+
 static int modified = 0;
 static char apts_sha1[SHA1_DIGESTLEN * 2 + 1];
 static char todo_sha1[SHA1_DIGESTLEN * 2 + 1];
+static struct io_file_stat apts_stat;
+static struct io_file_stat todo_stat;
+
+/*
+ * The journal holds changes to the appointment file, one per line: "+" and an
+ * item line for an addition, "-" and the hash of an item for a deletion. The
+ * first line ties it to the appointment file it applies to, by checksum.
+ */
+#define JOURNAL_MAGIC	"calcurse journal "
+/* Size below which the journal is not folded into the appointment file. */
+#define JOURNAL_MIN	(16 * 1024)
+
+static char journal_sha1[SHA1_DIGESTLEN * 2 + 1];
+static struct io_file_stat journal_stat;
+/* Changes since the last save, in the format of the journal. */
+static struct string journal_pending;
+/* Set if the next save has to rewrite the appointment file. */
+static int journal_rewrite = 1;
 
 /* Ask user for a file name to export data to. */
 static FILE *get_export_stream(enum export_type type)
@@ -191,9 +223,12 @@ void io_init(const char *cfile, const char *datadir, const char *confdir)
 	} else {
 		asprintf(&path_apts, "%s%s", path_ddir, APTS_PATH_NAME);
 	}
+	asprintf(&path_journal, "%s%s", path_apts, JOURNAL_SUFFIX);
 	asprintf(&path_todo, "%s%s", path_ddir, TODO_PATH_NAME);
 	asprintf(&path_cpid, "%s%s", path_ddir, CPID_PATH_NAME);
 	asprintf(&path_dpid, "%s%s", path_ddir, DPID_PATH_NAME);
+	asprintf(&path_dsock, "%s%s", path_ddir, DSOCK_PATH_NAME);
+	asprintf(&path_snap, "%s%s", path_ddir, SNAP_PATH_NAME);
 	asprintf(&path_notes, "%s%s", path_ddir, NOTES_DIR_NAME);
 	asprintf(&path_dmon_log, "%s%s", path_ddir, DLOG_PATH_NAME);
 
@@ -229,6 +264,13 @@ static void io_mutex_unlock(void)
 	pthread_mutex_unlock(&io_mutex);
 }
 
+/* Record that there is no journal. */
+static void io_journal_forget(void)
+{
+	memset(&journal_stat, 0, sizeof(journal_stat));
+	sha1_buffer("", 0, journal_sha1);
+}
+
 /* Print all appointments and events to stdout. */
 void io_dump_apts(const char *fmt_apt, const char *fmt_rapt,
 		  const char *fmt_ev, const char *fmt_rev)
@@ -260,6 +302,57 @@ void io_dump_apts(const char *fmt_apt, const char *fmt_rapt,
 	}
 }
 
+/*
+ * Open a data file for saving, or return the standard output if no file is
+ * given. Returns -1 on failure.
+ */
+static int io_save_open(const char *file)
+{
+	if (!file) {
+		fflush(stdout);
+		return STDOUT_FILENO;
+	}
+	return open(file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+}
+
+/* Write out the save buffer and empty it. */
+static void io_save_flush(int fd, struct string *s)
+{
+	char *p = s->buf;
+	int left = s->len;
+	ssize_t n;
+
+	while (left > 0) {
+		n = write(fd, p, left);
+		if (n < 0 && errno == EINTR)
+			continue;
+		EXIT_IF(n < 0, _("Error when writing file at %s"),
+			__FILE_POS__);
+		p += n;
+		left -= n;
+	}
+	s->len = 0;
+	*s->buf = '\0';
+}
+
+/* Terminate the item in the save buffer, flushing it once it is large. */
+static void io_save_line(int fd, struct string *s)
+{
+	string_catc(s, '\n');
+	if (s->len >= IO_SAVE_CHUNK)
+		io_save_flush(fd, s);
+}
+
+/* Write out what is left in the save buffer and close the file. */
+static void io_save_close(int fd, struct string *s)
+{
+	io_save_flush(fd, s);
+	mem_free(s->buf);
+	if (fd != STDOUT_FILENO)
+		EXIT_IF(close(fd) != 0, _("Error when closing file at %s"),
+			__FILE_POS__);
+}
+
 /*
  * Save the apts data file, which contains the
  * appointments first, and then the events.
@@ -268,36 +361,53 @@ void io_dump_apts(const char *fmt_apt, const char *fmt_rapt,
 unsigned io_save_apts(const char *aptsfile)
 {
 	llist_item_t *i;
-	FILE *fp;
+	struct string s;
+	int fd;
 
-	if (aptsfile) {
-		if (read_only)
-			return 1;
+	if (aptsfile && read_only)
+		return 1;
+	if ((fd = io_save_open(aptsfile)) < 0)
+		return 0;
 
-		if ((fp = fopen(aptsfile, "w")) == NULL)
-			return 0;
-	} else {
-		fp = stdout;
+	/* Items are formatted into one buffer, written out in large chunks. */
+	string_init(&s);
+	string_grow(&s, IO_SAVE_CHUNK + IO_SAVE_CHUNK / 2);
+
+	LLIST_FOREACH(&recur_elist, i) {
+		recur_event_append(&s, LLIST_GET_DATA(i));
+		io_save_line(fd, &s);
 	}
 
-	recur_save_data(fp);
+	LLIST_TS_RDLOCK(&recur_alist_p);
+	LLIST_TS_FOREACH(&recur_alist_p, i) {
+		recur_apoint_append(&s, LLIST_GET_DATA(i));
+		io_save_line(fd, &s);
+	}
+	LLIST_TS_UNLOCK(&recur_alist_p);
 
 	if (ui_mode == UI_CURSES)
-		LLIST_TS_LOCK(&alist_p);
+		LLIST_TS_RDLOCK(&alist_p);
 	LLIST_TS_FOREACH(&alist_p, i) {
-		struct apoint *apt = LLIST_TS_GET_DATA(i);
-		apoint_write(apt, fp);
+		apoint_append(&s, LLIST_TS_GET_DATA(i));
+		io_save_line(fd, &s);
 	}
 	if (ui_mode == UI_CURSES)
 		LLIST_TS_UNLOCK(&alist_p);
 
 	LLIST_FOREACH(&eventlist, i) {
-		struct event *ev = LLIST_TS_GET_DATA(i);
-		event_write(ev, fp);
+		event_append(&s, LLIST_GET_DATA(i));
+		io_save_line(fd, &s);
 	}
 
-	if (aptsfile)
-		file_close(fp, __FILE_POS__);
+	io_save_close(fd, &s);
+
+	if (aptsfile) {
+		/* The journal is part of the appointment file now. */
+		if (strcmp(aptsfile, path_apts) == 0) {
+			unlink(path_journal);
+			io_journal_forget();
+		}
+	}
 
 	return 1;
 }
@@ -317,25 +427,23 @@ void io_dump_todo(const char *fmt_todo)
 unsigned io_save_todo(const char *todofile)
 {
 	llist_item_t *i;
-	FILE *fp;
+	struct string s;
+	int fd;
 
-	if (todofile) {
-		if (read_only)
-			return 1;
+	if (todofile && read_only)
+		return 1;
+	if ((fd = io_save_open(todofile)) < 0)
+		return 0;
 
-		if ((fp = fopen(todofile, "w")) == NULL)
-			return 0;
-	} else {
-		fp = stdout;
-	}
+	string_init(&s);
+	string_grow(&s, IO_SAVE_CHUNK + IO_SAVE_CHUNK / 2);
 
 	LLIST_FOREACH(&todolist, i) {
-		struct todo *todo = LLIST_TS_GET_DATA(i);
-		todo_write(todo, fp);
+		todo_append(&s, LLIST_GET_DATA(i));
+		io_save_line(fd, &s);
 	}
 
-	if (todofile)
-		file_close(fp, __FILE_POS__);
+	io_save_close(fd, &s);
 
 	return 1;
 }
@@ -357,405 +465,1609 @@ unsigned io_save_keys(void)
 	return 1;
 }
 
-static int io_compute_hash(const char *path, char *buf)
+static void io_file_stat_set(struct io_file_stat *fs, struct stat *st)
+{
+	fs->dev = st->st_dev;
+	fs->ino = st->st_ino;
+	fs->size = st->st_size;
+	fs->mtime = st->st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+	fs->mtime_nsec = st->st_mtim.tv_nsec;
+#else
+	fs->mtime_nsec = 0;
+#endif
+}
+
+static int io_file_stat_equal(struct io_file_stat *a, struct io_file_stat *b)
+{
+	return a->dev == b->dev && a->ino == b->ino && a->size == b->size &&
+	       a->mtime == b->mtime && a->mtime_nsec == b->mtime_nsec;
+}
+
+/* Compute the hash of a file and record its status. */
+static int io_compute_hash(const char *path, char *buf,
+			   struct io_file_stat *fs)
 {
 	FILE *fp = fopen(path, "r");
+	struct stat st;
+
+	if (!fp)
+		return 0;
+	if (fstat(fileno(fp), &st) != 0) {
+		fclose(fp);
+		return 0;
+	}
+	io_file_stat_set(fs, &st);
+	sha1_stream(fp, buf);
+	fclose(fp);
+
+	return 1;
+}
+
+/* Empty the general lists of appointments and events. */
+static void io_clear_app(void)
+{
+	apoint_llist_free();
+	event_llist_free();
+	recur_apoint_llist_free();
+	recur_event_llist_free();
+	apoint_llist_init();
+	event_llist_init();
+	recur_apoint_llist_init();
+	recur_event_llist_init();
+}
+
+/* A merge implies a save operation and must be followed by reload of data. */
+static void io_merge_data(void)
+{
+	char *path_apts_new, *path_todo_new;
+	const char *new_ext = ".new";
+
+	asprintf(&path_apts_new, "%s%s", path_apts, new_ext);
+	asprintf(&path_todo_new, "%s%s", path_todo, new_ext);
+
+	io_save_apts(path_apts_new);
+	io_save_todo(path_todo_new);
+
+	/*
+	 * Fold the journal into the appointment file first, so that the merge
+	 * sees the items as they are loaded. The lists are reloaded afterwards.
+	 */
+	if (io_file_exists(path_journal)) {
+		io_clear_app();
+		io_load_app(NULL);
+		io_save_apts(path_apts);
+		day_do_storage(0);
+	}
+
+	/*
+	 * We do not directly write to the data files here; however, the
+	 * external merge tool might incorporate changes from the new file into
+	 * the main data files.
+	 */
+	run_hook("pre-save");
+
+	if (!io_files_equal(path_apts, path_apts_new)) {
+		const char *arg_apts[] = { conf.mergetool, path_apts,
+					   path_apts_new, NULL };
+		wins_launch_external(arg_apts);
+	}
+
+	if (!io_files_equal(path_todo, path_todo_new)) {
+		const char *arg_todo[] = { conf.mergetool, path_todo,
+					   path_todo_new, NULL };
+		wins_launch_external(arg_todo);
+	}
+
+	mem_free(path_apts_new);
+	mem_free(path_todo_new);
+
+	/*
+	 * We do not directly write to the data files here; however, the
+	 * external merge tool will likely have incorporated changes from the
+	 * new file into the main data files at this point.
+	 */
+	run_hook("post-save");
+
+	/*
+	 * The user has merged, so override the modified flag
+	 * (and follow up with reload of the data files).
+	 */
+	io_unset_modified();
+}
+
+/* For the return values, see io_save_cal() below. */
+static int resolve_save_conflict(void)
+{
+	char *msg_um_asktype = NULL;
+	const char *msg_um_prefix =
+			_("Data files have changed and will be overwritten:");
+	const char *msg_um_overwrite = _("(c)ontinue");
+	const char *msg_um_merge = _("(m)erge");
+	const char *msg_um_keep = _("c(a)ncel");
+	const char *msg_um_choice = _("[cma]");
+	int ret = IO_SAVE_CANCEL;
+
+	asprintf(&msg_um_asktype, "%s %s, %s, %s", msg_um_prefix,
+		 msg_um_overwrite, msg_um_merge, msg_um_keep);
+
+	switch (status_ask_choice(msg_um_asktype, msg_um_choice, 3)) {
+	case 1:
+		ret = IO_SAVE_CTINUE;
+		break;
+	case 2:
+		io_merge_data();
+		io_load_data(NULL, FORCE);
+		ret = IO_SAVE_RELOAD;
+		break;
+	case 3:
+		/* FALLTHROUGH */
+	default:
+		ret = IO_SAVE_CANCEL;
+	}
+
+	mem_free(msg_um_asktype);
+	return ret;
+}
+
+/*
+ * Return codes for new_data() and io_load_data().
+ * Note that they are file internal.
+ */
+#define NONEW		0
+#define APTS		(1 << 0)
+#define TODO		(1 << 1)
+#define APTS_TODO	APTS | TODO
+#define NOKNOW		-1
+
+/*
+ * Check whether a data file differs from its last loaded or saved version.
+ * The file is only hashed if its status changed. Return 1 if it differs, 0
+ * if it does not and -1 if it cannot be read.
+ */
+static int io_file_changed(const char *path, char *sha1,
+			   struct io_file_stat *fs)
+{
+	char sha1_new[SHA1_DIGESTLEN * 2 + 1];
+	struct io_file_stat fs_new;
+	struct stat st;
+
+	if (stat(path, &st) != 0)
+		return -1;
+	io_file_stat_set(&fs_new, &st);
+	if (io_file_stat_equal(&fs_new, fs))
+		return 0;
+
+	if (!io_compute_hash(path, sha1_new, &fs_new))
+		return -1;
+	if (strncmp(sha1_new, sha1, SHA1_DIGESTLEN * 2) != 0)
+		return 1;
+	/* Same contents, skip the hash next time. */
+	*fs = fs_new;
+	return 0;
+}
+
+/* Same as io_file_changed() for the journal, which may be missing. */
+static int io_journal_changed(void)
+{
+	char sha1_empty[SHA1_DIGESTLEN * 2 + 1];
+
+	if (access(path_journal, F_OK) == 0)
+		return io_file_changed(path_journal, journal_sha1,
+				       &journal_stat);
+	if (errno != ENOENT)
+		return -1;
+	sha1_buffer("", 0, sha1_empty);
+	return strcmp(sha1_empty, journal_sha1) != 0;
+}
+
+static int new_data()
+{
+	int ret = NONEW, changed;
+
+	if ((changed = io_file_changed(path_apts, apts_sha1, &apts_stat)) < 0)
+		return NOKNOW;
+	if (changed)
+		ret |= APTS;
+	if ((changed = io_journal_changed()) < 0)
+		return NOKNOW;
+	if (changed)
+		ret |= APTS;
+
+	if ((changed = io_file_changed(path_todo, todo_sha1, &todo_stat)) < 0)
+		return NOKNOW;
+	if (changed)
+		ret |= TODO;
+
+	return ret;
+}
+
+/*
+ * Record a change to the appointments for the journal: the item with the
+ * given hash is replaced by the item p. Either may be missing, for an addition
+ * or a deletion. The new item comes first: if the journal is torn between the
+ * two lines, the item is there twice rather than lost.
+ */
+void io_journal_update(const char *hash, struct day_item *p)
+{
+	char *line;
+
+	io_mutex_lock();
+	if (!journal_pending.buf)
+		string_init(&journal_pending);
+	if (p) {
+		line = day_item_tostr(p);
+		string_catf(&journal_pending, "+%s\n", line);
+		mem_free(line);
+	}
+	if (hash)
+		string_catf(&journal_pending, "-%s\n", hash);
+	io_mutex_unlock();
+}
+
+/*
+ * Append the changes recorded since the last save to the journal. Return 0 if
+ * the appointment file has to be rewritten instead.
+ */
+static int io_save_journal(void)
+{
+	FILE *fp;
+	off_t limit = MAX(JOURNAL_MIN, apts_stat.size / 8);
+	int err;
+
+	if (!conf.journal || journal_rewrite || !journal_pending.buf)
+		return 0;
+	if (journal_pending.len == 0)
+		return 1;
+	if (journal_stat.size + journal_pending.len > limit)
+		return 0;
+
+	if ((fp = fopen(path_journal, "a")) == NULL)
+		return 0;
+	if (journal_stat.size == 0)
+		fprintf(fp, "%s%s\n", JOURNAL_MAGIC, apts_sha1);
+	fputs(journal_pending.buf, fp);
+	err = ferror(fp);
+	err |= fclose(fp);
+
+	return !err && io_compute_hash(path_journal, journal_sha1,
+				       &journal_stat);
+}
+
+/*
+ * Save the appointments. In journal mode, the changes are appended to the
+ * journal, unless the appointment file has to be rewritten: because it was
+ * changed by someone else, or because the journal grew too large compared to
+ * it. Rewriting the appointment file drops the journal.
+ */
+static int io_save_app(int rewrite)
+{
+	if (rewrite || !io_save_journal()) {
+		if (!io_save_apts(path_apts))
+			return 0;
+		io_compute_hash(path_apts, apts_sha1, &apts_stat);
+	}
+	string_reset(&journal_pending);
+	journal_rewrite = 0;
+
+	return 1;
+}
+
+/*
+ * Fold the journal into the appointment file when quitting, if the general
+ * lists hold what was saved.
+ */
+void io_journal_compact(void)
+{
+	if (read_only || !io_file_exists(path_journal))
+		return;
+
+	io_mutex_lock();
+	if (!io_get_modified() && new_data() == NONEW) {
+		run_hook("pre-save");
+		io_save_app(1);
+		run_hook("post-save");
+	}
+	io_mutex_unlock();
+}
+
+/*
+ * Save the calendar data.
+ * The return value tells how a possible save conflict should be/was resolved:
+ * IO_SAVE_CTINUE: continue save operation and overwrite the data files
+ * IO_SAVE_RELOAD: cancel save operation (data files changed and reloaded)
+ * IO_SAVE_CANCEL: cancel save operation (user's decision, keep data files, no reload)
+ * IO_SAVE_NOOP: cancel save operation (nothing has changed)
+ * IO_SAVE_ERROR: cannot access data
+ */
+int io_save_cal(enum save_type s_t)
+{
+	int ret, new;
+
+	if (read_only)
+		return IO_SAVE_CANCEL;
+
+	io_mutex_lock();
+	if ((new = new_data()) == NOKNOW) {
+		ret = IO_SAVE_ERROR;
+		goto cleanup;
+	}
+	if (new) { /* New data */
+		if (s_t == periodic) {
+			ret = IO_SAVE_CANCEL;
+			goto cleanup;
+		}
+		/* Interactively decide what to do. */
+		if ((ret = resolve_save_conflict()))
+			goto cleanup;
+	} else /* No new data */
+		if (!io_get_modified()) {
+			ret = IO_SAVE_NOOP;
+			goto cleanup;
+		}
+
+	ret = IO_SAVE_CTINUE;
+	run_hook("pre-save");
+	if (io_save_todo(path_todo) && io_save_app(new & APTS)) {
+		io_compute_hash(path_todo, todo_sha1, &todo_stat);
+		io_unset_modified();
+	} else
+		ret = IO_SAVE_ERROR;
+	run_hook("post-save");
+
+cleanup:
+	io_mutex_unlock();
+	return ret;
+}
+
+static void io_load_error(const char *filename, unsigned line,
+			  const char *mesg)
+{
+	EXIT("%s:%u: %s", filename, line, mesg);
+}
+
+/*
+ * Read a whole stream into an allocated, NUL-terminated buffer and return it.
+ * The length of the data is stored in len.
+ */
+static char *io_read_stream(FILE *fp, size_t *len)
+{
+	struct stat st;
+	size_t size = BUFSIZ, n;
+	char *buf;
+
+	if (fstat(fileno(fp), &st) == 0 && (size_t)st.st_size >= size)
+		size = st.st_size + 1;
+	buf = mem_malloc(size);
+	*len = 0;
+	while ((n = fread(buf + *len, 1, size - *len - 1, fp)) > 0) {
+		*len += n;
+		if (*len == size - 1) {
+			size *= 2;
+			buf = mem_realloc(buf, size, 1);
+		}
+	}
+	buf[*len] = '\0';
+
+	return buf;
+}
+
+/* Read a serialized note file name from a line of the appointment file. */
+static void io_scan_note(char *note, char **s)
+{
+	int i;
+
+	for (i = 0; i < MAX_NOTESIZ && **s && **s != ' '; i++)
+		note[i] = *(*s)++;
+	note[i] = '\0';
+	while (**s && **s != ' ')
+		(*s)++;
+	if (**s == ' ')
+		(*s)++;
+}
+
+/*
+ * The appointment file is split at line boundaries into chunks that are
+ * parsed by threads of their own. Each thread gets at least IO_LOAD_CHUNK
+ * bytes, so that small files are still read by the calling thread alone.
+ */
+#define IO_LOAD_CHUNK		(128 * 1024)
+#define IO_LOAD_THREADS_MAX	64
+
+/*
+ * Queries of more days print most of the items, which are loaded faster from
+ * the snapshot than by checking them line by line.
+ */
+#define IO_QUERY_MAX		(366 * DAYINSEC)
+
+/*
+ * The part of a filter checked while a line is read, before its item is
+ * built: the type, the start and end days and the description. The days are
+ * local ones, widened by one so that the time of day, the time zone and
+ * daylight saving time do not matter. This is only a first pass, the whole
+ * filter is applied once the items are loaded.
+ *
+ * The days of a query are checked the same way, with or without a filter:
+ * only the items that may occur on one of these days are kept.
+ */
+struct io_prefilter {
+	struct item_filter *filter;	/* NULL if not checked */
+	long start_from, start_to;
+	long end_from, end_to;
+	char *literal;		/* text any match of the regex contains */
+	long from, to;		/* days of the query */
+};
+
+/*
+ * A chunk of the appointment file and the items read from it. Parsing stops
+ * at the first error, which is only recorded: errors are reported in file
+ * order once all chunks have been read.
+ */
+struct io_load_chunk {
+	char *start, *end;
+	struct io_prefilter *pf;
+	llist_t *apts, *events, *rapts, *revents;
+	unsigned lines;
+	char *error;
+	pthread_t thread;
+};
+
+/*
+ * Return a piece of text that every match of an extended regular expression
+ * contains, or NULL. Only a plain ASCII prefix of the expression is used.
+ */
+static char *io_regex_literal(const char *pattern)
+{
+	size_t n = 0;
+	char *literal;
+
+	if (strchr(pattern, '|'))
+		return NULL;
+	if (*pattern == '^')
+		pattern++;
+	while (pattern[n] && (unsigned char)pattern[n] < 0x80 &&
+	       !strchr(".[]()*+?{}|^$\\", pattern[n]))
+		n++;
+	/* The last character may be repeated zero times. */
+	if (n > 0 && pattern[n] && strchr("*?{", pattern[n]))
+		n--;
+	if (n == 0)
+		return NULL;
+
+	literal = mem_malloc(n + 1);
+	memcpy(literal, pattern, n);
+	literal[n] = '\0';
+	return literal;
+}
+
+/* Whether the items in memory are used instead of the files. */
+static int data_kept;
+
+/* The first and last moment of a query, see io_set_query(). */
+static time_t query_from = -1, query_to = -1;
+
+/* The local day of a time, moved by margin, or dflt if the time is unset. */
+static long io_prefilter_day(time_t t, int margin, long dflt)
+{
+	struct tm tm;
+
+	if (t == -1)
+		return dflt;
+	date_localtime(&t, &tm);
+	return days_from_civil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday) +
+	       margin;
+}
+
+/*
+ * Set up the checks done while reading. The filter is not checked if it
+ * cannot drop an item by type, date or description, or if it is inverted: an
+ * item failing a check is kept then. There are no checks at all if neither
+ * the filter nor the query days are.
+ */
+static int io_prefilter_init(struct io_prefilter *pf,
+			     struct item_filter *filter)
+{
+	pf->from = io_prefilter_day(query_from, -1, LONG_MIN);
+	pf->to = io_prefilter_day(query_to, 1, LONG_MAX);
+	pf->filter = NULL;
+	pf->literal = NULL;
+
+	if (!filter || filter->invert)
+		return query_from != -1;
+	if ((filter->type_mask & TYPE_MASK_CAL) == TYPE_MASK_CAL &&
+	    !filter->regex && filter->start_from == -1 &&
+	    filter->start_to == -1 && filter->end_from == -1 &&
+	    filter->end_to == -1)
+		return query_from != -1;
+
+	pf->filter = filter;
+	pf->start_from = io_prefilter_day(filter->start_from, -1, LONG_MIN);
+	pf->start_to = io_prefilter_day(filter->start_to, 1, LONG_MAX);
+	pf->end_from = io_prefilter_day(filter->end_from, -1, LONG_MIN);
+	pf->end_to = io_prefilter_day(filter->end_to, 1, LONG_MAX);
+	pf->literal = filter->pattern ? io_regex_literal(filter->pattern) :
+		      NULL;
+	return 1;
+}
+
+/*
+ * Check whether an item may be selected, from its type, its start and end
+ * dates as read and the whole line it is written on. Items with invalid dates
+ * are kept, for the error to be reported.
+ */
+static int io_prefilter_match(struct io_prefilter *pf, int type,
+			      struct tm *start, struct tm *end,
+			      const char *line)
+{
+	long sday, eday;
+
+	if (!check_date(start->tm_year, start->tm_mon, start->tm_mday) ||
+	    !check_date(end->tm_year, end->tm_mon, end->tm_mday))
+		return 1;
+
+	sday = days_from_civil(start->tm_year, start->tm_mon, start->tm_mday);
+	eday = days_from_civil(end->tm_year, end->tm_mon, end->tm_mday);
+	if (!pf->filter)
+		return 1;
+	if (!(pf->filter->type_mask & (1 << type)))
+		return 0;
+	if (sday < pf->start_from || sday > pf->start_to ||
+	    eday < pf->end_from || eday > pf->end_to)
+		return 0;
+
+	return !pf->literal || strstr(line, pf->literal);
+}
+
+/*
+ * Check whether an item may occur on the query days, from its start and end
+ * dates as read and, for a recurrent item, its until date if it has one: the
+ * last occurrence starts on that day. Items with invalid dates are kept, for
+ * the error to be reported.
+ */
+static int io_prefilter_days(struct io_prefilter *pf, int recursive,
+			     struct tm *start, struct tm *end,
+			     struct tm *until)
+{
+	long sday, eday, uday;
+
+	if (!check_date(start->tm_year, start->tm_mon, start->tm_mday) ||
+	    !check_date(end->tm_year, end->tm_mon, end->tm_mday))
+		return 1;
+
+	sday = days_from_civil(start->tm_year, start->tm_mon, start->tm_mday);
+	eday = days_from_civil(end->tm_year, end->tm_mon, end->tm_mday);
+	if (sday > pf->to)
+		return 0;
+	if (!recursive)
+		return eday >= pf->from;
+	if (!until)
+		return 1;
+	uday = days_from_civil(until->tm_year, until->tm_mon, until->tm_mday);
+	return uday + eday - sday >= pf->from;
+}
+
+/*
+ * Check what type of data is written in a line of the appointment file, and
+ * then load either: a new appointment, a new event, or a new recursive item
+ * (which can also be either an event or an appointment) into the lists of the
+ * chunk. Return an error message on failure.
+ *
+ * Lines of items that would not be selected by the filter or that do not
+ * occur on the query days are checked in full, but their items are not
+ * loaded.
+ */
+static char *io_load_line(struct io_load_chunk *c, char *p)
+{
+	int is_appointment = 0, is_recursive = 0, keep = 1;
+	struct tm start, end, until;
+	struct rpt rpt;
+	int id = 0, item_type;
+	char type, state = 0L;
+	char note[MAX_NOTESIZ + 1], *notep;
+	char *line = p, *error;
+
+	memset(&start, 0, sizeof(start));
+	end = until = start;
+
+	/* Read the date first: it is common to both events
+	 * and appointments.
+	 */
+	if (!scan_date(&p, &start.tm_mon, &start.tm_mday, &start.tm_year))
+		return _("syntax error in the item date");
+
+	/* Read the next character : if it is an '@' then we have
+	 * an appointment, else if it is an '[' we have en event.
+	 */
+	if (*p == '@')
+		is_appointment = 1;
+	else if (*p != '[')
+		return _("no event nor appointment found");
+	p++;
+
+	/* Read the remaining informations. */
+	if (is_appointment) {
+		if (!scan_int(&p, &start.tm_hour) ||
+		    !scan_literal(&p, ":") ||
+		    !scan_int(&p, &start.tm_min) ||
+		    !scan_literal(&p, "->") ||
+		    !scan_date(&p, &end.tm_mon, &end.tm_mday, &end.tm_year) ||
+		    !scan_literal(&p, "@") ||
+		    !scan_int(&p, &end.tm_hour) ||
+		    !scan_literal(&p, ":") ||
+		    !scan_int(&p, &end.tm_min))
+			return _("syntax error in item time or duration");
+		scan_blank(&p);
+	} else {
+		if (!scan_int(&p, &id) || !scan_literal(&p, "]"))
+			return _("syntax error in item identifier");
+		while (*p == ' ')
+			p++;
+		end = start;
+	}
+
+	if (c->pf) {
+		if (is_appointment)
+			item_type = *p == '{' ? TYPE_RECUR_APPT : TYPE_APPT;
+		else
+			item_type = *p == '{' ? TYPE_RECUR_EVNT : TYPE_EVNT;
+		keep = io_prefilter_match(c->pf, item_type, &start, &end,
+					  line) &&
+		       io_prefilter_days(c->pf, *p == '{', &start, &end, NULL);
+	}
+
+	/* Check if we have a recursive item. */
+	if (*p == '{') {
+		is_recursive = 1;
+		p++;
+		if (!scan_int(&p, &rpt.freq) || *p == '\0')
+			return _("syntax error in item repetition");
+		type = *p++;
+		if (!strchr("DWMY", type))
+			return _("syntax error in item repetition");
+		rpt.type = recur_char2def(type);
+		scan_blank(&p);
+		/* Optional until date */
+		if (p[0] == '-' && p[1] == '>') {
+			p += 2;
+			if (!scan_date(&p, &until.tm_mon, &until.tm_mday,
+				       &until.tm_year))
+				return _("syntax error in until date");
+			if (!check_date(until.tm_year, until.tm_mon,
+					until.tm_mday))
+				return _("until date error");
+			if (keep && c->pf)
+				keep = io_prefilter_days(c->pf, 1, &start,
+							 &end, &until);
+			until.tm_hour = 0;
+			until.tm_min = 0;
+			until.tm_sec = 0;
+			until.tm_isdst = -1;
+			until.tm_year -= 1900;
+			until.tm_mon--;
+			rpt.until = date_mktime(&until);
+		} else
+			rpt.until = 0;
+		/* Optional bymonthday list */
+		if (*p == 'd' && rpt.type == RECUR_WEEKLY)
+			return _("BYMONTHDAY illegal with WEEKLY");
+		if ((error = recur_bymonthday(&rpt.bymonthday, &p)))
+			return error;
+		/* Optional bywday list */
+		if ((error = recur_bywday(rpt.type, &rpt.bywday, &p)))
+			return error;
+		/* Optional bymonth list */
+		if ((error = recur_bymonth(&rpt.bymonth, &p)))
+			return error;
+		/* Optional exception dates */
+		if ((error = recur_exc_scan(&rpt.exc, &p)))
+			return error;
+		/* End of recurrence rule */
+		if (*p != '}')
+			return _("missing end of recurrence");
+		p++;
+		while (*p == ' ')
+			p++;
+	}
+
+	/* Check if a note is attached to the item. */
+	if (*p == '>') {
+		p++;
+		io_scan_note(note, &p);
+		notep = note;
+	} else
+		notep = NULL;
+
+	/*
+	 * Last: read the item description and load it into its
+	 * corresponding linked list, depending on the item type.
+	 */
+	if (is_appointment) {
+		if (*p == '!')
+			state |= APOINT_NOTIFY;
+		else if (*p == '|')
+			state = 0L;
+		else
+			return _("syntax error in item state");
+		p++;
+	}
+	if (p == c->end)
+		return _("error in appointment description");
+
+	if (keep && c->pf && c->pf->filter && c->pf->filter->regex)
+		keep = !regexec(c->pf->filter->regex, p, 0, 0, 0);
+
+	/* Items that would not be selected are only checked. */
+	if (is_appointment) {
+		if (is_recursive)
+			error = recur_apoint_scan(keep ? c->rapts : NULL, p,
+						  start, end, state, notep,
+						  &rpt);
+		else
+			error = apoint_scan(keep ? c->apts : NULL, p, start,
+					    end, state, notep);
+	} else {
+		if (is_recursive)
+			error = recur_event_scan(keep ? c->revents : NULL, p,
+						 start, id, notep, &rpt);
+		else
+			error = event_scan(keep ? c->events : NULL, p, start,
+					   id, notep);
+	}
+	if (!keep && is_recursive) {
+		recur_free_int_list(&rpt.bymonthday);
+		recur_free_int_list(&rpt.bywday);
+		recur_free_int_list(&rpt.bymonth);
+		recur_free_exc_list(&rpt.exc);
+	}
+	return error;
+}
+
+/* Parse the lines of a chunk, splitting them in place. */
+static void *io_load_chunk_parse(void *arg)
+{
+	struct io_load_chunk *c = arg;
+	char *p, *eol;
+
+	for (p = c->start; p < c->end; p = eol + 1) {
+		c->lines++;
+
+		eol = memchr(p, '\n', c->end - p);
+		if (!eol)
+			eol = c->end;
+		*eol = '\0';
+
+		scan_blank(&p);
+		if (*p == '\0')
+			continue;
+
+		c->error = io_load_line(c, p);
+		if (c->error)
+			return NULL;
+	}
+
+	/* Items were appended in file order, sort each list once. */
+	apoint_llist_sort(c->apts);
+	event_llist_sort(c->events);
+	recur_apoint_llist_sort(c->rapts);
+	recur_event_llist_sort(c->revents);
+
+	return NULL;
+}
+
+/* Number of threads to read an appointment file of len bytes with. */
+static unsigned io_load_threads(size_t len)
+{
+	long n = conf.load_threads;
+
+#ifdef CALCURSE_MEMORY_DEBUG
+	/* Memory statistics are not kept in a thread-safe way. */
+	n = 1;
+#endif
+#ifdef _SC_NPROCESSORS_ONLN
+	if (n == 0)
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (n > IO_LOAD_THREADS_MAX)
+		n = IO_LOAD_THREADS_MAX;
+	if (n > 0 && (size_t)n > len / IO_LOAD_CHUNK)
+		n = len / IO_LOAD_CHUNK;
+
+	return n > 1 ? n : 1;
+}
+
+/*
+ * Binary snapshot of the appointment file, kept in the data directory. It
+ * holds the items in the order of the general lists, with all dates already
+ * converted, so that loading it needs neither parsing nor sorting. It is only
+ * used if it was written for the same contents of the appointment file, which
+ * stays the reference: a stale snapshot is rebuilt once the file was parsed.
+ */
+#define SNAP_MAGIC	"calcurse snapshot"
+#define SNAP_VERSION	2
+
+struct io_snap_header {
+	char magic[sizeof(SNAP_MAGIC)];
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t byte_order;
+	/* Status and checksum of the appointment file. */
+	int64_t size;
+	int64_t mtime;
+	char sha1[SHA1_DIGESTLEN * 2 + 1];
+	/* Local time zone the dates were converted in. */
+	char tz_sha1[SHA1_DIGESTLEN * 2 + 1];
+	/* Recurrent appointments, recurrent events, appointments, events. */
+	uint32_t count[4];
+	/* Checksum of the items following the header. */
+	char body_sha1[SHA1_DIGESTLEN * 2 + 1];
+};
+
+/* A snapshot being read, from p to end. */
+struct io_snap_reader {
+	const char *p, *end;
+};
+
+/*
+ * Fingerprint the local time zone: its name and its offset in the middle of
+ * each month over the years, which covers changes to the zone rules as well.
+ */
+static void io_snap_tz(char *sha1)
+{
+	const char *tz = getenv("TZ");
+	struct string s;
+	struct tm tm;
+	char *buf;
+	int y, m;
+
+	string_init(&s);
+	string_catf(&s, "%s", tz ? tz : "");
+	for (y = 70; y < 138; y++) {
+		for (m = 0; m < 12; m++) {
+			memset(&tm, 0, sizeof(tm));
+			tm.tm_year = y;
+			tm.tm_mon = m;
+			tm.tm_mday = 15;
+			tm.tm_hour = 12;
+			tm.tm_isdst = -1;
+			string_catf(&s, " %lld", (long long)mktime(&tm));
+		}
+	}
+	buf = string_buf(&s);
+	sha1_digest(buf, sha1);
+	mem_free(buf);
+}
+
+static void io_snap_header_init(struct io_snap_header *h, struct stat *st,
+				const char *sha1)
+{
+	memset(h, 0, sizeof(*h));
+	strcpy(h->magic, SNAP_MAGIC);
+	h->version = SNAP_VERSION;
+	h->header_size = sizeof(*h);
+	h->byte_order = 0x01020304;
+	h->size = st->st_size;
+	h->mtime = st->st_mtime;
+	strcpy(h->sha1, sha1);
+	io_snap_tz(h->tz_sha1);
+}
+
+static void io_snap_write_int(FILE *fp, int64_t n)
+{
+	fwrite(&n, sizeof(n), 1, fp);
+}
+
+/* Write a string, or a NULL pointer, with its length. */
+static void io_snap_write_str(FILE *fp, const char *s)
+{
+	uint32_t len = s ? strlen(s) : UINT32_MAX;
+
+	fwrite(&len, sizeof(len), 1, fp);
+	if (s)
+		fwrite(s, len + 1, 1, fp);
+}
+
+static void io_snap_write_list(FILE *fp, llist_t *l)
+{
+	llist_item_t *i;
+	int64_t n = 0;
+
+	LLIST_FOREACH(l, i)
+		n++;
+	io_snap_write_int(fp, n);
+	LLIST_FOREACH(l, i)
+		io_snap_write_int(fp, *(int *)LLIST_GET_DATA(i));
+}
+
+static void io_snap_write_rpt(FILE *fp, struct rpt *rpt, exc_list_t *exc)
+{
+	unsigned i;
+
+	io_snap_write_int(fp, rpt->type);
+	io_snap_write_int(fp, rpt->freq);
+	io_snap_write_int(fp, rpt->until);
+	io_snap_write_list(fp, &rpt->bymonth);
+	io_snap_write_list(fp, &rpt->bywday);
+	io_snap_write_list(fp, &rpt->bymonthday);
+	io_snap_write_int(fp, exc->count);
+	for (i = 0; i < exc->count; i++)
+		io_snap_write_int(fp, exc->st[i]);
+}
+
+/*
+ * Write the snapshot of the general lists, loaded from an appointment file
+ * with the given status and checksum. The snapshot is written to a temporary
+ * file first and failures are ignored: it is only a cache.
+ */
+static void io_save_snapshot(struct stat *st, const char *sha1)
+{
+	struct io_snap_header h;
+	llist_item_t *i;
+	char *path;
+	FILE *fp;
+	int fd, err;
+
+	if (read_only)
+		return;
+
+	asprintf(&path, "%s.XXXXXX", path_snap);
+	if ((fd = mkstemp(path)) == -1) {
+		mem_free(path);
+		return;
+	}
+	if ((fp = fdopen(fd, "w+")) == NULL) {
+		close(fd);
+		unlink(path);
+		mem_free(path);
+		return;
+	}
+
+	io_snap_header_init(&h, st, sha1);
+	LLIST_TS_RDLOCK(&recur_alist_p);
+	LLIST_TS_RDLOCK(&alist_p);
+	LLIST_TS_FOREACH(&recur_alist_p, i)
+		h.count[0]++;
+	LLIST_FOREACH(&recur_elist, i)
+		h.count[1]++;
+	LLIST_TS_FOREACH(&alist_p, i)
+		h.count[2]++;
+	LLIST_FOREACH(&eventlist, i)
+		h.count[3]++;
+	fwrite(&h, sizeof(h), 1, fp);
+
+	LLIST_TS_FOREACH(&recur_alist_p, i) {
+		struct recur_apoint *rapt = LLIST_TS_GET_DATA(i);
+
+		io_snap_write_int(fp, rapt->start);
+		io_snap_write_int(fp, rapt->dur);
+		io_snap_write_int(fp, rapt->state);
+		io_snap_write_str(fp, rapt->mesg);
+		io_snap_write_str(fp, rapt->note);
+		io_snap_write_rpt(fp, rapt->rpt, &rapt->exc);
+	}
+	LLIST_FOREACH(&recur_elist, i) {
+		struct recur_event *rev = LLIST_GET_DATA(i);
+
+		io_snap_write_int(fp, rev->day);
+		io_snap_write_int(fp, rev->id);
+		io_snap_write_str(fp, rev->mesg);
+		io_snap_write_str(fp, rev->note);
+		io_snap_write_rpt(fp, rev->rpt, &rev->exc);
+	}
+	LLIST_TS_FOREACH(&alist_p, i) {
+		struct apoint *apt = LLIST_TS_GET_DATA(i);
+
+		io_snap_write_int(fp, apt->start);
+		io_snap_write_int(fp, apt->dur);
+		io_snap_write_int(fp, apt->state);
+		io_snap_write_str(fp, apt->mesg);
+		io_snap_write_str(fp, apt->note);
+	}
+	LLIST_FOREACH(&eventlist, i) {
+		struct event *ev = LLIST_GET_DATA(i);
+
+		io_snap_write_int(fp, ev->day);
+		io_snap_write_int(fp, ev->id);
+		io_snap_write_str(fp, ev->mesg);
+		io_snap_write_str(fp, ev->note);
+	}
+	LLIST_TS_UNLOCK(&alist_p);
+	LLIST_TS_UNLOCK(&recur_alist_p);
+
+	/* Hash the items back from the file and complete the header. */
+	if (!fseek(fp, sizeof(h), SEEK_SET)) {
+		sha1_stream(fp, h.body_sha1);
+		if (!fseek(fp, 0, SEEK_SET))
+			fwrite(&h, sizeof(h), 1, fp);
+	}
+
+	err = ferror(fp);
+	err |= fclose(fp);
+	if (err || rename(path, path_snap))
+		unlink(path);
+	mem_free(path);
+}
+
+static int io_snap_read_int(struct io_snap_reader *r, int64_t *n)
+{
+	if ((size_t)(r->end - r->p) < sizeof(*n))
+		return 0;
+	memcpy(n, r->p, sizeof(*n));
+	r->p += sizeof(*n);
+	return 1;
+}
+
+/* Read a string, which is left in the snapshot buffer. */
+static int io_snap_read_str(struct io_snap_reader *r, char **s)
+{
+	uint32_t len;
+
+	if ((size_t)(r->end - r->p) < sizeof(len))
+		return 0;
+	memcpy(&len, r->p, sizeof(len));
+	r->p += sizeof(len);
+	if (len == UINT32_MAX) {
+		*s = NULL;
+		return 1;
+	}
+	if ((size_t)(r->end - r->p) <= len || r->p[len] != '\0')
+		return 0;
+	*s = (char *)r->p;
+	r->p += len + 1;
+	return 1;
+}
+
+static int io_snap_read_list(struct io_snap_reader *r, llist_t *l)
+{
+	int64_t n, val;
+	int *i;
+
+	if (!io_snap_read_int(r, &n))
+		return 0;
+	for (; n > 0; n--) {
+		if (!io_snap_read_int(r, &val))
+			return 0;
+		i = mem_malloc(sizeof(int));
+		*i = val;
+		LLIST_ADD(l, i);
+	}
+	return 1;
+}
+
+/* Read a recurrence rule. Nothing is left to be freed on failure. */
+static int io_snap_read_rpt(struct io_snap_reader *r, struct rpt *rpt)
+{
+	int64_t type, freq, until, n, t;
+
+	LLIST_INIT(&rpt->bymonth);
+	LLIST_INIT(&rpt->bywday);
+	LLIST_INIT(&rpt->bymonthday);
+	recur_exc_init(&rpt->exc);
+
+	if (!io_snap_read_int(r, &type) || !io_snap_read_int(r, &freq) ||
+	    !io_snap_read_int(r, &until) ||
+	    type < RECUR_DAILY || type > RECUR_YEARLY)
+		return 0;
+	rpt->type = type;
+	rpt->freq = freq;
+	rpt->until = until;
+
+	if (!io_snap_read_list(r, &rpt->bymonth) ||
+	    !io_snap_read_list(r, &rpt->bywday) ||
+	    !io_snap_read_list(r, &rpt->bymonthday) ||
+	    !io_snap_read_int(r, &n))
+		goto error;
+	for (; n > 0; n--) {
+		if (!io_snap_read_int(r, &t))
+			goto error;
+		recur_add_exc(&rpt->exc, t);
+	}
+	return 1;
+
+error:
+	recur_free_int_list(&rpt->bymonth);
+	recur_free_int_list(&rpt->bywday);
+	recur_free_int_list(&rpt->bymonthday);
+	recur_free_exc_list(&rpt->exc);
+	return 0;
+}
+
+/*
+ * Read the items of a snapshot into the lists, in the order of the header
+ * counts. Return 0 if the snapshot is damaged.
+ */
+static int io_snap_read_items(struct io_snap_reader *r,
+			      struct io_snap_header *h, llist_t *lists)
+{
+	int64_t start, dur, state, id;
+	char *mesg, *note;
+	struct rpt rpt;
+	unsigned n;
+
+	for (n = h->count[0]; n > 0; n--) {
+		if (!io_snap_read_int(r, &start) ||
+		    !io_snap_read_int(r, &dur) ||
+		    !io_snap_read_int(r, &state) ||
+		    !io_snap_read_str(r, &mesg) || !mesg ||
+		    !io_snap_read_str(r, &note) ||
+		    !io_snap_read_rpt(r, &rpt))
+			return 0;
+		LLIST_ADD(&lists[0], recur_apoint_alloc(mesg, note, start, dur,
+							state, &rpt));
+	}
+	for (n = h->count[1]; n > 0; n--) {
+		if (!io_snap_read_int(r, &start) ||
+		    !io_snap_read_int(r, &id) ||
+		    !io_snap_read_str(r, &mesg) || !mesg ||
+		    !io_snap_read_str(r, &note) ||
+		    !io_snap_read_rpt(r, &rpt))
+			return 0;
+		LLIST_ADD(&lists[1], recur_event_alloc(mesg, note, start, id,
+						       &rpt));
+	}
+	for (n = h->count[2]; n > 0; n--) {
+		if (!io_snap_read_int(r, &start) ||
+		    !io_snap_read_int(r, &dur) ||
+		    !io_snap_read_int(r, &state) ||
+		    !io_snap_read_str(r, &mesg) || !mesg ||
+		    !io_snap_read_str(r, &note))
+			return 0;
+		LLIST_ADD(&lists[2], apoint_alloc(mesg, note, start, dur,
+						  state));
+	}
+	for (n = h->count[3]; n > 0; n--) {
+		if (!io_snap_read_int(r, &start) ||
+		    !io_snap_read_int(r, &id) ||
+		    !io_snap_read_str(r, &mesg) || !mesg ||
+		    !io_snap_read_str(r, &note))
+			return 0;
+		LLIST_ADD(&lists[3], event_alloc(mesg, note, start, id));
+	}
+
+	return r->p == r->end;
+}
+
+/*
+ * Load the items from the snapshot, if it was written for an appointment file
+ * with the given status and checksum. Return 0 if the snapshot is missing,
+ * stale or damaged, in which case nothing is loaded.
+ */
+static int io_load_snapshot(struct stat *st, const char *sha1)
+{
+	struct io_snap_header h, expected;
+	struct io_snap_reader r;
+	llist_t lists[4];
+	char body_sha1[SHA1_DIGESTLEN * 2 + 1];
+	FILE *fp;
+	char *buf;
+	size_t len;
+	int i, ret;
+
+	if ((fp = fopen(path_snap, "r")) == NULL)
+		return 0;
+	io_snap_header_init(&expected, st, sha1);
+	if (fread(&h, sizeof(h), 1, fp) != 1 ||
+	    memcmp(&h, &expected, offsetof(struct io_snap_header, count))) {
+		fclose(fp);
+		return 0;
+	}
+	buf = io_read_stream(fp, &len);
+	fclose(fp);
+
+	/* Never decode items that were not written as they are. */
+	sha1_buffer(buf, len, body_sha1);
+	if (memcmp(h.body_sha1, body_sha1, sizeof(body_sha1)) != 0) {
+		mem_free(buf);
+		return 0;
+	}
+
+	for (i = 0; i < 4; i++)
+		LLIST_INIT(&lists[i]);
+	r.p = buf;
+	r.end = buf + len;
+	ret = io_snap_read_items(&r, &h, lists);
+	mem_free(buf);
+
+	if (ret) {
+		recur_apoint_llist_merge(&lists[0], 1);
+		recur_event_llist_merge(&lists[1], 1);
+		apoint_llist_merge(&lists[2], 1);
+		event_llist_merge(&lists[3], 1);
+	} else {
+		LLIST_FREE_INNER(&lists[0], recur_apoint_free);
+		LLIST_FREE(&lists[0]);
+		LLIST_FREE_INNER(&lists[1], recur_event_free);
+		LLIST_FREE(&lists[1]);
+		LLIST_FREE_INNER(&lists[2], apoint_free);
+		LLIST_FREE(&lists[2]);
+		LLIST_FREE_INNER(&lists[3], event_free);
+		LLIST_FREE(&lists[3]);
+	}
+
+	return ret;
+}
+
+/*
+ * Parse the appointment file, read into buf, into the general lists. Lines
+ * are dropped early if a prefilter pf is given.
+ */
+static void io_parse_app(char *buf, size_t len, struct io_prefilter *pf)
+{
+	struct io_load_chunk *chunks;
+	llist_t *lists;
+	char *p;
+	unsigned n, i, line = 0;
+
+	n = io_load_threads(len);
+	chunks = mem_calloc(n, sizeof(struct io_load_chunk));
+	lists = mem_calloc(4 * n, sizeof(llist_t));
+	for (i = 0, p = buf; i < n; i++) {
+		chunks[i].start = p;
+		/* Cut the chunk after the first newline past its share. */
+		if (p < buf + len / n * (i + 1))
+			p = buf + len / n * (i + 1);
+		p = i < n - 1 ? memchr(p, '\n', buf + len - p) : NULL;
+		p = p ? p + 1 : buf + len;
+		chunks[i].end = p;
+		chunks[i].pf = pf;
+		chunks[i].apts = &lists[i];
+		chunks[i].events = &lists[n + i];
+		chunks[i].rapts = &lists[2 * n + i];
+		chunks[i].revents = &lists[3 * n + i];
+		LLIST_INIT(chunks[i].apts);
+		LLIST_INIT(chunks[i].events);
+		LLIST_INIT(chunks[i].rapts);
+		LLIST_INIT(chunks[i].revents);
+	}
+
+	for (i = 1; i < n; i++) {
+		if (pthread_create(&chunks[i].thread, NULL,
+				   io_load_chunk_parse, &chunks[i])) {
+			chunks[i].thread = pthread_self();
+			io_load_chunk_parse(&chunks[i]);
+		}
+	}
+	io_load_chunk_parse(&chunks[0]);
+	for (i = 1; i < n; i++) {
+		if (!pthread_equal(chunks[i].thread, pthread_self()))
+			pthread_join(chunks[i].thread, NULL);
+	}
 
-	if (!fp)
-		return 0;
-	sha1_stream(fp, buf);
-	fclose(fp);
+	for (i = 0; i < n; i++) {
+		line += chunks[i].lines;
+		if (chunks[i].error)
+			io_load_error(path_apts, line, chunks[i].error);
+	}
 
-	return 1;
+	apoint_llist_merge(lists, n);
+	event_llist_merge(lists + n, n);
+	recur_apoint_llist_merge(lists + 2 * n, n);
+	recur_event_llist_merge(lists + 3 * n, n);
+	mem_free(lists);
+	mem_free(chunks);
 }
 
-/* A merge implies a save operation and must be followed by reload of data. */
-static void io_merge_data(void)
-{
-	char *path_apts_new, *path_todo_new;
-	const char *new_ext = ".new";
+/*
+ * Hashes of the items deleted by the journal. They are also collected from the
+ * items in the lists, to find those a filter drops, see io_save_filtered().
+ */
+struct io_journal_dels {
+	char (*hash)[SHA1_DIGESTLEN * 2 + 1];
+	char *done;
+	unsigned n, size;
+	enum { JOURNAL_DELETE, JOURNAL_COLLECT, JOURNAL_MARK } op;
+};
 
-	asprintf(&path_apts_new, "%s%s", path_apts, new_ext);
-	asprintf(&path_todo_new, "%s%s", path_todo, new_ext);
+static int io_journal_hash_cmp(const void *a, const void *b)
+{
+	return strcmp(a, b);
+}
 
-	io_save_apts(path_apts_new);
-	io_save_todo(path_todo_new);
+static void io_journal_add(struct io_journal_dels *d, const char *hash)
+{
+	if (d->n == d->size) {
+		d->size = d->size ? 2 * d->size : 16;
+		d->hash = mem_realloc(d->hash, d->size, sizeof(*d->hash));
+	}
+	strcpy(d->hash[d->n++], hash);
+}
 
-	/*
-	 * We do not directly write to the data files here; however, the
-	 * external merge tool might incorporate changes from the new file into
-	 * the main data files.
-	 */
-	run_hook("pre-save");
+/*
+ * Tell whether an item is kept, consuming a deletion with its hash if any.
+ * Items are always kept when the hashes are only collected or marked.
+ */
+static int io_journal_keep(struct io_journal_dels *d, char *hash)
+{
+	unsigned lo = 0, hi = d->n, mid;
+	int keep = 1;
 
-	if (!io_files_equal(path_apts, path_apts_new)) {
-		const char *arg_apts[] = { conf.mergetool, path_apts,
-					   path_apts_new, NULL };
-		wins_launch_external(arg_apts);
+	if (d->op == JOURNAL_COLLECT) {
+		io_journal_add(d, hash);
+		mem_free(hash);
+		return 1;
 	}
 
-	if (!io_files_equal(path_todo, path_todo_new)) {
-		const char *arg_todo[] = { conf.mergetool, path_todo,
-					   path_todo_new, NULL };
-		wins_launch_external(arg_todo);
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (strcmp(d->hash[mid], hash) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
+	for (; lo < d->n && !strcmp(d->hash[lo], hash); lo++) {
+		if (!d->done[lo]) {
+			d->done[lo] = 1;
+			keep = d->op == JOURNAL_MARK;
+			break;
+		}
+	}
+	mem_free(hash);
 
-	mem_free(path_apts_new);
-	mem_free(path_todo_new);
-
-	/*
-	 * We do not directly write to the data files here; however, the
-	 * external merge tool will likely have incorporated changes from the
-	 * new file into the main data files at this point.
-	 */
-	run_hook("post-save");
+	return keep;
+}
 
-	/*
-	 * The user has merged, so override the modified flag
-	 * (and follow up with reload of the data files).
-	 */
-	io_unset_modified();
+static int io_journal_keep_apoint(struct apoint *apt, void *d)
+{
+	return io_journal_keep(d, apoint_hash(apt));
 }
 
-/* For the return values, see io_save_cal() below. */
-static int resolve_save_conflict(void)
+static int io_journal_keep_event(struct event *ev, void *d)
 {
-	char *msg_um_asktype = NULL;
-	const char *msg_um_prefix =
-			_("Data files have changed and will be overwritten:");
-	const char *msg_um_overwrite = _("(c)ontinue");
-	const char *msg_um_merge = _("(m)erge");
-	const char *msg_um_keep = _("c(a)ncel");
-	const char *msg_um_choice = _("[cma]");
-	int ret = IO_SAVE_CANCEL;
+	return io_journal_keep(d, event_hash(ev));
+}
 
-	asprintf(&msg_um_asktype, "%s %s, %s, %s", msg_um_prefix,
-		 msg_um_overwrite, msg_um_merge, msg_um_keep);
+static int io_journal_keep_rapt(struct recur_apoint *rapt, void *d)
+{
+	return io_journal_keep(d, recur_apoint_hash(rapt));
+}
 
-	switch (status_ask_choice(msg_um_asktype, msg_um_choice, 3)) {
-	case 1:
-		ret = IO_SAVE_CTINUE;
-		break;
-	case 2:
-		io_merge_data();
-		io_load_data(NULL, FORCE);
-		ret = IO_SAVE_RELOAD;
-		break;
-	case 3:
-		/* FALLTHROUGH */
-	default:
-		ret = IO_SAVE_CANCEL;
-	}
+static int io_journal_keep_rev(struct recur_event *rev, void *d)
+{
+	return io_journal_keep(d, recur_event_hash(rev));
+}
 
-	mem_free(msg_um_asktype);
-	return ret;
+/* Go through the appointments with io_journal_keep(). */
+static void io_journal_lists(struct io_journal_dels *d)
+{
+	apoint_llist_keep(d, (llist_fn_match_t)io_journal_keep_apoint);
+	event_llist_keep(d, (llist_fn_match_t)io_journal_keep_event);
+	recur_apoint_llist_keep(d, (llist_fn_match_t)io_journal_keep_rapt);
+	recur_event_llist_keep(d, (llist_fn_match_t)io_journal_keep_rev);
 }
 
 /*
- * Return codes for new_data() and io_load_data().
- * Note that they are file internal.
+ * Apply the journal to the general lists, once the appointment file is loaded.
+ * A journal for another version of the appointment file is ignored, as is an
+ * incomplete last line; the next save rewrites the appointment file then.
  */
-#define NONEW		0
-#define APTS		(1 << 0)
-#define TODO		(1 << 1)
-#define APTS_TODO	APTS | TODO
-#define NOKNOW		-1
-static int new_data()
+static void io_load_journal(void)
 {
-	char sha1_new[SHA1_DIGESTLEN * 2 + 1];
-	int ret = NONEW;
+	struct io_load_chunk c;
+	struct io_journal_dels d;
+	struct stat st;
+	llist_t lists[4];
+	FILE *fp;
+	char *buf, *p, *eol, *error;
+	size_t len, hlen;
+	unsigned line = 1, i;
+
+	string_reset(&journal_pending);
+	journal_rewrite = 0;
+	if ((fp = fopen(path_journal, "r")) == NULL) {
+		io_journal_forget();
+		return;
+	}
+	EXIT_IF(fstat(fileno(fp), &st) != 0, _("failed to open journal"));
+	buf = io_read_stream(fp, &len);
+	file_close(fp, __FILE_POS__);
+	io_file_stat_set(&journal_stat, &st);
+	sha1_buffer(buf, len, journal_sha1);
+
+	hlen = strlen(JOURNAL_MAGIC) + SHA1_DIGESTLEN * 2;
+	if (len <= hlen || strncmp(buf, JOURNAL_MAGIC, strlen(JOURNAL_MAGIC)) ||
+	    strncmp(buf + strlen(JOURNAL_MAGIC), apts_sha1,
+		    SHA1_DIGESTLEN * 2) || buf[hlen] != '\n') {
+		journal_rewrite = 1;
+		mem_free(buf);
+		return;
+	}
 
-	if (io_compute_hash(path_apts, sha1_new)) {
-		if (strncmp(sha1_new, apts_sha1, SHA1_DIGESTLEN * 2) != 0) {
-			ret |= APTS;
+	memset(&c, 0, sizeof(c));
+	c.apts = &lists[0];
+	c.events = &lists[1];
+	c.rapts = &lists[2];
+	c.revents = &lists[3];
+	for (i = 0; i < 4; i++)
+		LLIST_INIT(&lists[i]);
+	memset(&d, 0, sizeof(d));
+	d.op = JOURNAL_DELETE;
+
+	for (p = buf + hlen + 1; p < buf + len; p = eol + 1) {
+		line++;
+		if ((eol = memchr(p, '\n', buf + len - p)) == NULL) {
+			journal_rewrite = 1;
+			break;
+		}
+		*eol = '\0';
+		if (*p == '+') {
+			if ((error = io_load_line(&c, p + 1)))
+				io_load_error(path_journal, line, error);
+		} else if (*p == '-' && strlen(p + 1) == SHA1_DIGESTLEN * 2) {
+			io_journal_add(&d, p + 1);
+		} else {
+			io_load_error(path_journal, line,
+				      _("syntax error in journal entry"));
 		}
-	} else {
-		ret = NOKNOW;
-		goto exit;
 	}
+	mem_free(buf);
 
-	if (io_compute_hash(path_todo, sha1_new)) {
-		if (strncmp(sha1_new, todo_sha1, SHA1_DIGESTLEN * 2) != 0) {
-			ret |= TODO;
-		}
-	} else {
-		ret = NOKNOW;
-		goto exit;
+	/* Additions first, a deletion may refer to an added item. */
+	apoint_llist_sort(c.apts);
+	event_llist_sort(c.events);
+	recur_apoint_llist_sort(c.rapts);
+	recur_event_llist_sort(c.revents);
+	apoint_llist_merge(c.apts, 1);
+	event_llist_merge(c.events, 1);
+	recur_apoint_llist_merge(c.rapts, 1);
+	recur_event_llist_merge(c.revents, 1);
+
+	if (d.n > 0) {
+		qsort(d.hash, d.n, sizeof(*d.hash), io_journal_hash_cmp);
+		d.done = mem_calloc(d.n, 1);
+		io_journal_lists(&d);
+		mem_free(d.done);
+		mem_free(d.hash);
 	}
-   exit:
-	return ret;
 }
 
 /*
- * Save the calendar data.
- * The return value tells how a possible save conflict should be/was resolved:
- * IO_SAVE_CTINUE: continue save operation and overwrite the data files
- * IO_SAVE_RELOAD: cancel save operation (data files changed and reloaded)
- * IO_SAVE_CANCEL: cancel save operation (user's decision, keep data files, no reload)
- * IO_SAVE_NOOP: cancel save operation (nothing has changed)
- * IO_SAVE_ERROR: cannot access data
+ * Save the items selected by a filter, with -F or -P. In journal mode, the
+ * appointments it drops are appended to the journal as deletions instead of
+ * rewriting the appointment file, so they must have been loaded unfiltered.
  */
-int io_save_cal(enum save_type s_t)
+void io_save_filtered(struct item_filter *filter)
 {
-	int ret, new;
-
-	if (read_only)
-		return IO_SAVE_CANCEL;
-
-	io_mutex_lock();
-	if ((new = new_data()) == NOKNOW) {
-		ret = IO_SAVE_ERROR;
-		goto cleanup;
+	struct io_journal_dels d;
+	unsigned i;
+
+	memset(&d, 0, sizeof(d));
+	if (conf.journal) {
+		d.op = JOURNAL_COLLECT;
+		io_journal_lists(&d);
+		apoint_llist_filter(filter);
+		event_llist_filter(filter);
+		recur_apoint_llist_filter(filter);
+		recur_event_llist_filter(filter);
+		todo_llist_filter(filter);
 	}
-	if (new) { /* New data */
-		if (s_t == periodic) {
-			ret = IO_SAVE_CANCEL;
-			goto cleanup;
-		}
-		/* Interactively decide what to do. */
-		if ((ret = resolve_save_conflict()))
-			goto cleanup;
-	} else /* No new data */
-		if (!io_get_modified()) {
-			ret = IO_SAVE_NOOP;
-			goto cleanup;
+
+	if (d.n > 0) {
+		qsort(d.hash, d.n, sizeof(*d.hash), io_journal_hash_cmp);
+		d.done = mem_calloc(d.n, 1);
+		d.op = JOURNAL_MARK;
+		io_journal_lists(&d);
+		for (i = 0; i < d.n; i++) {
+			if (!d.done[i])
+				io_journal_update(d.hash[i], NULL);
 		}
+		mem_free(d.done);
+		mem_free(d.hash);
+	}
 
-	ret = IO_SAVE_CTINUE;
-	run_hook("pre-save");
-	if (io_save_todo(path_todo) &&
-	    io_save_apts(path_apts)) {
-		io_compute_hash(path_apts, apts_sha1);
-		io_compute_hash(path_todo, todo_sha1);
-		io_unset_modified();
-	} else
-		ret = IO_SAVE_ERROR;
-	run_hook("post-save");
+	io_save_todo(path_todo);
+	io_save_app(!conf.journal || journal_rewrite);
+}
 
-cleanup:
-	io_mutex_unlock();
-	return ret;
+/*
+ * Use the items in memory instead of loading them from the files again:
+ * loading then only applies the filter. This is how the daemon answers the
+ * queries of its clients, in a process of their own.
+ */
+void io_keep_data(void)
+{
+	data_kept = 1;
 }
 
-static void io_load_error(const char *filename, unsigned line,
-			  const char *mesg)
+/*
+ * Only load the items that may occur between two moments, for a query that
+ * prints these days and nothing else. The items are not saved afterwards.
+ */
+void io_set_query(time_t from, time_t to)
 {
-	EXIT("%s:%u: %s", filename, line, mesg);
+	if (to - from > IO_QUERY_MAX)
+		return;
+	query_from = from;
+	query_to = to;
 }
 
 /*
- * Check what type of data is written in the appointment file,
- * and then load either: a new appointment, a new event, or a new
- * recursive item (which can also be either an event or an appointment).
+ * Load the appointment file.
+ *
+ * The file is read at once and checked against the snapshot. If the snapshot
+ * is stale, the file is split into chunks of whole lines, which are parsed in
+ * parallel with the scan_*() helpers. Each chunk collects and sorts its own
+ * item lists, which are then merged into the general ones and saved to a new
+ * snapshot. The journal is applied on top of that and the filter last, so
+ * that the snapshot always holds all of the items of the file.
+ *
+ * A filter that is not inverted and the days of a query are checked in part
+ * while the lines are read instead, which skips most of the work for the
+ * items they drop. The snapshot is neither read nor written then.
  */
 void io_load_app(struct item_filter *filter)
 {
 	FILE *data_file;
-	int c, is_appointment, is_event, is_recursive;
-	struct tm start, end, until, lt;
-	struct rpt rpt;
-	time_t t;
-	int id = 0;
-	char type, state = 0L;
-	char note[MAX_NOTESIZ + 1], *notep;
-	unsigned line = 0;
-	char *scan_error;
+	struct stat st;
+	struct io_prefilter pf;
+	char *buf;
+	size_t len;
+	int empty;
 
-	t = time(NULL);
-	localtime_r(&t, &lt);
-	start = end = until = lt;
+	if (data_kept)
+		goto apply_filter;
 
 	data_file = fopen(path_apts, "r");
 	EXIT_IF(data_file == NULL, _("failed to open appointment file"));
+	EXIT_IF(fstat(fileno(data_file), &st) != 0,
+		_("failed to open appointment file"));
+	buf = io_read_stream(data_file, &len);
+	file_close(data_file, __FILE_POS__);
 
-	sha1_stream(data_file, apts_sha1);
-	rewind(data_file);
-
-	for (;;) {
-		is_appointment = is_event = is_recursive = 0;
-		line++;
-		scan_error = NULL;
-
-		c = getc(data_file);
-		if (c == EOF)
-			break;
-		ungetc(c, data_file);
-
-		/* Read the date first: it is common to both events
-		 * and appointments.
-		 */
-		if (fscanf(data_file, "%d / %d / %d ",
-			   &start.tm_mon, &start.tm_mday,
-			   &start.tm_year) != 3)
-			io_load_error(path_apts, line,
-				      _("syntax error in the item date"));
-
-		/* Read the next character : if it is an '@' then we have
-		 * an appointment, else if it is an '[' we have en event.
-		 */
-		c = getc(data_file);
-
-		if (c == '@')
-			is_appointment = 1;
-		else if (c == '[')
-			is_event = 1;
-		else
-			io_load_error(path_apts, line,
-				      _("no event nor appointment found"));
-
-		/* Read the remaining informations. */
-		if (is_appointment) {
-			if (fscanf
-			    (data_file,
-			     " %d : %d -> %d / %d / %d @ %d : %d ",
-			     &start.tm_hour, &start.tm_min, &end.tm_mon,
-			     &end.tm_mday, &end.tm_year, &end.tm_hour,
-			     &end.tm_min) != 7)
-				io_load_error(path_apts, line,
-					      _("syntax error in item time or duration"));
-		} else if (is_event) {
-			if (fscanf(data_file, " %d ", &id) != 1
-			    || getc(data_file) != ']')
-				io_load_error(path_apts, line,
-					      _("syntax error in item identifier"));
-			while ((c = getc(data_file)) == ' ') ;
-			ungetc(c, data_file);
-		} else {
-			io_load_error(path_apts, line,
-				      _("wrong format in the appointment or event"));
-			/* NOTREACHED */
-		}
-
-		/* Check if we have a recursive item. */
-		c = getc(data_file);
-
-		if (c == '{') {
-			is_recursive = 1;
-			if (fscanf(data_file, " %d%c ", &rpt.freq, &type) != 2)
-				io_load_error(path_apts, line,
-					      _("syntax error in item repetition"));
-			else
-				rpt.type = recur_char2def(type);
-			c = getc(data_file);
-			/* Optional until date */
-			if (c == '-' && getc(data_file) == '>') {
-				if (fscanf
-				    (data_file, " %d / %d / %d ",
-				     &until.tm_mon, &until.tm_mday,
-				     &until.tm_year) != 3)
-					io_load_error(path_apts, line,
-						      _("syntax error in until date"));
-				if (!check_date(until.tm_year, until.tm_mon,
-						until.tm_mday))
-					io_load_error(path_apts, line,
-						      _("until date error"));
-				until.tm_hour = 0;
-				until.tm_min = 0;
-				until.tm_sec = 0;
-				until.tm_isdst = -1;
-				until.tm_year -= 1900;
-				until.tm_mon--;
-				rpt.until = mktime(&until);
-				c = getc(data_file);
-			} else
-				rpt.until = 0;
-			/* Optional bymonthday list */
-			if (c == 'd') {
-				if (rpt.type == RECUR_WEEKLY)
-					io_load_error(path_apts, line,
-						      _("BYMONTHDAY illegal with WEEKLY"));
-				ungetc(c, data_file);
-				recur_bymonthday(&rpt.bymonthday, data_file);
-				c = getc(data_file);
-			} else
-				LLIST_INIT(&rpt.bymonthday);
-			/* Optional bywday list */
-			if (c == 'w') {
-				ungetc(c, data_file);
-				recur_bywday(rpt.type, &rpt.bywday, data_file);
-				c = getc(data_file);
-			} else
-				LLIST_INIT(&rpt.bywday);
-			/* Optional bymonth list */
-			if (c == 'm') {
-				ungetc(c, data_file);
-				recur_bymonth(&rpt.bymonth, data_file);
-				c = getc(data_file);
-			} else
-				LLIST_INIT(&rpt.bymonth);
-			/* Optional exception dates */
-			if (c == '!') {
-				ungetc(c, data_file);
-				recur_exc_scan(&rpt.exc, data_file);
-				c = getc(data_file);
-			} else
-				LLIST_INIT(&rpt.exc);
-			/* End of recurrence rule */
-			if (c != '}')
-				io_load_error(path_apts, line,
-					      _("missing end of recurrence"));
-			while ((c = getc(data_file)) == ' ') ;
-		}
-
-		/* Check if a note is attached to the item. */
-		if (c == '>') {
-			note_read(note, data_file);
-			c = getc(data_file);
-			notep = note;
-		} else
-			notep = NULL;
-
-		/*
-		 * Last: read the item description and load it into its
-		 * corresponding linked list, depending on the item type.
-		 */
-		if (is_appointment) {
-			if (c == '!')
-				state |= APOINT_NOTIFY;
-			else if (c == '|')
-				state = 0L;
-			else
-				io_load_error(path_apts, line,
-					      _("syntax error in item state"));
-
-			if (is_recursive)
-				scan_error = recur_apoint_scan(data_file, start, end, state,
-						  notep, filter, &rpt);
-			else
-				scan_error = apoint_scan(data_file, start, end, state,
-					    notep, filter);
-		} else if (is_event) {
-			ungetc(c, data_file);
-			if (is_recursive)
-				scan_error = recur_event_scan(data_file, start, id, notep,
-						 filter, &rpt);
-			else
-				scan_error = event_scan(data_file, start, id, notep, filter);
-		} else {
-			io_load_error(path_apts, line,
-				      _("wrong format in the appointment or event"));
-			/* NOTREACHED */
-		}
-		if (scan_error)
-			io_load_error(path_apts, line, scan_error);
+	io_file_stat_set(&apts_stat, &st);
+	sha1_buffer(buf, len, apts_sha1);
+
+	empty = !LLIST_TS_FIRST(&recur_alist_p) && !LLIST_FIRST(&recur_elist) &&
+		!LLIST_TS_FIRST(&alist_p) && !LLIST_FIRST(&eventlist);
+	if (io_prefilter_init(&pf, filter)) {
+		/* Only part of the items is read, the snapshot is of no use. */
+		io_parse_app(buf, len, &pf);
+		mem_free(pf.literal);
+	} else if (!empty || !io_load_snapshot(&st, apts_sha1)) {
+		io_parse_app(buf, len, NULL);
+		if (empty)
+			io_save_snapshot(&st, apts_sha1);
+	}
+	mem_free(buf);
+	io_load_journal();
+
+apply_filter:
+	if (filter) {
+		apoint_llist_filter(filter);
+		event_llist_filter(filter);
+		recur_apoint_llist_filter(filter);
+		recur_event_llist_filter(filter);
 	}
-	file_close(data_file, __FILE_POS__);
 }
 
 /* Load the todo data */
 void io_load_todo(struct item_filter *filter)
 {
 	FILE *data_file;
-	char *newline;
-	int c, id, completed, cond;
+	struct stat st;
+	char *data, *newline;
+	size_t len;
+	int c, id, completed;
 	char buf[BUFSIZ], e_todo[BUFSIZ], note[MAX_NOTESIZ + 1];
 	unsigned line = 0;
 
+	if (data_kept)
+		goto apply_filter;
+
 	data_file = fopen(path_todo, "r");
 	EXIT_IF(data_file == NULL, _("failed to open todo file"));
+	EXIT_IF(fstat(fileno(data_file), &st) != 0,
+		_("failed to open todo file"));
+	data = io_read_stream(data_file, &len);
+	file_close(data_file, __FILE_POS__);
 
-	sha1_stream(data_file, todo_sha1);
-	rewind(data_file);
+	/* Hash the file once and parse it from memory. */
+	io_file_stat_set(&todo_stat, &st);
+	sha1_buffer(data, len, todo_sha1);
+	if (len == 0) {
+		mem_free(data);
+		return;
+	}
+	data_file = fmemopen(data, len, "r");
+	EXIT_IF(data_file == NULL, _("failed to open todo file"));
 
 	for (;;) {
 		line++;
@@ -798,34 +2110,23 @@ void io_load_todo(struct item_filter *filter)
 			*newline = '\0';
 		io_extract_data(e_todo, buf, sizeof buf);
 
-		/* Filter item. */
-		struct todo *todo = NULL;
-		if (filter) {
-			cond = (
-				!(filter->type_mask & TYPE_MASK_TODO) ||
-				(filter->regex && regexec(filter->regex, e_todo, 0, 0, 0)) ||
-				(filter->priority && id != filter->priority) ||
-				(filter->completed && !completed) ||
-				(filter->uncompleted && completed)
-			);
-			if (filter->hash) {
-				todo = todo_add(e_todo, id, completed, note);
-				char *hash = todo_hash(todo);
-				cond = cond || !hash_matches(filter->hash, hash);
-				mem_free(hash);
-			}
-
-			if ((!filter->invert && cond) || (filter->invert && !cond)) {
-				if (filter->hash)
-					todo_delete(todo);
-				continue;
-			}
-		}
-
-		if (!todo)
-			todo = todo_add(e_todo, id, completed, note);
+		todo_add(e_todo, id, completed, note);
 	}
 	file_close(data_file, __FILE_POS__);
+	mem_free(data);
+
+apply_filter:
+	if (filter)
+		todo_llist_filter(filter);
+}
+
+/*
+ * Check whether a filter may select items of one of the types in a mask. If
+ * it cannot, the file holding these items need not be read.
+ */
+static int io_filter_types(struct item_filter *filter, int mask)
+{
+	return !filter || filter->invert || (filter->type_mask & mask);
 }
 
 /*
@@ -833,9 +2134,31 @@ void io_load_todo(struct item_filter *filter)
  * Unless told otherwise, the function will only load a file that has changed
  * since last saved or loaded. The new_data() return code is passed on when
  * force is false. When force is true (FORCE), the return code is of no use.
+ * A file is left out, and its items are cleared, if the filter drops all of
+ * its items anyway: a todo query does not read the appointment file.
  */
 int io_load_data(struct item_filter *filter, int force)
 {
+	if (data_kept) {
+		/*
+		 * The items the filter drops by type are forgotten, not freed:
+		 * freeing would copy the memory shared with the daemon.
+		 */
+		if (io_filter_types(filter, TYPE_MASK_CAL)) {
+			io_load_app(filter);
+		} else {
+			apoint_llist_init();
+			event_llist_init();
+			recur_apoint_llist_init();
+			recur_event_llist_init();
+		}
+		if (io_filter_types(filter, TYPE_MASK_TODO))
+			io_load_todo(filter);
+		else
+			todo_init_list();
+		return APTS_TODO;
+	}
+
 	run_hook("pre-load");
 	if (force)
 		force = APTS_TODO;
@@ -846,20 +2169,15 @@ int io_load_data(struct item_filter *filter, int force)
 		goto exit;
 
 	if (force & APTS) {
-		apoint_llist_free();
-		event_llist_free();
-		recur_apoint_llist_free();
-		recur_event_llist_free();
-		apoint_llist_init();
-		event_llist_init();
-		recur_apoint_llist_init();
-		recur_event_llist_init();
-		io_load_app(filter);
+		io_clear_app();
+		if (io_filter_types(filter, TYPE_MASK_CAL))
+			io_load_app(filter);
 	}
 	if (force & TODO) {
 		todo_free_list();
 		todo_init_list();
-		io_load_todo(filter);
+		if (io_filter_types(filter, TYPE_MASK_TODO))
+			io_load_todo(filter);
 	}
 
 	io_unset_modified();
@@ -1309,8 +2627,13 @@ int  io_import_data(enum import_type type, char *stream_name,
 		file_close(stream, __FILE_POS__);
 
 	if (ui_mode == UI_CURSES &&
-	    (stats.apoints > 0 || stats.events > 0 || stats.todos > 0))
+	    (stats.apoints > 0 || stats.events > 0 || stats.todos > 0)) {
 		io_set_modified();
+		/* Imported items are not in the journal. */
+		io_mutex_lock();
+		journal_rewrite = 1;
+		io_mutex_unlock();
+	}
 
 	asprintf(&stats_str[0], ngettext("%d app", "%d apps", stats.apoints),
 		 stats.apoints);
@@ -254,7 +254,10 @@ static llist_item_t *llist_find_from(llist_item_t *i, void *data,
 }
 
 /*
- * Add an item to a sorted list.
+ * Add an item to a sorted list. Only an item going to either end of the list
+ * is added in constant time: any other item is inserted after a walk from the
+ * head. Loading the data files appends the items and sorts once instead, see
+ * llist_sort().
  */
 void llist_add_sorted(llist_t * l, void *data, llist_fn_cmp_t fn_cmp)
 {
@@ -268,6 +271,158 @@ void llist_add_sorted(llist_t * l, void *data, llist_fn_cmp_t fn_cmp)
 	llist_relink(l, o, fn_cmp);
 }
 
+/*
+ * Sort a list in place. The sort is stable, so that items comparing equal
+ * keep their relative order. This is a bottom-up merge sort that only
+ * rewrites links: it is used after a bulk load, where appending and sorting
+ * once is much cheaper than a sorted insertion per item.
+ */
+void llist_sort(llist_t * l, llist_fn_cmp_t fn_cmp)
+{
+	llist_item_t *p, *q, *e, *tail;
+	int insize, nmerges, psize, qsize;
+
+	/* Nothing to do if the list is sorted already (the common case). */
+	for (p = l->head; p && p->next; p = p->next) {
+		if (fn_cmp(p->data, p->next->data) > 0)
+			break;
+	}
+	if (!p || !p->next)
+		return;
+
+	for (insize = 1;; insize *= 2) {
+		p = l->head;
+		l->head = tail = NULL;
+		nmerges = 0;
+
+		while (p) {
+			nmerges++;
+			q = p;
+			for (psize = 0; psize < insize && q; psize++)
+				q = q->next;
+			qsize = insize;
+
+			while (psize > 0 || (qsize > 0 && q)) {
+				if (psize == 0) {
+					e = q;
+					q = q->next;
+					qsize--;
+				} else if (qsize == 0 || !q ||
+					   fn_cmp(p->data, q->data) <= 0) {
+					e = p;
+					p = p->next;
+					psize--;
+				} else {
+					e = q;
+					q = q->next;
+					qsize--;
+				}
+
+				if (tail)
+					tail->next = e;
+				else
+					l->head = e;
+				tail = e;
+			}
+			p = q;
+		}
+		tail->next = NULL;
+
+		if (nmerges <= 1)
+			break;
+	}
+	l->tail = tail;
+}
+
+/*
+ * Merge the sorted list b into the sorted list a, leaving b empty. Items
+ * comparing equal are kept in the order a, b.
+ */
+static void llist_merge2(llist_t *a, llist_t *b, llist_fn_cmp_t fn_cmp)
+{
+	llist_item_t *p = a->head, *q = b->head, *e, *tail = NULL;
+
+	if (!q)
+		return;
+	if (!p) {
+		*a = *b;
+		b->head = b->tail = NULL;
+		return;
+	}
+
+	while (p && q) {
+		if (fn_cmp(p->data, q->data) <= 0) {
+			e = p;
+			p = p->next;
+		} else {
+			e = q;
+			q = q->next;
+		}
+
+		if (tail)
+			tail->next = e;
+		else
+			a->head = e;
+		tail = e;
+	}
+	if (p) {
+		tail->next = p;
+	} else {
+		tail->next = q;
+		a->tail = b->tail;
+	}
+	b->head = b->tail = NULL;
+}
+
+/*
+ * Merge n sorted lists into the sorted list l, leaving them empty. The lists
+ * are merged pairwise, so that items comparing equal are kept in the order l,
+ * src[0], ..., src[n - 1].
+ */
+void llist_merge(llist_t * l, llist_t * src, unsigned n,
+		 llist_fn_cmp_t fn_cmp)
+{
+	unsigned i, step;
+
+	if (n == 0)
+		return;
+
+	for (step = 1; step < n; step *= 2) {
+		for (i = 0; i + step < n; i += 2 * step)
+			llist_merge2(&src[i], &src[i + step], fn_cmp);
+	}
+	llist_merge2(l, &src[0], fn_cmp);
+}
+
+/*
+ * Keep the items of a list matching data, in a single pass, and free the
+ * others with fn_free.
+ */
+void llist_filter(llist_t * l, void *data, llist_fn_match_t fn_match,
+		  llist_fn_free_t fn_free)
+{
+	llist_item_t *i, *next, *tail = NULL;
+
+	for (i = l->head; i; i = next) {
+		next = i->next;
+		if (fn_match(i->data, data)) {
+			if (tail)
+				tail->next = i;
+			else
+				l->head = i;
+			tail = i;
+		} else {
+			fn_free(i->data);
+			mem_free(i);
+		}
+	}
+	if (tail)
+		tail->next = NULL;
+	else
+		l->head = NULL;
+	l->tail = tail;
+}
+
 /*
  * Remove an item from a list.
  */
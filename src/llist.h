@@ -100,6 +100,9 @@ void llist_add(llist_t *, void *);
 void llist_add_sorted(llist_t *, void *, llist_fn_cmp_t);
 void llist_remove(llist_t *, llist_item_t *);
 void llist_reorder(llist_t *, void *, llist_fn_cmp_t);
+void llist_sort(llist_t *, llist_fn_cmp_t);
+void llist_merge(llist_t *, llist_t *, unsigned, llist_fn_cmp_t);
+void llist_filter(llist_t *, void *, llist_fn_match_t, llist_fn_free_t);
 
 #define LLIST_ADD(l, data) llist_add(l, data)
 #define LLIST_ADD_SORTED(l, data, fn_cmp)                                     \
@@ -107,3 +110,8 @@ void llist_reorder(llist_t *, void *, llist_fn_cmp_t);
 #define LLIST_REMOVE(l, i) llist_remove(l, i)
 #define LLIST_REORDER(l, data, fn_cmp)                                        \
   llist_reorder(l, data, (llist_fn_cmp_t)fn_cmp)
+#define LLIST_SORT(l, fn_cmp) llist_sort(l, (llist_fn_cmp_t)fn_cmp)
+#define LLIST_MERGE(l, src, n, fn_cmp)                                        \
+  llist_merge(l, src, n, (llist_fn_cmp_t)fn_cmp)
+#define LLIST_FILTER(l, data, fn_match, fn_free)                              \
+  llist_filter(l, data, (llist_fn_match_t)fn_match, (llist_fn_free_t)fn_free)
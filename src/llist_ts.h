@@ -34,31 +34,35 @@
  *
  */
 
-/* Thread-safe linked lists. */
+/*
+ * Thread-safe linked lists. Readers share the list, writers have exclusive
+ * access to it.
+ */
 typedef struct llist_ts llist_ts_t;
 struct llist_ts {
 	llist_item_t *head;
 	llist_item_t *tail;
-	pthread_mutex_t mutex;
+	pthread_rwlock_t lock;
 };
 
 /* Initialization and deallocation. */
 #define LLIST_TS_INIT(l_ts) do {                                              \
   llist_init ((llist_t *)l_ts);                                               \
-  pthread_mutex_init (&(l_ts)->mutex, NULL);                                  \
+  pthread_rwlock_init (&(l_ts)->lock, NULL);                                  \
 } while (0)
 
 #define LLIST_TS_FREE(l_ts) do {                                              \
   llist_free ((llist_t *)l_ts);                                               \
-  pthread_mutex_destroy (&(l_ts)->mutex);                                     \
+  pthread_rwlock_destroy (&(l_ts)->lock);                                     \
 } while (0)
 
 #define LLIST_TS_FREE_INNER(l_ts, fn_free)                                    \
   llist_free_inner ((llist_t *)l_ts, (llist_fn_free_t)fn_free)
 
 /* Thread-safety operations. */
-#define LLIST_TS_LOCK(l_ts) pthread_mutex_lock (&(l_ts)->mutex)
-#define LLIST_TS_UNLOCK(l_ts) pthread_mutex_unlock (&(l_ts)->mutex)
+#define LLIST_TS_LOCK(l_ts) pthread_rwlock_wrlock (&(l_ts)->lock)
+#define LLIST_TS_RDLOCK(l_ts) pthread_rwlock_rdlock (&(l_ts)->lock)
+#define LLIST_TS_UNLOCK(l_ts) pthread_rwlock_unlock (&(l_ts)->lock)
 
 /* Retrieving list items. */
 #define LLIST_TS_FIRST(l_ts) llist_first ((llist_t *)l_ts)
@@ -92,3 +96,10 @@ struct llist_ts {
   llist_add_sorted ((llist_t *)l_ts, data, (llist_fn_cmp_t)fn_cmp)
 #define LLIST_TS_REORDER(l_ts, data, fn_cmp)                                  \
   llist_reorder((llist_t *)l_ts, data, (llist_fn_cmp_t)fn_cmp)
+#define LLIST_TS_SORT(l_ts, fn_cmp)                                           \
+  llist_sort((llist_t *)l_ts, (llist_fn_cmp_t)fn_cmp)
+#define LLIST_TS_MERGE(l_ts, src, n, fn_cmp)                                  \
+  llist_merge((llist_t *)l_ts, src, n, (llist_fn_cmp_t)fn_cmp)
+#define LLIST_TS_FILTER(l_ts, data, fn_match, fn_free)                        \
+  llist_filter((llist_t *)l_ts, data, (llist_fn_match_t)fn_match,             \
+               (llist_fn_free_t)fn_free)
@@ -38,7 +38,6 @@
 #include <dirent.h>
 
 #include "calcurse.h"
-#include "sha1.h"
 
 struct note_gc_hash {
 	char *hash;
@@ -44,6 +44,9 @@
 
 #define NOTIFY_FIELD_LENGTH	25
 
+/* Number of days covered by the queue of upcoming appointments. */
+#define NOTIFY_QUEUE_DAYS	7
+
 struct notify_vars {
 	WINDOW *win;
 	char *apts_file;
@@ -56,6 +59,36 @@ static struct notify_vars notify;
 static struct notify_app notify_app;
 static pthread_attr_t detached_thread_attr;
 
+/* Wakes the notify-bar main thread up before its next deadline. */
+static struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int pending;
+} notify_wakeup = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0
+};
+
+/* Return the current time, read from the clock timed waits are based on. */
+static time_t notify_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec;
+}
+
+/*
+ * Have the notify-bar main thread look at what it displays again, once the
+ * upcoming appointment or the notify-bar options changed.
+ */
+static void notify_wake_bar(void)
+{
+	pthread_mutex_lock(&notify_wakeup.mutex);
+	notify_wakeup.pending = 1;
+	pthread_cond_signal(&notify_wakeup.cond);
+	pthread_mutex_unlock(&notify_wakeup.mutex);
+}
+
 /*
  * Return the number of seconds before next appointment
  * (0 if no upcoming appointment).
@@ -65,18 +98,17 @@ int notify_time_left(void)
 	time_t ntimer;
 	int left;
 
-	ntimer = time(NULL);
+	ntimer = notify_now();
 	left = notify_app.time - ntimer;
 
 	return left > 0 ? left : 0;
 }
 
-static unsigned notify_trigger(void)
+/* Return 1 if appointments with the given state are to be notified. */
+unsigned notify_wanted(int state)
 {
-	int flagged = notify_app.state & APOINT_NOTIFY;
+	int flagged = state & APOINT_NOTIFY;
 
-	if (!notify_app.got_app)
-		return 0;
 	if (nbar.notify_all == NOTIFY_ALL)
 		return 1;
 	if (nbar.notify_all == NOTIFY_UNFLAGGED_ONLY)
@@ -84,6 +116,13 @@ static unsigned notify_trigger(void)
 	return flagged;
 }
 
+static unsigned notify_trigger(void)
+{
+	if (!notify_app.got_app)
+		return 0;
+	return notify_wanted(notify_app.state);
+}
+
 /*
  * Return 1 if the reminder was not sent already for the upcoming appointment.
  */
@@ -185,6 +224,7 @@ void notify_free_app(void)
 	if (notify_app.txt)
 		mem_free(notify_app.txt);
 	notify_app.txt = 0;
+	notify_wake_bar();
 }
 
 /* Stop the notify-bar main thread. */
@@ -320,23 +360,66 @@ notify_main_thread_cleanup(void *arg)
 	pthread_mutex_unlock(&nbar.mutex);
 }
 
-/* Update the notication bar content */
+/*
+ * Return the number of seconds a time formatted with the given strftime()
+ * format stays the same: one if seconds are shown, else one minute.
+ */
+static int notify_fmt_step(const char *fmt)
+{
+	for (; *fmt; fmt++) {
+		if (*fmt != '%')
+			continue;
+		/* Skip flags, field width and modifiers. */
+		for (fmt++; *fmt && strchr("_-0^#EO123456789", *fmt); fmt++) ;
+		if (!*fmt)
+			break;
+		if (strchr("sSTrXc+", *fmt))
+			return 1;
+	}
+
+	return MININSEC;
+}
+
+static void notify_wait_cleanup(void *arg)
+{
+	pthread_mutex_unlock(&notify_wakeup.mutex);
+}
+
+/* Sleep until the given time, or until notify_wake_bar() is called. */
+static void notify_wait(time_t wake)
+{
+	struct timespec ts;
+	int ret = 0;
+
+	ts.tv_sec = wake;
+	ts.tv_nsec = 0;
+
+	pthread_mutex_lock(&notify_wakeup.mutex);
+	pthread_cleanup_push(notify_wait_cleanup, NULL);
+	while (!notify_wakeup.pending && !ret)
+		ret = pthread_cond_timedwait(&notify_wakeup.cond,
+					     &notify_wakeup.mutex, &ts);
+	notify_wakeup.pending = 0;
+	pthread_cleanup_pop(1);
+}
+
+/*
+ * Update the notication bar content. Rather than waking up every second, the
+ * thread sleeps until the date, the time or the countdown displayed changes.
+ */
 /* ARGSUSED0 */
 static void *notify_main_thread(void *arg)
 {
-	const unsigned thread_sleep = 1;
-	const unsigned check_app = MININSEC;
-	int elapse = 0;
-	int got_app;
+	int got_app, left, step, cntdwn, trigger;
 	struct tm ntime;
-	time_t ntimer;
+	time_t ntimer, wake, check_app;
 
-	elapse = 0;
+	check_app = notify_now() + MININSEC;
 
 	pthread_cleanup_push(notify_main_thread_cleanup, NULL);
 
 	for (;;) {
-		ntimer = time(NULL);
+		ntimer = notify_now();
 		localtime_r(&ntimer, &ntime);
 		pthread_mutex_lock(&notify.mutex);
 		pthread_mutex_lock(&nbar.mutex);
@@ -344,71 +427,386 @@ static void *notify_main_thread(void *arg)
 			 &ntime);
 		strftime(notify.date, NOTIFY_FIELD_LENGTH, nbar.datefmt,
 			 &ntime);
+		step = MIN(notify_fmt_step(nbar.timefmt),
+			   notify_fmt_step(nbar.datefmt));
 		pthread_mutex_unlock(&nbar.mutex);
 		pthread_mutex_unlock(&notify.mutex);
 		notify_update_bar();
-		psleep(thread_sleep);
 		/* Reap the user-defined notifications. */
 		while (waitpid(0, NULL, WNOHANG) > 0)
 			;
-		elapse += thread_sleep;
-		if (elapse >= check_app) {
-			elapse = 0;
-			pthread_mutex_lock(&notify_app.mutex);
-			got_app = notify_app.got_app;
-			pthread_mutex_unlock(&notify_app.mutex);
-			if (!got_app)
+
+		/* Next change of the date and time. */
+		if (step < MININSEC)
+			wake = ntimer + step;
+		else
+			wake = ntimer + MAX(MININSEC - ntime.tm_sec, 1);
+
+		pthread_mutex_lock(&notify_app.mutex);
+		pthread_mutex_lock(&nbar.mutex);
+		got_app = notify_app.got_app;
+		left = notify_app.time - ntimer;
+		cntdwn = nbar.cntdwn;
+		trigger = notify_trigger();
+		pthread_mutex_unlock(&nbar.mutex);
+		pthread_mutex_unlock(&notify_app.mutex);
+
+		if (got_app && left > 0) {
+			/* The countdown is shown in minutes rounded up. */
+			wake = MIN(wake, ntimer + (left % MININSEC ?
+						   left % MININSEC :
+						   MININSEC));
+			/* Start blinking and launch the notification. */
+			if (trigger && left > cntdwn)
+				wake = MIN(wake, ntimer + left - cntdwn);
+		} else if (!got_app) {
+			if (ntimer >= check_app) {
 				notify_check_next_app(0);
+				check_app = ntimer + MININSEC;
+			}
+			wake = MIN(wake, check_app);
 		}
+
+		notify_wait(wake);
 	}
 
 	pthread_cleanup_pop(0);
 	pthread_exit(NULL);
 }
 
-/* Fill the given structure with information about next appointment. */
-unsigned notify_get_next(struct notify_app *a)
+/*
+ * The upcoming appointments and occurrences of recurrent appointments, kept
+ * as a binary min-heap ordered by start time. It covers the period (from,
+ * until] and is updated as appointments are added, changed or deleted, which
+ * saves looking through all appointments for the next one.
+ */
+struct notify_occ {
+	time_t start;
+	char state;
+	char *mesg;
+	void *item;
+};
+
+struct notify_queue {
+	struct notify_occ *occ;
+	unsigned count;
+	unsigned size;
+	time_t from;
+	time_t until;
+	struct notify_occ *popped;	/* popped, until they start */
+	unsigned npopped;
+	int wanted;	/* only the appointments to be notified of */
+};
+
+static struct notify_queue notify_queue;
+static pthread_mutex_t notify_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void notify_queue_up(struct notify_queue *q, unsigned n)
 {
-	time_t current_time;
+	struct notify_occ *h = q->occ, occ = h[n];
+	unsigned p;
 
-	if (!a)
-		return 0;
+	for (; n > 0; n = p) {
+		p = (n - 1) / 2;
+		if (h[p].start <= occ.start)
+			break;
+		h[n] = h[p];
+	}
+	h[n] = occ;
+}
 
-	current_time = time(NULL);
+static void notify_queue_down(struct notify_queue *q, unsigned n)
+{
+	struct notify_occ *h = q->occ, occ = h[n];
+	unsigned c;
 
-	a->time = current_time + DAYINSEC;
-	a->got_app = 0;
-	a->state = 0;
-	a->txt = NULL;
-	recur_apoint_check_next(a, current_time, get_today());
-	apoint_check_next(a, current_time);
+	for (; (c = 2 * n + 1) < q->count; n = c) {
+		if (c + 1 < q->count && h[c + 1].start < h[c].start)
+			c++;
+		if (occ.start <= h[c].start)
+			break;
+		h[n] = h[c];
+	}
+	h[n] = occ;
+}
 
-	return 1;
+/*
+ * Tell whether an entry was popped already. Entries are told apart by start
+ * time and description: the items themselves are replaced on reload.
+ */
+static int notify_queue_popped(struct notify_queue *q, time_t start,
+			       const char *mesg)
+{
+	unsigned n;
+
+	for (n = 0; n < q->npopped; n++) {
+		if (q->popped[n].start == start &&
+		    !strcmp(q->popped[n].mesg, mesg))
+			return 1;
+	}
+	return 0;
+}
+
+static void notify_queue_push(struct notify_queue *q, time_t start,
+			      char state, char *mesg, void *item)
+{
+	if (start <= q->from || start > q->until ||
+	    notify_queue_popped(q, start, mesg))
+		return;
+	if (q->wanted && !notify_wanted(state))
+		return;
+
+	if (q->count == q->size) {
+		q->size = q->size ? 2 * q->size : 64;
+		q->occ = mem_realloc(q->occ, q->size,
+				     sizeof(struct notify_occ));
+	}
+	q->occ[q->count].start = start;
+	q->occ[q->count].state = state;
+	q->occ[q->count].mesg = mem_strdup(mesg);
+	q->occ[q->count].item = item;
+	notify_queue_up(q, q->count++);
+}
+
+static void notify_queue_delete(struct notify_queue *q, unsigned n)
+{
+	mem_free(q->occ[n].mesg);
+	if (n == --q->count)
+		return;
+	q->occ[n] = q->occ[q->count];
+	if (n > 0 && q->occ[(n - 1) / 2].start > q->occ[n].start)
+		notify_queue_up(q, n);
+	else
+		notify_queue_down(q, n);
+}
+
+/* Delete the entries of an item. */
+static void notify_queue_forget(struct notify_queue *q, void *item)
+{
+	unsigned n;
+
+	for (n = q->count; n > 0; n--) {
+		if (q->occ[n - 1].item == item)
+			notify_queue_delete(q, n - 1);
+	}
+}
+
+struct notify_queue_recur {
+	struct notify_queue *q;
+	struct recur_apoint *rapt;
+};
+
+static int notify_queue_occurrence(time_t occ, void *data)
+{
+	struct notify_queue_recur *r = data;
+
+	notify_queue_push(r->q, occ, r->rapt->state, r->rapt->mesg, r->rapt);
+	return 0;
+}
+
+static void notify_queue_add_recur(struct notify_queue *q,
+				   struct recur_apoint *rapt)
+{
+	struct notify_queue_recur r = { q, rapt };
+
+	if (!q->until)
+		return;
+	recur_item_occurrences(rapt->start, rapt->dur, rapt->rpt, &rapt->exc,
+			       q->from, q->until, notify_queue_occurrence, &r);
 }
 
 /*
- * This is used for the daemon to check if we have an upcoming appointment or
- * not.
+ * Fill the queue with the appointments of the next days. If wanted is set,
+ * only those to be notified of are kept.
  */
-unsigned notify_get_next_bkgd(void)
+void notify_queue_build(int wanted)
+{
+	struct notify_queue q, old;
+	struct apoint **apts;
+	llist_item_t *i;
+	unsigned n;
+
+	memset(&q, 0, sizeof(q));
+	q.from = time(NULL);
+	q.until = q.from + NOTIFY_QUEUE_DAYS * DAYINSEC;
+	q.wanted = wanted;
+
+	/*
+	 * Keep the entries popped that have not started yet. Only the thread
+	 * building the queue pops entries, none is popped meanwhile.
+	 */
+	pthread_mutex_lock(&notify_queue_mutex);
+	if (notify_queue.npopped > 0)
+		q.popped = mem_calloc(notify_queue.npopped,
+				      sizeof(struct notify_occ));
+	for (n = 0; n < notify_queue.npopped; n++) {
+		if (notify_queue.popped[n].start <= q.from)
+			continue;
+		q.popped[q.npopped].start = notify_queue.popped[n].start;
+		q.popped[q.npopped].mesg =
+			mem_strdup(notify_queue.popped[n].mesg);
+		q.npopped++;
+	}
+	pthread_mutex_unlock(&notify_queue_mutex);
+
+	LLIST_TS_RDLOCK(&alist_p);
+	n = apoint_find_range(q.from, q.until, &apts);
+	for (; n > 0; n--, apts++)
+		notify_queue_push(&q, (*apts)->start, (*apts)->state,
+				  (*apts)->mesg, *apts);
+	LLIST_TS_UNLOCK(&alist_p);
+
+	LLIST_TS_RDLOCK(&recur_alist_p);
+	LLIST_TS_FOREACH(&recur_alist_p, i)
+		notify_queue_add_recur(&q, LLIST_TS_GET_DATA(i));
+	LLIST_TS_UNLOCK(&recur_alist_p);
+
+	pthread_mutex_lock(&notify_queue_mutex);
+	old = notify_queue;
+	notify_queue = q;
+	pthread_mutex_unlock(&notify_queue_mutex);
+
+	while (old.count > 0)
+		notify_queue_delete(&old, 0);
+	if (old.occ)
+		mem_free(old.occ);
+	for (n = 0; n < old.npopped; n++)
+		mem_free(old.popped[n].mesg);
+	if (old.popped)
+		mem_free(old.popped);
+}
+
+/* Rebuild the queue, if it is used, after the data files were reloaded. */
+void notify_queue_reload(void)
 {
-	struct notify_app a;
+	int used, wanted;
 
-	a.txt = NULL;
-	if (!notify_get_next(&a))
-		return 0;
+	pthread_mutex_lock(&notify_queue_mutex);
+	used = notify_queue.until != 0;
+	wanted = notify_queue.wanted;
+	pthread_mutex_unlock(&notify_queue_mutex);
 
-	if (!a.got_app) {
-		/* No next appointment, reset the previous notified one. */
-		notify_app.got_app = 0;
-		return 1;
-	} else {
-		if (!notify_same_item(a.time))
-			notify_update_app(a.time, a.state, a.txt);
+	if (used)
+		notify_queue_build(wanted);
+}
+
+/* Update the entries of an appointment that was added or changed. */
+void notify_queue_apoint(struct apoint *apt)
+{
+	pthread_mutex_lock(&notify_queue_mutex);
+	notify_queue_forget(&notify_queue, apt);
+	notify_queue_push(&notify_queue, apt->start, apt->state, apt->mesg,
+			  apt);
+	pthread_mutex_unlock(&notify_queue_mutex);
+}
+
+/* Update the occurrences of a recurrent appointment. */
+void notify_queue_recur(struct recur_apoint *rapt)
+{
+	pthread_mutex_lock(&notify_queue_mutex);
+	notify_queue_forget(&notify_queue, rapt);
+	notify_queue_add_recur(&notify_queue, rapt);
+	pthread_mutex_unlock(&notify_queue_mutex);
+}
+
+/* Delete the entries of an appointment or a recurrent appointment. */
+void notify_queue_remove(void *item)
+{
+	pthread_mutex_lock(&notify_queue_mutex);
+	notify_queue_forget(&notify_queue, item);
+	pthread_mutex_unlock(&notify_queue_mutex);
+}
+
+/*
+ * Fill the given structure with the first appointment starting after the
+ * given time. Return 0 if there is none before the end of the queue, which
+ * is extended first if that time is reached.
+ */
+unsigned notify_queue_first(struct notify_app *a, time_t now)
+{
+	int refill, wanted, found;
+
+	pthread_mutex_lock(&notify_queue_mutex);
+	refill = notify_queue.until != 0 && now >= notify_queue.until;
+	wanted = notify_queue.wanted;
+	pthread_mutex_unlock(&notify_queue_mutex);
+	if (refill)
+		notify_queue_build(wanted);
+
+	pthread_mutex_lock(&notify_queue_mutex);
+	while (notify_queue.count > 0 && notify_queue.occ[0].start <= now)
+		notify_queue_delete(&notify_queue, 0);
+	found = notify_queue.count > 0;
+	if (found) {
+		a->time = notify_queue.occ[0].start;
+		a->state = notify_queue.occ[0].state;
+		a->txt = mem_strdup(notify_queue.occ[0].mesg);
+		a->got_app = 1;
+	}
+	pthread_mutex_unlock(&notify_queue_mutex);
+
+	return found;
+}
+
+/*
+ * Drop the first appointment of the queue. It is not added again until it
+ * starts, even when the queue is rebuilt.
+ */
+void notify_queue_pop(void)
+{
+	struct notify_queue *q = &notify_queue;
+	time_t now = time(NULL);
+	unsigned n;
+
+	pthread_mutex_lock(&notify_queue_mutex);
+	if (q->count > 0) {
+		/* Forget the entries popped before that have started. */
+		for (n = q->npopped; n > 0; n--) {
+			if (q->popped[n - 1].start > now)
+				continue;
+			mem_free(q->popped[n - 1].mesg);
+			q->popped[n - 1] = q->popped[--q->npopped];
+		}
+		q->popped = mem_realloc(q->popped, q->npopped + 1,
+					sizeof(struct notify_occ));
+		q->popped[q->npopped++] = q->occ[0];
+		q->occ[0].mesg = mem_strdup(q->occ[0].mesg);
+		notify_queue_delete(q, 0);
 	}
+	pthread_mutex_unlock(&notify_queue_mutex);
+}
+
+/* Return the end of the period covered by the queue. */
+time_t notify_queue_until(void)
+{
+	time_t until;
+
+	pthread_mutex_lock(&notify_queue_mutex);
+	until = notify_queue.until;
+	pthread_mutex_unlock(&notify_queue_mutex);
+
+	return until;
+}
 
-	if (a.txt)
-		mem_free(a.txt);
+/* Fill the given structure with information about next appointment. */
+unsigned notify_get_next(struct notify_app *a)
+{
+	time_t current_time;
+
+	if (!a)
+		return 0;
+
+	current_time = time(NULL);
+
+	a->got_app = 0;
+	a->state = 0;
+	a->txt = NULL;
+	if (notify_queue_first(a, current_time) &&
+	    a->time > current_time + DAYINSEC) {
+		mem_free(a->txt);
+		a->txt = NULL;
+		a->got_app = 0;
+	}
 
 	return 1;
 }
@@ -422,15 +820,27 @@ char *notify_app_txt(void)
 		return NULL;
 }
 
+/*
+ * Requests for the notify worker, the thread looking for the next
+ * appointment. Requests made while it is busy are answered by one more look.
+ */
+static struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int started;
+	int pending;
+	int force;
+} notify_worker = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0
+};
+
 /* Look for the next appointment within the next 24 hours. */
-/* ARGSUSED0 */
-static void *notify_thread_app(void *arg)
+static void notify_next_app(int force)
 {
 	struct notify_app tmp_app;
-	int force = (arg ? 1 : 0);
 
 	if (!notify_get_next(&tmp_app))
-		pthread_exit(NULL);
+		return;
 
 	if (!tmp_app.got_app) {
 		pthread_mutex_lock(&notify_app.mutex);
@@ -448,28 +858,54 @@ static void *notify_thread_app(void *arg)
 	if (tmp_app.txt)
 		mem_free(tmp_app.txt);
 	notify_update_bar();
+}
 
-	pthread_exit(NULL);
+/* ARGSUSED0 */
+static void *notify_worker_thread(void *arg)
+{
+	int force;
+
+	for (;;) {
+		pthread_mutex_lock(&notify_worker.mutex);
+		while (!notify_worker.pending)
+			pthread_cond_wait(&notify_worker.cond,
+					  &notify_worker.mutex);
+		force = notify_worker.force;
+		notify_worker.pending = notify_worker.force = 0;
+		pthread_mutex_unlock(&notify_worker.mutex);
+
+		notify_next_app(force);
+	}
+
+	return NULL;
 }
 
-/* Launch the thread notify_thread_app to look for next appointment. */
+/* Have the notify worker, started on first use, look for next appointment. */
 void notify_check_next_app(int force)
 {
-	pthread_t notify_t_app;
-	void *arg = (force ? (void *)1 : NULL);
-
-	pthread_create(&notify_t_app, &detached_thread_attr,
-		       notify_thread_app, arg);
-	return;
+	pthread_t notify_t_worker;
+
+	pthread_mutex_lock(&notify_worker.mutex);
+	if (!notify_worker.started)
+		notify_worker.started =
+		    !pthread_create(&notify_t_worker, &detached_thread_attr,
+				    notify_worker_thread, NULL);
+	notify_worker.pending = 1;
+	notify_worker.force |= force;
+	pthread_cond_signal(&notify_worker.cond);
+	pthread_mutex_unlock(&notify_worker.mutex);
 }
 
 /* Check if the newly created appointment is to be notified. */
-void notify_check_added(char *mesg, time_t start, char state)
+void notify_check_added(struct apoint *apt)
 {
-	time_t current_time;
+	char *mesg = apt->mesg;
+	time_t current_time, start = apt->start;
+	char state = apt->state;
 	int update_notify = 0;
 	long gap;
 
+	notify_queue_apoint(apt);
 	current_time = time(NULL);
 	pthread_mutex_lock(&notify_app.mutex);
 	if (!notify_app.got_app) {
@@ -495,6 +931,7 @@ void notify_check_repeated(struct recur_apoint *i)
 	time_t current_time, real_app_time;
 	int update_notify = 0;
 
+	notify_queue_recur(i);
 	current_time = time(NULL);
 	pthread_mutex_lock(&notify_app.mutex);
 	if (recur_item_find_occurrence
@@ -558,6 +995,7 @@ void notify_start_main_thread(void)
         /* Avoid starting the notification bar thread twice. */
 	notify_stop_main_thread();
 
+	notify_queue_build(0);
 	pthread_create(&notify_t_main, NULL, notify_main_thread, NULL);
 	notify_check_next_app(0);
 }
@@ -598,7 +1036,7 @@ print_option(WINDOW * win, unsigned x, unsigned y, char *name,
 static void print_config_option(int i, WINDOW *win, int y, int hilt, void *cb_data)
 {
 	enum { SHOW, DATE, CLOCK, WARN, CMD, NOTIFYALL, DMON, DMON_LOG,
-		    NB_OPT };
+		    DMON_SOCK, NB_OPT };
 
 	struct opt_s {
 		char *name;
@@ -639,6 +1077,10 @@ static void print_config_option(int i, WINDOW *win, int y, int hilt, void *cb_da
 	opt[DMON_LOG].desc =
 	    _("(Log activity when running in background)");
 
+	opt[DMON_SOCK].name = "daemon.socket = ";
+	opt[DMON_SOCK].desc =
+	    _("(Answer queries of --client when running in background)");
+
 	pthread_mutex_lock(&nbar.mutex);
 
 	/* String value options */
@@ -653,9 +1095,10 @@ static void print_config_option(int i, WINDOW *win, int y, int hilt, void *cb_da
 
 	opt[DMON].valnum = dmon.enable;
 	opt[DMON_LOG].valnum = dmon.log;
+	opt[DMON_SOCK].valnum = dmon.socket;
 
 	opt[SHOW].valstr[0] = opt[DMON].valstr[0] =
-		opt[DMON_LOG].valstr[0] = '\0';
+		opt[DMON_LOG].valstr[0] = opt[DMON_SOCK].valstr[0] = '\0';
 
 	opt[NOTIFYALL].valnum = nbar.notify_all;
 	if (opt[NOTIFYALL].valnum == NOTIFY_FLAGGED_ONLY)
@@ -721,6 +1164,7 @@ static void config_option_edit(int i)
 			strncpy(nbar.datefmt, buf, BUFSIZ);
 			nbar.datefmt[BUFSIZ - 1] = '\0';
 			pthread_mutex_unlock(&nbar.mutex);
+			notify_wake_bar();
 		}
 		break;
 	case 2:
@@ -734,6 +1178,7 @@ static void config_option_edit(int i)
 			strncpy(nbar.timefmt, buf, BUFSIZ);
 			nbar.timefmt[BUFSIZ - 1] = '\0';
 			pthread_mutex_unlock(&nbar.mutex);
+			notify_wake_bar();
 		}
 		break;
 	case 3:
@@ -747,6 +1192,7 @@ static void config_option_edit(int i)
 			pthread_mutex_lock(&nbar.mutex);
 			nbar.cntdwn = atoi(buf);
 			pthread_mutex_unlock(&nbar.mutex);
+			notify_wake_bar();
 		}
 		break;
 	case 4:
@@ -774,6 +1220,9 @@ static void config_option_edit(int i)
 	case 7:
 		dmon.log = !dmon.log;
 		break;
+	case 8:
+		dmon.socket = !dmon.socket;
+		break;
 	}
 
 	mem_free(buf);
@@ -792,7 +1241,7 @@ void notify_config_bar(void)
 	listbox_init(&lb, 0, 0, notify_bar() ? row - 3 : row - 2, col,
 		     _("notification options"), config_option_row_type,
 		     config_option_height, print_config_option);
-	listbox_load_items(&lb, 8);
+	listbox_load_items(&lb, 9);
 	listbox_draw_deco(&lb, 0);
 	listbox_display(&lb, NOHILT);
 	wins_set_bindings(bindings, ARRAY_SIZE(bindings));
@@ -50,52 +50,34 @@ static void pcal_export_footer(FILE *);
 /* Type definition for callbacks to export functions. */
 typedef void (*cb_dump_t) (FILE *, long, long, char *);
 
+struct dump_data {
+	long item_dur;
+	char *item_mesg;
+	cb_dump_t cb_dump;
+	FILE *stream;
+};
+
+static int dump_occurrence(time_t occurrence, void *data)
+{
+	struct dump_data *d = data;
+
+	(*d->cb_dump) (d->stream, occurrence, d->item_dur, d->item_mesg);
+	return 0;
+}
+
 /*
  * Travel through each occurence of an item, and execute the given callback
  * (mainly used to export data).
  */
 static void
-foreach_date_dump(const long date_end, struct rpt *rpt, llist_t * exc,
+foreach_date_dump(const long date_end, struct rpt *rpt, exc_list_t *exc,
 		  long item_start, long item_dur, char *item_mesg,
 		  cb_dump_t cb_dump, FILE * stream)
 {
-	long date, item_time;
-	struct tm lt;
-	time_t t;
-
-	t = item_start;
-	localtime_r(&t, &lt);
-	lt.tm_hour = lt.tm_min = lt.tm_sec = 0;
-	lt.tm_isdst = -1;
-	date = mktime(&lt);
-	item_time = item_start - date;
-
-	while (date <= date_end && date <= rpt->until) {
-		if (recur_item_inday(item_start, item_dur, rpt, exc, date)) {
-			(*cb_dump) (stream, date + item_time, item_dur,
-				    item_mesg);
-		}
-		switch (rpt->type) {
-		case RECUR_DAILY:
-			date = date_sec_change(date, 0, rpt->freq);
-			break;
-		case RECUR_WEEKLY:
-			date =
-			    date_sec_change(date, 0,
-					    rpt->freq * WEEKINDAYS);
-			break;
-		case RECUR_MONTHLY:
-			date = date_sec_change(date, rpt->freq, 0);
-			break;
-		case RECUR_YEARLY:
-			date = date_sec_change(date, rpt->freq * 12, 0);
-			break;
-		default:
-			EXIT(_("incoherent repetition type"));
-			/* NOTREACHED */
-			break;
-		}
-	}
+	struct dump_data d = { item_dur, item_mesg, cb_dump, stream };
+
+	recur_item_occurrences(item_start, item_dur, rpt, exc, item_start,
+			       date_end, dump_occurrence, &d);
 }
 
 static void pcal_export_header(FILE * stream)
@@ -293,7 +275,7 @@ static void pcal_export_apoints(FILE * stream)
 
 	fputs("\n# ============\n# Appointments\n# ============\n",
 	      stream);
-	LLIST_TS_LOCK(&alist_p);
+	LLIST_TS_RDLOCK(&alist_p);
 	LLIST_TS_FOREACH(&alist_p, i) {
 		struct apoint *apt = LLIST_TS_GET_DATA(i);
 		pcal_dump_apoint(stream, apt->start, apt->dur, apt->mesg);
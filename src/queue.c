@@ -67,6 +67,7 @@ struct event *que_ins(char *mesg, time_t time, int id)
 	ev->day = time;
 	ev->id = id;
 	ev->note = NULL;
+	ev->digest.valid = 0;
 	pthread_mutex_lock(&que_mutex);
 	LLIST_ADD(&sysqueue, ev);
 	pthread_mutex_unlock(&que_mutex);
@@ -123,10 +124,13 @@ void que_show(void)
 void que_save(void)
 {
 	struct event *ev;
+	struct day_item d = empty_day;
 
 	if (!que_ued())
 		return;
 	ev = que_get();
-	apoint_new(ev->mesg, NULL, ev->day, 0, APOINT_NULL);
+	d.type = APPT;
+	d.item.apt = apoint_new(ev->mesg, NULL, ev->day, 0, APOINT_NULL);
+	io_journal_update(NULL, &d);
 	io_set_modified();
 }
@@ -41,7 +41,6 @@
 #include <time.h>
 
 #include "calcurse.h"
-#include "sha1.h"
 
 llist_ts_t recur_alist_p;
 llist_t recur_elist;
@@ -74,66 +73,157 @@ void recur_int_list_dup(llist_t *l, llist_t *ilist)
 	}
 }
 
-static int int_cmp(int *list, int *i)
+/*
+ * Compile the BY* lists of a recurrence rule into the bit masks used for
+ * membership tests. Must be called whenever one of the lists changes.
+ */
+void recur_rpt_compile(struct rpt *rpt)
 {
-	return *list == *i;
+	llist_item_t *i;
+	int n;
+
+	rpt->bymonth_mask = 0;
+	rpt->bymonthday_mask = 0;
+	for (n = 0; n < WEEKINDAYS; n++)
+		rpt->bywday_pos[n] = rpt->bywday_neg[n] = 0;
+
+	LLIST_FOREACH(&rpt->bymonth, i) {
+		n = *(int *)LLIST_GET_DATA(i);
+		if (n >= 1 && n <= YEARINMONTHS)
+			rpt->bymonth_mask |= 1u << n;
+	}
+	LLIST_FOREACH(&rpt->bymonthday, i) {
+		n = *(int *)LLIST_GET_DATA(i);
+		if (n >= 1 && n <= 31)
+			rpt->bymonthday_mask |= (uint64_t)1 << n;
+		else if (n <= -1 && n >= -31)
+			rpt->bymonthday_mask |= (uint64_t)1 << (31 - n);
+	}
+	/* A weekday is stored as order * 7 + wday or -(order * 7 + wday). */
+	LLIST_FOREACH(&rpt->bywday, i) {
+		n = *(int *)LLIST_GET_DATA(i);
+		if (n >= 0 && n / WEEKINDAYS < 64)
+			rpt->bywday_pos[n % WEEKINDAYS] |=
+				(uint64_t)1 << (n / WEEKINDAYS);
+		else if (n < 0 && -n / WEEKINDAYS < 64)
+			rpt->bywday_neg[-n % WEEKINDAYS] |=
+				(uint64_t)1 << (-n / WEEKINDAYS);
+	}
 }
 
-static void free_exc(struct excp *exc)
+/* Is the month (1-12) in the BYMONTH list? */
+static int bymonth_has(struct rpt *rpt, int mon)
 {
-	mem_free(exc);
+	return (rpt->bymonth_mask >> mon) & 1;
 }
 
-void recur_free_exc_list(llist_t * exc)
+/* Is the day of month, counted forwards or backwards, in the BYMONTHDAY list? */
+static int bymonthday_has(struct rpt *rpt, int mday, int rmday)
 {
-	LLIST_FREE_INNER(exc, free_exc);
-	LLIST_FREE(exc);
+	return ((rpt->bymonthday_mask >> mday) |
+		(rpt->bymonthday_mask >> (31 - rmday))) & 1;
 }
 
-static int exc_cmp_day(struct excp *a, struct excp *b)
+/*
+ * Is the weekday in the BYDAY list, either without order or as the order-th
+ * (counted forwards) or rorder-th (counted backwards) weekday?
+ */
+static int bywday_has(struct rpt *rpt, int wday, int order, int rorder)
 {
-	return a->st < b->st ? -1 : (a->st == b->st ? 0 : 1);
+	uint64_t pos = rpt->bywday_pos[wday], neg = rpt->bywday_neg[wday];
+
+	if (pos & 1)
+		return 1;
+	if (order > 0 && order < 64 && (pos >> order) & 1)
+		return 1;
+	if (rorder > 0 && rorder < 64 && (neg >> rorder) & 1)
+		return 1;
+	return 0;
 }
 
-static int exc_inday(struct excp *exc, time_t *day_start)
+void recur_exc_init(exc_list_t *exc)
 {
-	return (date_cmp_day(exc->st, *day_start) == 0);
+	exc->count = exc->size = 0;
+	exc->st = NULL;
 }
 
-static void recur_add_exc(llist_t * exc, time_t day)
+void recur_free_exc_list(exc_list_t *exc)
 {
-	struct excp *o = mem_malloc(sizeof(struct excp));
-	o->st = day;
+	if (exc->st)
+		mem_free(exc->st);
+	recur_exc_init(exc);
+}
+
+/* Return the index of the first exception after t. */
+static unsigned exc_upper_bound(exc_list_t *exc, time_t t)
+{
+	unsigned lo = 0, hi = exc->count, mid;
 
-	LLIST_ADD_SORTED(exc, o, exc_cmp_day);
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (exc->st[mid] <= t)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
 }
 
-void recur_exc_dup(llist_t * in, llist_t * exc)
+/* Is the day of t an exception day? */
+static int exc_inday(exc_list_t *exc, time_t t)
 {
-	llist_item_t *i;
+	unsigned i = exc_upper_bound(exc, t);
 
-	LLIST_INIT(in);
+	return i > 0 && date_cmp_day(exc->st[i - 1], t) == 0;
+}
 
-	if (exc) {
-		LLIST_FOREACH(exc, i) {
-			struct excp *p = LLIST_GET_DATA(i);
-			recur_add_exc(in, p->st);
-		}
+/* Insert the beginning of a day, keeping the exceptions sorted. */
+static void exc_insert(exc_list_t *exc, time_t day)
+{
+	unsigned i;
+
+	if (exc->count == exc->size) {
+		exc->size = exc->size ? 2 * exc->size : 4;
+		if (exc->st)
+			exc->st = mem_realloc(exc->st, exc->size,
+					      sizeof(time_t));
+		else
+			exc->st = mem_malloc(exc->size * sizeof(time_t));
+	}
+	i = exc_upper_bound(exc, day);
+	memmove(exc->st + i + 1, exc->st + i,
+		(exc->count - i) * sizeof(time_t));
+	exc->st[i] = day;
+	exc->count++;
+}
+
+/* Add the day of t to the exceptions. */
+void recur_add_exc(exc_list_t *exc, time_t t)
+{
+	exc_insert(exc, DAY(t));
+}
+
+void recur_exc_dup(exc_list_t *in, exc_list_t *exc)
+{
+	recur_exc_init(in);
+
+	if (exc && exc->count) {
+		in->st = mem_malloc(exc->count * sizeof(time_t));
+		memcpy(in->st, exc->st, exc->count * sizeof(time_t));
+		in->count = in->size = exc->count;
 	}
 }
 
 /* Return a string containing the exception days. */
-char *recur_exc2str(llist_t *exc)
+char *recur_exc2str(exc_list_t *exc)
 {
-	llist_item_t *i;
-	struct excp *p;
+	unsigned i;
 	struct string s;
 	struct tm tm;
 
 	string_init(&s);
-	LLIST_FOREACH(exc, i) {
-		p = LLIST_GET_DATA(i);
-		localtime_r(&p->st, &tm);
+	for (i = 0; i < exc->count; i++) {
+		localtime_r(&exc->st[i], &tm);
 		string_catftime(&s, DATEFMT(conf.input_datefmt), &tm);
 		string_catf(&s, "%c", ' ');
 	}
@@ -144,13 +234,12 @@ char *recur_exc2str(llist_t *exc)
  * Update a list of exceptions from a string of days. Any positive number of
  * spaces are allowed before, between and after the days.
  */
-int recur_str2exc(llist_t *exc, char *days)
+int recur_str2exc(exc_list_t *exc, char *days)
 {
-	int updated = 0;
 	char *d;
 	time_t t = get_today();
-	llist_t nexc;
-	LLIST_INIT(&nexc);
+	exc_list_t nexc;
+	recur_exc_init(&nexc);
 
 	while (1) {
 		while (*days == ' ')
@@ -169,11 +258,11 @@ int recur_str2exc(llist_t *exc, char *days)
 			break;
 	}
 	recur_free_exc_list(exc);
-	recur_exc_dup(exc, &nexc);
-	updated = 1;
+	*exc = nexc;
+	return 1;
 cleanup:
 	recur_free_exc_list(&nexc);
-	return updated;
+	return 0;
 }
 
 struct recur_event *recur_event_dup(struct recur_event *in)
@@ -194,7 +283,8 @@ struct recur_event *recur_event_dup(struct recur_event *in)
 	LLIST_INIT(&rev->rpt->bymonth);
 	LLIST_INIT(&rev->rpt->bywday);
 	LLIST_INIT(&rev->rpt->bymonthday);
-	LLIST_INIT(&rev->rpt->exc);
+	recur_exc_init(&rev->rpt->exc);
+	recur_rpt_compile(rev->rpt);
 
 	recur_exc_dup(&rev->exc, &in->exc);
 
@@ -202,6 +292,7 @@ struct recur_event *recur_event_dup(struct recur_event *in)
 		rev->note = mem_strdup(in->note);
 	else
 		rev->note = NULL;
+	rev->digest.valid = 0;
 
 	return rev;
 }
@@ -226,7 +317,8 @@ struct recur_apoint *recur_apoint_dup(struct recur_apoint *in)
 	LLIST_INIT(&rapt->rpt->bymonth);
 	LLIST_INIT(&rapt->rpt->bywday);
 	LLIST_INIT(&rapt->rpt->bymonthday);
-	LLIST_INIT(&rapt->rpt->exc);
+	recur_exc_init(&rapt->rpt->exc);
+	recur_rpt_compile(rapt->rpt);
 
 	recur_exc_dup(&rapt->exc, &in->exc);
 
@@ -234,6 +326,7 @@ struct recur_apoint *recur_apoint_dup(struct recur_apoint *in)
 		rapt->note = mem_strdup(in->note);
 	else
 		rapt->note = NULL;
+	rapt->digest.valid = 0;
 
 	return rapt;
 }
@@ -317,9 +410,36 @@ static int recur_event_cmp(struct recur_event *a, struct recur_event *b)
 	return strcmp(a->mesg, b->mesg);
 }
 
-/* Insert a new recursive appointment in the general linked list */
-struct recur_apoint *recur_apoint_new(char *mesg, char *note, time_t start,
-				      long dur, char state, struct rpt *rpt)
+/* Sort a list of recurrent items after a bulk load. */
+void recur_apoint_llist_sort(llist_t *l)
+{
+	LLIST_SORT(l, recur_apoint_cmp);
+}
+
+void recur_event_llist_sort(llist_t *l)
+{
+	LLIST_SORT(l, recur_event_cmp);
+}
+
+/* Merge n sorted lists of recurrent items into the general lists. */
+void recur_apoint_llist_merge(llist_t *lists, unsigned n)
+{
+	LLIST_TS_LOCK(&recur_alist_p);
+	LLIST_TS_MERGE(&recur_alist_p, lists, n, recur_apoint_cmp);
+	LLIST_TS_UNLOCK(&recur_alist_p);
+}
+
+void recur_event_llist_merge(llist_t *lists, unsigned n)
+{
+	LLIST_MERGE(&recur_elist, lists, n, recur_event_cmp);
+}
+
+/*
+ * Allocate a recurrent appointment. The BY* and exception lists of the rule
+ * are moved to the new item.
+ */
+struct recur_apoint *recur_apoint_alloc(char *mesg, char *note, time_t start,
+					long dur, char state, struct rpt *rpt)
 {
 	struct recur_apoint *rapt =
 	    mem_malloc(sizeof(struct recur_apoint));
@@ -337,13 +457,25 @@ struct recur_apoint *recur_apoint_new(char *mesg, char *note, time_t start,
 	recur_free_int_list(&rpt->bywday);
 	recur_int_list_dup(&rapt->rpt->bymonthday, &rpt->bymonthday);
 	recur_free_int_list(&rpt->bymonthday);
+	recur_rpt_compile(rapt->rpt);
 	/*
 	 * Note. The exception dates are in the list rapt->exc.
 	 * The (empty) list rapt->rpt->exc is not used.
 	 */
 	recur_exc_dup(&rapt->exc, &rpt->exc);
 	recur_free_exc_list(&rpt->exc);
-	LLIST_INIT(&rapt->rpt->exc);
+	recur_exc_init(&rapt->rpt->exc);
+	rapt->digest.valid = 0;
+
+	return rapt;
+}
+
+/* Insert a new recursive appointment in the general linked list */
+struct recur_apoint *recur_apoint_new(char *mesg, char *note, time_t start,
+				      long dur, char state, struct rpt *rpt)
+{
+	struct recur_apoint *rapt =
+	    recur_apoint_alloc(mesg, note, start, dur, state, rpt);
 
 	LLIST_TS_LOCK(&recur_alist_p);
 	LLIST_TS_ADD_SORTED(&recur_alist_p, rapt, recur_apoint_cmp);
@@ -352,9 +484,8 @@ struct recur_apoint *recur_apoint_new(char *mesg, char *note, time_t start,
 	return rapt;
 }
 
-/* Insert a new recursive event in the general linked list */
-struct recur_event *recur_event_new(char *mesg, char *note, time_t day,
-				    int id, struct rpt *rpt)
+struct recur_event *recur_event_alloc(char *mesg, char *note, time_t day,
+				      int id, struct rpt *rpt)
 {
 	struct recur_event *rev = mem_malloc(sizeof(struct recur_event));
 
@@ -370,10 +501,22 @@ struct recur_event *recur_event_new(char *mesg, char *note, time_t day,
 	recur_free_int_list(&rpt->bywday);
 	recur_int_list_dup(&rev->rpt->bymonthday, &rpt->bymonthday);
 	recur_free_int_list(&rpt->bymonthday);
+	recur_rpt_compile(rev->rpt);
 	/* Similarly as for recurrent appointment. */
 	recur_exc_dup(&rev->exc, &rpt->exc);
 	recur_free_exc_list(&rpt->exc);
-	LLIST_INIT(&rev->rpt->exc);
+	recur_exc_init(&rev->rpt->exc);
+	rev->digest.valid = 0;
+
+	return rev;
+}
+
+/* Insert a new recursive event in the general linked list */
+struct recur_event *recur_event_new(char *mesg, char *note, time_t day,
+				    int id, struct rpt *rpt)
+{
+	struct recur_event *rev =
+	    recur_event_alloc(mesg, note, day, id, rpt);
 
 	LLIST_ADD_SORTED(&recur_elist, rev, recur_event_cmp);
 
@@ -443,7 +586,8 @@ static void bymonthday_append(struct string *s, llist_t *l)
 
 	LLIST_FOREACH(l, i) {
 		int *day = LLIST_GET_DATA(i);
-		string_catf(s, " d%d", *day);
+		string_cat(s, " d");
+		string_catnum(s, *day, 0);
 	}
 }
 
@@ -454,7 +598,8 @@ static void bywday_append(struct string *s, llist_t *l)
 
 	LLIST_FOREACH(l, i) {
 		int *wday = LLIST_GET_DATA(i);
-		string_catf(s, " w%d", *wday);
+		string_cat(s, " w");
+		string_catnum(s, *wday, 0);
 	}
 }
 
@@ -465,39 +610,32 @@ static void bymonth_append(struct string *s, llist_t *l)
 
 	LLIST_FOREACH(l, i) {
 		int *mon = LLIST_GET_DATA(i);
-		string_catf(s, " m%d", *mon);
+		string_cat(s, " m");
+		string_catnum(s, *mon, 0);
 	}
 }
 
 /* Write days for which recurrent items should not be repeated. */
-static void recur_exc_append(struct string *s, llist_t *lexc)
+static void recur_exc_append(struct string *s, exc_list_t *exc)
 {
-	llist_item_t *i;
+	unsigned i;
 	struct tm lt;
-	time_t t;
-	int st_mon, st_day, st_year;
-
-	LLIST_FOREACH(lexc, i) {
-		struct excp *exc = LLIST_GET_DATA(i);
-		t = exc->st;
-		localtime_r(&t, &lt);
-		st_mon = lt.tm_mon + 1;
-		st_day = lt.tm_mday;
-		st_year = lt.tm_year + 1900;
-		string_catf(s, " !%02u/%02u/%04u", st_mon, st_day, st_year);
+
+	for (i = 0; i < exc->count; i++) {
+		date_localtime(&exc->st[i], &lt);
+		string_cat(s, " !");
+		string_catdate(s, &lt);
 	}
 }
 
-/* Load the recursive appointment description */
-char *recur_apoint_scan(FILE *f, struct tm start, struct tm end,
-				       char state, char *note,
-				       struct item_filter *filter,
+/*
+ * Load the recursive appointment description, or only check it if l is NULL.
+ */
+char *recur_apoint_scan(llist_t *l, char *mesg, struct tm start,
+				       struct tm end, char state, char *note,
 				       struct rpt *rpt)
 {
-	char buf[BUFSIZ], *nl;
 	time_t tstart, tend;
-	struct recur_apoint *rapt = NULL;
-	int cond;
 
 	if (!check_date(start.tm_year, start.tm_mon, start.tm_mday) ||
 	    !check_date(end.tm_year, end.tm_mon, end.tm_mday) ||
@@ -505,86 +643,43 @@ char *recur_apoint_scan(FILE *f, struct tm start, struct tm end,
 	    !check_time(end.tm_hour, end.tm_min))
 		return _("illegal date in appointment");
 
-	/* Read the appointment description */
-	if (!fgets(buf, sizeof buf, f))
-		return _("error in appointment description");
-
-	nl = strchr(buf, '\n');
-	if (nl) {
-		*nl = '\0';
-	}
 	start.tm_sec = end.tm_sec = 0;
 	start.tm_isdst = end.tm_isdst = -1;
 	start.tm_year -= 1900;
 	start.tm_mon--;
 	end.tm_year -= 1900;
 	end.tm_mon--;
-	tstart = mktime(&start);
-	tend = mktime(&end);
+	tstart = date_mktime(&start);
+	tend = date_mktime(&end);
 
 	if (tstart == -1 || tend == -1 || tstart > tend)
 		 return _("date error in appointment");
 
 	/* Does it occur on the start day? */
+	recur_rpt_compile(rpt);
 	if (!recur_item_find_occurrence(tstart, tend - tstart, rpt, NULL,
 					DAY(tstart), NULL)) {
 		char *fmt = _("recurrence error: not on start day (%s)");
 		return day_ins(&fmt, tstart);
 	}
 
-	/* Filter item. */
-	if (filter) {
-		cond = (
-		    !(filter->type_mask & TYPE_MASK_RECUR_APPT) ||
-		    (filter->regex && regexec(filter->regex, buf, 0, 0, 0)) ||
-		    (filter->start_from != -1 && tstart < filter->start_from) ||
-		    (filter->start_to != -1 && tstart > filter->start_to) ||
-		    (filter->end_from != -1 && tend < filter->end_from) ||
-		    (filter->end_to != -1 && tend > filter->end_to)
-		);
-		if (filter->hash) {
-			rapt = recur_apoint_new(buf, note, tstart,
-						 tend - tstart, state,
-						 rpt);
-			char *hash = recur_apoint_hash(rapt);
-			cond = cond || !hash_matches(filter->hash, hash);
-			mem_free(hash);
-		}
-
-		if ((!filter->invert && cond) || (filter->invert && !cond)) {
-			if (filter->hash)
-				recur_apoint_erase(rapt);
-			return NULL;
-		}
-	}
-	if (!rapt)
-		rapt = recur_apoint_new(buf, note, tstart, tend - tstart, state,
-					 rpt);
+	/* Appended unsorted, see recur_apoint_llist_merge(). */
+	if (l)
+		LLIST_ADD(l, recur_apoint_alloc(mesg, note, tstart,
+						tend - tstart, state, rpt));
 	return NULL;
 }
 
-/* Load the recursive events from file */
-char *recur_event_scan(FILE * f, struct tm start, int id,
-				     char *note, struct item_filter *filter,
-				     struct rpt *rpt)
+/* Load the recursive events from file, or only check them if l is NULL. */
+char *recur_event_scan(llist_t *l, char *mesg, struct tm start, int id,
+				     char *note, struct rpt *rpt)
 {
-	char buf[BUFSIZ], *nl;
-	time_t tstart, tend;
-	struct recur_event *rev = NULL;
-	int cond;
+	time_t tstart;
 
 	if (!check_date(start.tm_year, start.tm_mon, start.tm_mday) ||
 	    !check_time(start.tm_hour, start.tm_min))
 		return _("illegel date in event");
 
-	/* Read the event description */
-	if (!fgets(buf, sizeof buf, f))
-		return _("error in appointment description");
-
-	nl = strchr(buf, '\n');
-	if (nl) {
-		*nl = '\0';
-	}
 	start.tm_hour = 0;
 	start.tm_min = 0;
 	start.tm_sec = 0;
@@ -592,100 +687,160 @@ char *recur_event_scan(FILE * f, struct tm start, int id,
 	start.tm_year -= 1900;
 	start.tm_mon--;
 
-	tstart = mktime(&start);
+	tstart = date_mktime(&start);
 	if (tstart == -1)
 		return _("date error in event");
-	tend = ENDOFDAY(tstart);
 
 	/* Does it occur on the start day? */
+	recur_rpt_compile(rpt);
 	if (!recur_item_find_occurrence(tstart, -1, rpt, NULL,
 					DAY(tstart), NULL)) {
 		char *fmt = _("recurrence error: not on start day (%s)");
 		return day_ins(&fmt, tstart);
 	}
 
-	/* Filter item. */
-	if (filter) {
-		cond = (
-		    !(filter->type_mask & TYPE_MASK_RECUR_EVNT) ||
-		    (filter->regex && regexec(filter->regex, buf, 0, 0, 0)) ||
-		    (filter->start_from != -1 && tstart < filter->start_from) ||
-		    (filter->start_to != -1 && tstart > filter->start_to) ||
-		    (filter->end_from != -1 && tend < filter->end_from) ||
-		    (filter->end_to != -1 && tend > filter->end_to)
-		);
-		if (filter->hash) {
-			rev = recur_event_new(buf, note, tstart, id,
-					       rpt);
-			char *hash = recur_event_hash(rev);
-			cond = cond || !hash_matches(filter->hash, hash);
-			mem_free(hash);
-		}
+	/* Appended unsorted, see recur_event_llist_merge(). */
+	if (l)
+		LLIST_ADD(l, recur_event_alloc(mesg, note, tstart, id, rpt));
+	return NULL;
+}
 
-		if ((!filter->invert && cond) || (filter->invert && !cond)) {
-			if (filter->hash)
-				recur_event_erase(rev);
-			return NULL;
-		}
+static struct item_digest *recur_apoint_digest(struct recur_apoint *);
+static struct item_digest *recur_event_digest(struct recur_event *);
+
+/* Check whether a recurrent appointment is selected by a filter. */
+static int recur_apoint_filter_match(struct recur_apoint *rapt,
+				     struct item_filter *filter)
+{
+	time_t tstart = rapt->start, tend = rapt->start + rapt->dur;
+	int cond;
+
+	cond = (
+	    !(filter->type_mask & TYPE_MASK_RECUR_APPT) ||
+	    (filter->regex && regexec(filter->regex, rapt->mesg, 0, 0, 0)) ||
+	    (filter->start_from != -1 && tstart < filter->start_from) ||
+	    (filter->start_to != -1 && tstart > filter->start_to) ||
+	    (filter->end_from != -1 && tend < filter->end_from) ||
+	    (filter->end_to != -1 && tend > filter->end_to)
+	);
+	if (filter->hash) {
+		cond = cond || !item_digest_matches(filter->hash,
+						    recur_apoint_digest(rapt));
 	}
-	if (!rev)
-		rev = recur_event_new(buf, note, tstart, id, rpt);
-	return NULL;
+
+	return filter->invert ? cond : !cond;
+}
+
+/* Check whether a recurrent event is selected by a filter. */
+static int recur_event_filter_match(struct recur_event *rev,
+				    struct item_filter *filter)
+{
+	time_t tstart = rev->day, tend = ENDOFDAY(rev->day);
+	int cond;
+
+	cond = (
+	    !(filter->type_mask & TYPE_MASK_RECUR_EVNT) ||
+	    (filter->regex && regexec(filter->regex, rev->mesg, 0, 0, 0)) ||
+	    (filter->start_from != -1 && tstart < filter->start_from) ||
+	    (filter->start_to != -1 && tstart > filter->start_to) ||
+	    (filter->end_from != -1 && tend < filter->end_from) ||
+	    (filter->end_to != -1 && tend > filter->end_to)
+	);
+	if (filter->hash) {
+		cond = cond || !item_digest_matches(filter->hash,
+						    recur_event_digest(rev));
+	}
+
+	return filter->invert ? cond : !cond;
+}
+
+/* Drop the recurrent items for which fn_match() returns false. */
+void recur_apoint_llist_keep(void *data, llist_fn_match_t fn_match)
+{
+	LLIST_TS_LOCK(&recur_alist_p);
+	LLIST_TS_FILTER(&recur_alist_p, data, fn_match, recur_apoint_free);
+	LLIST_TS_UNLOCK(&recur_alist_p);
+}
+
+void recur_event_llist_keep(void *data, llist_fn_match_t fn_match)
+{
+	LLIST_FILTER(&recur_elist, data, fn_match, recur_event_free);
+}
+
+/* Drop the recurrent items that are not selected by a filter. */
+void recur_apoint_llist_filter(struct item_filter *filter)
+{
+	recur_apoint_llist_keep(filter,
+				(llist_fn_match_t)recur_apoint_filter_match);
+}
+
+void recur_event_llist_filter(struct item_filter *filter)
+{
+	recur_event_llist_keep(filter,
+			       (llist_fn_match_t)recur_event_filter_match);
+}
+
+/* Append the recurrence rule of an item, from " {" to the closing "} ". */
+static void recur_rpt_append(struct string *s, struct rpt *rpt,
+			     exc_list_t *exc)
+{
+	struct tm lt;
+
+	string_cat(s, " {");
+	string_catnum(s, rpt->freq, 0);
+	string_catc(s, recur_def2char(rpt->type));
+	if (rpt->until != 0) {
+		date_localtime(&rpt->until, &lt);
+		string_cat(s, " -> ");
+		string_catdate(s, &lt);
+	}
+	bymonthday_append(s, &rpt->bymonthday);
+	bywday_append(s, &rpt->bywday);
+	bymonth_append(s, &rpt->bymonth);
+	recur_exc_append(s, exc);
+	string_cat(s, "} ");
+}
+
+/* Append a recurrent appointment in the format of the data file. */
+void recur_apoint_append(struct string *s, struct recur_apoint *o)
+{
+	apoint_append_time(s, o->start);
+	string_cat(s, " -> ");
+	apoint_append_time(s, o->start + o->dur);
+	recur_rpt_append(s, o->rpt, &o->exc);
+	if (o->note) {
+		string_catc(s, '>');
+		string_cat(s, o->note);
+		string_catc(s, ' ');
+	}
+	string_catc(s, (o->state & APOINT_NOTIFY) ? '!' : '|');
+	string_cat(s, o->mesg);
 }
 
 char *recur_apoint_tostr(struct recur_apoint *o)
 {
 	struct string s;
-	struct tm lt;
-	time_t t;
 
 	string_init(&s);
+	recur_apoint_append(&s, o);
 
-	t = o->start;
-	localtime_r(&t, &lt);
-	string_catf(&s, "%02u/%02u/%04u @ %02u:%02u", lt.tm_mon + 1,
-		lt.tm_mday, 1900 + lt.tm_year, lt.tm_hour, lt.tm_min);
-
-	t = o->start + o->dur;
-	localtime_r(&t, &lt);
-	string_catf(&s, " -> %02u/%02u/%04u @ %02u:%02u", lt.tm_mon + 1,
-		lt.tm_mday, 1900 + lt.tm_year, lt.tm_hour, lt.tm_min);
-
-	t = o->rpt->until;
-	if (t == 0) {
-		/* We have an endless recurrent appointment. */
-		string_catf(&s, " {%d%c", o->rpt->freq,
-			recur_def2char(o->rpt->type));
-	} else {
-		localtime_r(&t, &lt);
-		string_catf(&s, " {%d%c -> %02u/%02u/%04u", o->rpt->freq,
-			recur_def2char(o->rpt->type), lt.tm_mon + 1,
-			lt.tm_mday, 1900 + lt.tm_year);
+	return string_buf(&s);
+}
+
+/* Return the digest of a recurrent appointment, computing it on first use. */
+static struct item_digest *recur_apoint_digest(struct recur_apoint *rapt)
+{
+	if (!rapt->digest.valid) {
+		char *raw = recur_apoint_tostr(rapt);
+		item_digest_compute(&rapt->digest, raw);
 	}
-	bymonthday_append(&s, &o->rpt->bymonthday);
-	bywday_append(&s, &o->rpt->bywday);
-	bymonth_append(&s, &o->rpt->bymonth);
-	recur_exc_append(&s, &o->exc);
-	string_catf(&s, "} ");
-	if (o->note)
-		string_catf(&s, ">%s ", o->note);
-	if (o->state & APOINT_NOTIFY)
-		string_catf(&s, "%c", '!');
-	else
-		string_catf(&s, "%c", '|');
-	string_catf(&s, "%s", o->mesg);
 
-	return string_buf(&s);
+	return &rapt->digest;
 }
 
 char *recur_apoint_hash(struct recur_apoint *rapt)
 {
-	char *raw = recur_apoint_tostr(rapt);
-	char *sha1 = mem_malloc(SHA1_DIGESTLEN * 2 + 1);
-	sha1_digest(raw, sha1);
-	mem_free(raw);
-
-	return sha1;
+	return item_digest_hex(recur_apoint_digest(rapt));
 }
 
 void recur_apoint_write(struct recur_apoint *o, FILE * f)
@@ -695,57 +850,49 @@ void recur_apoint_write(struct recur_apoint *o, FILE * f)
 	mem_free(str);
 }
 
+/* Append a recurrent event in the format of the data file. */
+void recur_event_append(struct string *s, struct recur_event *o)
+{
+	struct tm lt;
+
+	date_localtime(&o->day, &lt);
+	string_catdate(s, &lt);
+	string_cat(s, " [");
+	string_catnum(s, o->id, 0);
+	string_catc(s, ']');
+	recur_rpt_append(s, o->rpt, &o->exc);
+	if (o->note) {
+		string_catc(s, '>');
+		string_cat(s, o->note);
+		string_catc(s, ' ');
+	}
+	string_cat(s, o->mesg);
+}
+
 char *recur_event_tostr(struct recur_event *o)
 {
 	struct string s;
-	struct tm lt;
-	time_t t;
-	int st_mon, st_day, st_year;
-	int end_mon, end_day, end_year;
 
 	string_init(&s);
+	recur_event_append(&s, o);
 
-	t = o->day;
-	localtime_r(&t, &lt);
-	st_mon = lt.tm_mon + 1;
-	st_day = lt.tm_mday;
-	st_year = lt.tm_year + 1900;
-	t = o->rpt->until;
-	if (t == 0) {
-		/* We have an endless recurrent event. */
-		string_catf(&s, "%02u/%02u/%04u [%d] {%d%c", st_mon, st_day,
-			st_year, o->id, o->rpt->freq,
-			recur_def2char(o->rpt->type));
-	} else {
-		localtime_r(&t, &lt);
-		end_mon = lt.tm_mon + 1;
-		end_day = lt.tm_mday;
-		end_year = lt.tm_year + 1900;
-		string_catf(&s, "%02u/%02u/%04u [%d] {%d%c -> %02u/%02u/%04u",
-			st_mon, st_day, st_year, o->id, o->rpt->freq,
-			recur_def2char(o->rpt->type), end_mon, end_day,
-			end_year);
+	return string_buf(&s);
+}
+
+/* Return the digest of a recurrent event, computing it on first use. */
+static struct item_digest *recur_event_digest(struct recur_event *rev)
+{
+	if (!rev->digest.valid) {
+		char *raw = recur_event_tostr(rev);
+		item_digest_compute(&rev->digest, raw);
 	}
-	bymonthday_append(&s, &o->rpt->bymonthday);
-	bywday_append(&s, &o->rpt->bywday);
-	bymonth_append(&s, &o->rpt->bymonth);
-	recur_exc_append(&s, &o->exc);
-	string_catf(&s, "} ");
-	if (o->note)
-		string_catf(&s, ">%s ", o->note);
-	string_catf(&s, "%s", o->mesg);
 
-	return string_buf(&s);
+	return &rev->digest;
 }
 
 char *recur_event_hash(struct recur_event *rev)
 {
-	char *raw = recur_event_tostr(rev);
-	char *sha1 = mem_malloc(SHA1_DIGESTLEN * 2 + 1);
-	sha1_digest(raw, sha1);
-	mem_free(raw);
-
-	return sha1;
+	return item_digest_hex(recur_event_digest(rev));
 }
 
 void recur_event_write(struct recur_event *o, FILE * f)
@@ -755,24 +902,6 @@ void recur_event_write(struct recur_event *o, FILE * f)
 	mem_free(str);
 }
 
-/* Write recursive items to file. */
-void recur_save_data(FILE * f)
-{
-	llist_item_t *i;
-
-	LLIST_FOREACH(&recur_elist, i) {
-		struct recur_event *rev = LLIST_GET_DATA(i);
-		recur_event_write(rev, f);
-	}
-
-	LLIST_TS_LOCK(&recur_alist_p);
-	LLIST_TS_FOREACH(&recur_alist_p, i) {
-		struct recur_apoint *rapt = LLIST_GET_DATA(i);
-		recur_apoint_write(rapt, f);
-	}
-	LLIST_TS_UNLOCK(&recur_alist_p);
-}
-
 /*
  * Return the month day counted from the opposite end of the month.
  */
@@ -787,35 +916,16 @@ static int opp_mday(int year, int month, int day)
 		return day + 1 + m_days;
 }
 
-/*
- * The two following defines together with the diff_days, diff_months and
- * diff_years functions were provided by Lukas Fleischer to correct the wrong
- * calculation of recurrent dates after a turn of year.
- */
-#define BC(start, end, bs)                                              \
-  (((end) - (start) + ((start) % bs) - ((end) % bs)) / bs               \
-   + ((((start) % bs) == 0) ? 1 : 0))
-
-#define LEAPCOUNT(start, end)                                           \
-  (BC(start, end, 4) - BC(start, end, 100) + BC(start, end, 400))
-
 /* Calculate the difference in days between two dates. */
 static long diff_days(struct tm lt_start, struct tm lt_end)
 {
-	long diff;
-
 	if (lt_end.tm_year < lt_start.tm_year)
 		return 0;
 
-	diff = lt_end.tm_yday - lt_start.tm_yday;
-
-	if (lt_end.tm_year > lt_start.tm_year) {
-		diff += (lt_end.tm_year - lt_start.tm_year) * YEARINDAYS;
-		diff += LEAPCOUNT(lt_start.tm_year + TM_YEAR_BASE,
-				  lt_end.tm_year + TM_YEAR_BASE - 1);
-	}
-
-	return diff;
+	return days_from_civil(lt_end.tm_year + TM_YEAR_BASE,
+			       lt_end.tm_mon + 1, lt_end.tm_mday) -
+	       days_from_civil(lt_start.tm_year + TM_YEAR_BASE,
+			       lt_start.tm_mon + 1, lt_start.tm_mday);
 }
 
 /* Calculate the difference in months between two dates. */
@@ -846,7 +956,7 @@ static int date_chk(time_t t, int mon, int mday)
 {
 	struct tm tm;
 
-	localtime_r(&t, &tm);
+	date_localtime(&t, &tm);
 
 	return tm.tm_mon == mon && tm.tm_mday == mday;
 }
@@ -855,7 +965,7 @@ static int date_chk(time_t t, int mon, int mday)
  * Return true if the rrule (start, dur, rpt, exc) has an occurrence on the
  * given day. If so, save that occurrence in a (dynamic or static) buffer.
  */
-static int find_occurrence(time_t start, long dur, struct rpt *rpt, llist_t *exc,
+static int find_occurrence(time_t start, long dur, struct rpt *rpt, exc_list_t *exc,
 			   time_t day, time_t *occurrence)
 {
 	/*
@@ -869,7 +979,7 @@ static int find_occurrence(time_t start, long dur, struct rpt *rpt, llist_t *exc
 	long diff;
 	struct tm lt_day, lt_start, lt_occur;
 	time_t t;
-	int mday, order, pwday, nwday, mon;
+	int mday, order, rorder;
 
 	/* Is the given day before the day of the first occurence? */
 	if (date_cmp_day(day, start) < 0)
@@ -883,8 +993,8 @@ static int find_occurrence(time_t start, long dur, struct rpt *rpt, llist_t *exc
 	    date_cmp_day(NEXTDAY(rpt->until) + DUR(rpt->until), day) < 0)
 		return 0;
 
-	localtime_r(&day, &lt_day);	/* Given day. */
-	localtime_r(&start, &lt_start);	/* Original item. */
+	date_localtime(&day, &lt_day);	/* Given day. */
+	date_localtime(&start, &lt_start);	/* Original item. */
 	lt_occur = lt_start;		/* First occurence. */
 
 	/*
@@ -927,7 +1037,7 @@ static int find_occurrence(time_t start, long dur, struct rpt *rpt, llist_t *exc
 
 	/* Switch to calendar (Unix) time. */
 	lt_occur.tm_isdst = -1;
-	t = mktime(&lt_occur);
+	t = date_mktime(&lt_occur);
 
 	/*
 	 * Impossible dates must be ignored (according to RFC 5545). Changing
@@ -942,17 +1052,16 @@ static int find_occurrence(time_t start, long dur, struct rpt *rpt, llist_t *exc
 	 * BYMONTHDAY reduction
 	 * A month day has two possible list forms.
 	 */
-	mday = opp_mday(lt_occur.tm_year + 1900, lt_occur.tm_mon + 1,
-		     lt_occur.tm_mday);
-	if (rpt->bymonthday.head &&
-	    rpt->type == RECUR_DAILY &&
-	    !LLIST_FIND_FIRST(&rpt->bymonthday, &lt_occur.tm_mday, int_cmp) &&
-	    !LLIST_FIND_FIRST(&rpt->bymonthday, &mday, int_cmp))
-		return 0;
+	if (rpt->bymonthday.head && rpt->type == RECUR_DAILY) {
+		mday = opp_mday(lt_occur.tm_year + 1900, lt_occur.tm_mon + 1,
+				lt_occur.tm_mday);
+		if (!bymonthday_has(rpt, lt_occur.tm_mday, mday))
+			return 0;
+	}
 
 	/* BYDAY reduction for DAILY */
 	if (rpt->bywday.head && rpt->type == RECUR_DAILY &&
-	    !LLIST_FIND_FIRST(&rpt->bywday, &lt_occur.tm_wday, int_cmp))
+	    !(rpt->bywday_pos[lt_occur.tm_wday] & 1))
 		return 0;
 
 	/*
@@ -963,17 +1072,12 @@ static int find_occurrence(time_t start, long dur, struct rpt *rpt, llist_t *exc
 	    rpt->type == RECUR_MONTHLY && rpt->bymonthday.head) {
 		/* positive order */
 		order = (lt_occur.tm_mday + 6) / WEEKINDAYS;
-		pwday = order * WEEKINDAYS  + lt_occur.tm_wday;
 		/* negative order */
-		order = order
-			- wday_per_month(lt_occur.tm_mon + 1,
-					 lt_occur.tm_year + 1900,
-					 lt_occur.tm_wday)
-			- 1;
-		nwday = order * WEEKINDAYS - lt_occur.tm_wday;
-		if (!LLIST_FIND_FIRST(&rpt->bywday, &lt_occur.tm_wday, int_cmp) &&
-		    !LLIST_FIND_FIRST(&rpt->bywday, &pwday, int_cmp) &&
-		    !LLIST_FIND_FIRST(&rpt->bywday, &nwday, int_cmp))
+		rorder = wday_per_month(lt_occur.tm_mon + 1,
+					lt_occur.tm_year + 1900,
+					lt_occur.tm_wday)
+			 - order + 1;
+		if (!bywday_has(rpt, lt_occur.tm_wday, order, rorder))
 			return 0;
 	}
 
@@ -985,28 +1089,22 @@ static int find_occurrence(time_t start, long dur, struct rpt *rpt, llist_t *exc
 	    rpt->type == RECUR_YEARLY && rpt->bymonthday.head) {
 		/* positive order */
 		order = lt_occur.tm_yday / WEEKINDAYS;
-		pwday = order * WEEKINDAYS  + lt_occur.tm_wday;
 		/* negative order */
-		order = order
-			- wday_per_year(lt_occur.tm_year + 1900,
-					lt_occur.tm_wday)
-			- 1;
-		nwday = order * WEEKINDAYS - lt_occur.tm_wday;
-		if (!LLIST_FIND_FIRST(&rpt->bywday, &lt_occur.tm_wday, int_cmp) &&
-		    !LLIST_FIND_FIRST(&rpt->bywday, &pwday, int_cmp) &&
-		    !LLIST_FIND_FIRST(&rpt->bywday, &nwday, int_cmp))
+		rorder = wday_per_year(lt_occur.tm_year + 1900,
+				       lt_occur.tm_wday)
+			 - order + 1;
+		if (!bywday_has(rpt, lt_occur.tm_wday, order, rorder))
 			return 0;
 	}
 
 	/* BYMONTH reduction */
-	mon = lt_occur.tm_mon + 1;
 	if (rpt->bymonth.head &&
 	    rpt->type != RECUR_YEARLY &&
-	    !LLIST_FIND_FIRST(&rpt->bymonth, &mon, int_cmp))
+	    !bymonth_has(rpt, lt_occur.tm_mon + 1))
 		return 0;
 
 	/* Exception day? */
-	if (exc && LLIST_FIND_FIRST(exc, &t, exc_inday))
+	if (exc && exc_inday(exc, t))
 		return 0;
 
 	/* Extraneous day? */
@@ -1034,7 +1132,7 @@ static int find_occurrence(time_t start, long dur, struct rpt *rpt, llist_t *exc
  * Return true if the rrule (s, d, r, e) has an occurrence, depending
  * on the frequency, in the year, month or week of day.
  */
-static int freq_chk(time_t day, time_t s, long d, struct rpt *r, llist_t *e)
+static int freq_chk(time_t day, time_t s, long d, struct rpt *r, exc_list_t *e)
 {
 	if (r->type == RECUR_DAILY)
 		EXIT(_("no daily frequency check"));
@@ -1043,8 +1141,8 @@ static int freq_chk(time_t day, time_t s, long d, struct rpt *r, llist_t *e)
 	struct rpt fc_rpt;
 	time_t fc_day, fc_s;
 
-	localtime_r(&s, &tm_start);
-	localtime_r(&day, &tm_day);
+	date_localtime(&s, &tm_start);
+	date_localtime(&day, &tm_day);
 
 	if (r->type == RECUR_WEEKLY) {
 		/* Set day to the weekly occurrence. */
@@ -1060,13 +1158,14 @@ static int freq_chk(time_t day, time_t s, long d, struct rpt *r, llist_t *e)
 		if (r->type == RECUR_YEARLY)
 			tm_day.tm_mon = tm_start.tm_mon;
 		tm_day.tm_isdst = tm_start.tm_isdst = -1;
-		fc_day = mktime(&tm_day);
-		fc_s = mktime(&tm_start);
+		fc_day = date_mktime(&tm_day);
+		fc_s = date_mktime(&tm_start);
 	}
 	/* Turn all reductions off. */
 	fc_rpt = *r;
 	fc_rpt.until = 0;
 	fc_rpt.bymonth.head = fc_rpt.bywday.head = fc_rpt.bymonthday.head = NULL;
+	recur_rpt_compile(&fc_rpt);
 
 	return find_occurrence(fc_s, d, &fc_rpt, e, fc_day, NULL);
 }
@@ -1075,7 +1174,7 @@ static int freq_chk(time_t day, time_t s, long d, struct rpt *r, llist_t *e)
  * Return true if the rrule (s, d, r, e) has an occurrence on 'day' after
  * 'first'; if so, return it in occurrence.
  */
-static int test_occurrence(time_t s, long d, struct rpt *r, llist_t *e,
+static int test_occurrence(time_t s, long d, struct rpt *r, exc_list_t *e,
 			   time_t first, time_t day, time_t *occurrence)
 {
 	time_t occ;
@@ -1091,7 +1190,7 @@ static int test_occurrence(time_t s, long d, struct rpt *r, llist_t *e,
 }
 
 #define NO_EXPANSION	-1
-static int expand_weekly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
+static int expand_weekly(time_t start, long dur, struct rpt *rpt, exc_list_t *exc,
 			   time_t day, time_t *occurrence)
 {
 	struct tm tm_start;
@@ -1099,7 +1198,7 @@ static int expand_weekly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 	int *w;
 	time_t w_start;
 
-	localtime_r(&start, &tm_start);
+	date_localtime(&start, &tm_start);
 
 	/* BYDAY expansion */
 	if (rpt->bywday.head) {
@@ -1127,7 +1226,7 @@ static int expand_weekly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 	return 0;
 }
 
-static int expand_monthly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
+static int expand_monthly(time_t start, long dur, struct rpt *rpt, exc_list_t *exc,
 			   time_t day, time_t *occurrence)
 {
 	struct tm tm_start, tm_day;
@@ -1136,7 +1235,7 @@ static int expand_monthly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 	time_t nstart;
 	struct rpt r = *rpt;
 
-	localtime_r(&day, &tm_day);
+	date_localtime(&day, &tm_day);
 
 	/*
 	 * The following three conditional alternatives are mutually exclusive
@@ -1157,24 +1256,24 @@ static int expand_monthly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 			 * the month is changed to an earlier one matching the
 			 * frequency.
 			 */
-			localtime_r(&start, &tm_start);
+			date_localtime(&start, &tm_start);
 			mon = tm_start.tm_mon;
 
 			tm_start.tm_mday = mday;
 			tm_start.tm_isdst = -1;
-			nstart = mktime(&tm_start);
+			nstart = date_mktime(&tm_start);
 			valid = date_chk(nstart, mon, mday);
 			/* Never valid? */
 			if (!valid && !(rpt->freq % 12))
 				return 0;
 			/* Note. The loop will terminate! */
 			while (!valid) {
-				localtime_r(&start, &tm_start);
+				date_localtime(&start, &tm_start);
 				mon -= rpt->freq;
 				tm_start.tm_mon = mon;
 				tm_start.tm_mday = mday;
 				tm_start.tm_isdst = -1;
-				nstart = mktime(&tm_start);
+				nstart = date_mktime(&tm_start);
 				valid = date_chk(nstart, (mon + 12) % 12, mday);
 			}
 			if (test_occurrence(nstart, dur, rpt, exc,
@@ -1193,7 +1292,7 @@ static int expand_monthly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 
 			int order, wday, nbwd;
 
-			localtime_r(&start, &tm_start);
+			date_localtime(&start, &tm_start);
 			/*
 			 * Construct a weekly rrule; BYMONTH-reduction in
 			 * find_occurrence() will reduce to the bymonth list.
@@ -1218,7 +1317,7 @@ static int expand_monthly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 				tm_start.tm_isdst = -1;
 				/* Start in the week before the month. */
 				nstart = date_sec_change(
-					next_wday(mktime(&tm_start), wday),
+					next_wday(date_mktime(&tm_start), wday),
 					0,
 					-WEEKINDAYS
 				);
@@ -1252,7 +1351,7 @@ static int expand_monthly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 				tm_start.tm_year = tm_day.tm_year;
 				tm_start.tm_isdst = -1;
 				nstart = date_sec_change(
-					next_wday(mktime(&tm_start), wday),
+					next_wday(date_mktime(&tm_start), wday),
 					0,
 					-WEEKINDAYS
 				);
@@ -1278,7 +1377,7 @@ static int expand_monthly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 	return 0;
 }
 
-static int expand_yearly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
+static int expand_yearly(time_t start, long dur, struct rpt *rpt, exc_list_t *exc,
 			   time_t day, time_t *occurrence)
 {
 	struct tm tm_start, tm_day;
@@ -1287,7 +1386,7 @@ static int expand_yearly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 	time_t nstart;
 	struct rpt r;
 
-	localtime_r(&day, &tm_day);
+	date_localtime(&day, &tm_day);
 	/*
 	 * The following five conditional alternatives are mutually exclusive
 	 * and cover all eight cases of three booleans.
@@ -1298,10 +1397,10 @@ static int expand_yearly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 			m = LLIST_GET_DATA(i);
 
 			/* Modify rrule start with new month. */
-			localtime_r(&start, &tm_start);
+			date_localtime(&start, &tm_start);
 			tm_start.tm_mon = *m - 1;
 			tm_start.tm_isdst = -1;
-			nstart = mktime(&tm_start);
+			nstart = date_mktime(&tm_start);
 			if (!date_chk(nstart, *m - 1, tm_start.tm_mday))
 				continue;
 			if (find_occurrence(nstart, dur, rpt, exc, day,
@@ -1318,7 +1417,7 @@ static int expand_yearly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 		LLIST_FOREACH(&rpt->bywday, i) {
 			w = LLIST_GET_DATA(i);
 
-			localtime_r(&start, &tm_start);
+			date_localtime(&start, &tm_start);
 			/*
 			 * Construct a suitable weekly rrule. BYMONTH
 			 * reduction in find_occurrence() will limit
@@ -1358,7 +1457,7 @@ static int expand_yearly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 				tm_start.tm_year = tm_day.tm_year;
 				tm_start.tm_isdst = -1;
 				nstart = date_sec_change(
-					next_wday(mktime(&tm_start), wday),
+					next_wday(date_mktime(&tm_start), wday),
 					0,
 					-WEEKINDAYS
 				);
@@ -1403,7 +1502,7 @@ static int expand_yearly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 				tm_start.tm_year = tm_day.tm_year;
 				tm_start.tm_isdst = -1;
 				nstart = date_sec_change(
-					next_wday(mktime(&tm_start), wday),
+					next_wday(date_mktime(&tm_start), wday),
 					0,
 					-WEEKINDAYS
 				);
@@ -1432,10 +1531,10 @@ static int expand_yearly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 					   tm_day.tm_mon + 1, mday
 				       );
 			/* Modify rrule start with new monthday. */
-			localtime_r(&start, &tm_start);
+			date_localtime(&start, &tm_start);
 			tm_start.tm_mday = mday;
 			tm_start.tm_isdst = -1;
-			nstart = mktime(&tm_start);
+			nstart = date_mktime(&tm_start);
 			if (!date_chk(nstart, tm_start.tm_mon, mday))
 				continue;
 			if (find_occurrence(nstart, dur, rpt, exc, day,
@@ -1456,7 +1555,7 @@ static int expand_yearly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 						   tm_day.tm_mon + 1, mday
 					       );
 				/* Modify start with new monthday and month. */
-				localtime_r(&start, &tm_start);
+				date_localtime(&start, &tm_start);
 				/* Number of days in February! */
 				if (*m == 2 && mday == 29 &&
 				    !ISLEAP(tm_start.tm_year + 1900) &&
@@ -1468,7 +1567,7 @@ static int expand_yearly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
 				tm_start.tm_mday = mday;
 				tm_start.tm_mon = *m - 1;
 				tm_start.tm_isdst = -1;
-				nstart = mktime(&tm_start);
+				nstart = date_mktime(&tm_start);
 				if (!date_chk(nstart, *m - 1, mday))
 					continue;
 				if (find_occurrence(nstart, dur, rpt, exc, day,
@@ -1498,7 +1597,7 @@ static int expand_yearly(time_t start, long dur, struct rpt *rpt, llist_t *exc,
  * find_occurrence(), possibly with change of type, frequency and start.
  */
 unsigned
-recur_item_find_occurrence(time_t start, long dur, struct rpt *rpt, llist_t *exc,
+recur_item_find_occurrence(time_t start, long dur, struct rpt *rpt, exc_list_t *exc,
 			   time_t day, time_t *occurrence)
 {
 	int res;
@@ -1552,7 +1651,7 @@ recur_event_find_occurrence(struct recur_event *rev, time_t day_start,
 /* Check if a recurrent item belongs to the selected day. */
 unsigned
 recur_item_inday(time_t start, long dur,
-		 struct rpt *rpt, llist_t * exc,
+		 struct rpt *rpt, exc_list_t *exc,
 		 time_t day_start)
 {
 	/* We do not need the (real) start time of the occurrence here, so just
@@ -1577,6 +1676,7 @@ unsigned recur_event_inday(struct recur_event *rev, time_t *day_start)
 void recur_event_add_exc(struct recur_event *rev, time_t date)
 {
 	recur_add_exc(&rev->exc, date);
+	rev->digest.valid = 0;
 }
 
 /* Add an exception to a recurrent appointment. */
@@ -1587,6 +1687,8 @@ void recur_apoint_add_exc(struct recur_apoint *rapt, time_t date)
 	if (notify_bar())
 		need_check_notify = notify_same_recur_item(rapt);
 	recur_add_exc(&rapt->exc, date);
+	rapt->digest.valid = 0;
+	notify_queue_recur(rapt);
 	if (need_check_notify)
 		notify_check_next_app(0);
 }
@@ -1622,98 +1724,98 @@ void recur_apoint_erase(struct recur_apoint *rapt)
 	if (notify_bar())
 		need_check_notify = notify_same_recur_item(rapt);
 	LLIST_TS_REMOVE(&recur_alist_p, i);
+	notify_queue_remove(rapt);
 	if (need_check_notify)
 		notify_check_next_app(0);
 
 	LLIST_TS_UNLOCK(&recur_alist_p);
 }
 
-/* Read monthday list. */
-void recur_bymonthday(llist_t *l, FILE *data_file)
+/* Read monthday list. Return an error message on syntax error. */
+char *recur_bymonthday(llist_t *l, char **s)
 {
-	int c = 0, d;
+	int d;
 
 	LLIST_INIT(l);
-	while ((c = getc(data_file)) == 'd') {
-		ungetc(c, data_file);
-		if (fscanf(data_file, "d%d ", &d) != 1)
-			EXIT(_("syntax error in bymonthday"));
+	while (**s == 'd') {
+		(*s)++;
+		if (!scan_int(s, &d))
+			return _("syntax error in bymonthday");
+		scan_blank(s);
 		int *i = mem_malloc(sizeof(int));
 		*i = d;
 		LLIST_ADD(l, i);
 	}
-	ungetc(c, data_file);
+	return NULL;
 }
 
-/* Read weekday list. */
-void recur_bywday(enum recur_type type, llist_t *l, FILE *data_file)
+/* Read weekday list. Return an error message on syntax error. */
+char *recur_bywday(enum recur_type type, llist_t *l, char **s)
 {
-	int c = 0, w;
+	int w;
 
 	type = !(type == RECUR_MONTHLY || type == RECUR_YEARLY);
 
 	LLIST_INIT(l);
-	while ((c = getc(data_file)) == 'w') {
-		ungetc(c, data_file);
-		if (fscanf(data_file, "w%d ", &w) != 1)
-			EXIT(_("syntax error in bywday"));
+	while (**s == 'w') {
+		(*s)++;
+		if (!scan_int(s, &w))
+			return _("syntax error in bywday");
+		scan_blank(s);
 		if (type && (w < 0 || w > 6))
-			EXIT(_("illegal BYDAY value"));
+			return _("illegal BYDAY value");
 		int *i = mem_malloc(sizeof(int));
 		*i = w;
 		LLIST_ADD(l, i);
 	}
-	ungetc(c, data_file);
+	return NULL;
 }
 
-/* Read month list. */
-void recur_bymonth(llist_t *l, FILE *data_file)
+/* Read month list. Return an error message on syntax error. */
+char *recur_bymonth(llist_t *l, char **s)
 {
-	int c = 0, m;
+	int m;
 
 	LLIST_INIT(l);
-	while ((c = getc(data_file)) == 'm') {
-		ungetc(c, data_file);
-		if (fscanf(data_file, "m%d ", &m) != 1)
-			EXIT(_("syntax error in bymonth"));
-		EXIT_IF(m < 1 || m > 12, _("illegal bymonth value"));
+	while (**s == 'm') {
+		(*s)++;
+		if (!scan_int(s, &m))
+			return _("syntax error in bymonth");
+		scan_blank(s);
+		if (m < 1 || m > 12)
+			return _("illegal bymonth value");
 		int *i = mem_malloc(sizeof(int));
 		*i = m;
 		LLIST_ADD(l, i);
 	}
-	ungetc(c, data_file);
+	return NULL;
 }
 
 /*
  * Read days for which recurrent items must not be repeated
- * (such days are called exceptions).
+ * (such days are called exceptions). Return an error message on syntax error.
  */
-void recur_exc_scan(llist_t * lexc, FILE * data_file)
+char *recur_exc_scan(exc_list_t *exc, char **s)
 {
-	int c = 0;
 	struct tm day;
 
-	LLIST_INIT(lexc);
-	while ((c = getc(data_file)) == '!') {
-		ungetc(c, data_file);
-		if (fscanf(data_file, "!%d / %d / %d ",
-			   &day.tm_mon, &day.tm_mday, &day.tm_year) != 3) {
-			EXIT(_("syntax error in item date"));
-		}
+	recur_exc_init(exc);
+	while (**s == '!') {
+		(*s)++;
+		if (!scan_date(s, &day.tm_mon, &day.tm_mday, &day.tm_year))
+			return _("syntax error in item date");
 
-		EXIT_IF(!check_date(day.tm_year, day.tm_mon, day.tm_mday),
-			_("date error in item exception"));
+		if (!check_date(day.tm_year, day.tm_mon, day.tm_mday))
+			return _("date error in item exception");
 
 		day.tm_hour = 0;
 		day.tm_min = day.tm_sec = 0;
 		day.tm_isdst = -1;
 		day.tm_year -= 1900;
 		day.tm_mon--;
-		struct excp *exc = mem_malloc(sizeof(struct excp));
-		exc->st = mktime(&day);
-		LLIST_ADD(lexc, exc);
+		exc_insert(exc, date_mktime(&day));
 	}
-	ungetc(c, data_file);
+	return NULL;
 }
 
 /*
@@ -1726,7 +1828,7 @@ void recur_apoint_check_next(struct notify_app *app, time_t start, time_t day)
 	llist_item_t *i;
 	time_t real_recur_start_time;
 
-	LLIST_TS_LOCK(&recur_alist_p);
+	LLIST_TS_RDLOCK(&recur_alist_p);
 	LLIST_TS_FOREACH(&recur_alist_p, i) {
 		struct recur_apoint *rapt = LLIST_TS_GET_DATA(i);
 
@@ -1760,6 +1862,7 @@ void recur_apoint_switch_notify(struct recur_apoint *rapt)
 	LLIST_TS_LOCK(&recur_alist_p);
 
 	rapt->state ^= APOINT_NOTIFY;
+	rapt->digest.valid = 0;
 	if (notify_bar())
 		notify_check_repeated(rapt);
 
@@ -1769,7 +1872,7 @@ void recur_apoint_switch_notify(struct recur_apoint *rapt)
 void recur_event_paste_item(struct recur_event *rev, time_t date)
 {
 	long time_shift;
-	llist_item_t *i;
+	unsigned i;
 
 	time_shift = date - rev->day;
 	rev->day += time_shift;
@@ -1777,10 +1880,9 @@ void recur_event_paste_item(struct recur_event *rev, time_t date)
 	if (rev->rpt->until != 0)
 		rev->rpt->until += time_shift;
 
-	LLIST_FOREACH(&rev->exc, i) {
-		struct excp *exc = LLIST_GET_DATA(i);
-		exc->st += time_shift;
-	}
+	for (i = 0; i < rev->exc.count; i++)
+		rev->exc.st[i] = DAY(rev->exc.st[i] + time_shift);
+	rev->digest.valid = 0;
 
 	LLIST_ADD_SORTED(&recur_elist, rev, recur_event_cmp);
 }
@@ -1789,10 +1891,10 @@ void recur_apoint_paste_item(struct recur_apoint *rapt, time_t date)
 {
 	time_t ostart = rapt->start;
 	int days;
-	llist_item_t *i;
+	unsigned i;
 	struct tm t;
 
-	localtime_r((time_t *)&rapt->start, &t);
+	date_localtime((time_t *)&rapt->start, &t);
 	rapt->start = update_time_in_date(date, t.tm_hour, t.tm_min);
 
 	/* The number of days shifted. */
@@ -1801,10 +1903,9 @@ void recur_apoint_paste_item(struct recur_apoint *rapt, time_t date)
 	if (rapt->rpt->until != 0)
 		rapt->rpt->until = date_sec_change(rapt->rpt->until, 0, days);
 
-	LLIST_FOREACH(&rapt->exc, i) {
-		struct excp *exc = LLIST_GET_DATA(i);
-		exc->st = date_sec_change(exc->st, 0, days);
-	}
+	for (i = 0; i < rapt->exc.count; i++)
+		rapt->exc.st[i] = date_sec_change(rapt->exc.st[i], 0, days);
+	rapt->digest.valid = 0;
 
 	LLIST_TS_LOCK(&recur_alist_p);
 	LLIST_TS_ADD_SORTED(&recur_alist_p, rapt, recur_apoint_cmp);
@@ -1814,74 +1915,332 @@ void recur_apoint_paste_item(struct recur_apoint *rapt, time_t date)
 		notify_check_repeated(rapt);
 }
 
+/*
+ * Return the end of the last day for which occurrences are searched when a
+ * recurrence rule has no until day.
+ */
+static time_t occurrence_horizon(void)
+{
+	struct tm tm;
+
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = (YEAR1902_2037 ? 2037 : 9999) - 1900;
+	tm.tm_mon = 11;
+	tm.tm_mday = 31;
+	tm.tm_hour = 23;
+	tm.tm_min = 59;
+	tm.tm_sec = 59;
+	tm.tm_isdst = -1;
+	return date_mktime(&tm);
+}
+
+/* Bookkeeping for the occurrence searches below. */
+struct occurrence_search {
+	time_t after;		/* occurrences must start after this time */
+	time_t before;		/* occurrences must start before this time */
+	int n;			/* number of occurrences still to be found */
+	time_t *found;
+};
+
+/* Stop at the n-th occurrence in the window of the search. */
+static int occurrence_search_next(time_t occ, void *data)
+{
+	struct occurrence_search *os = data;
+
+	if (occ < os->after)
+		return 0;
+	*os->found = occ;
+	return --os->n <= 0;
+}
+
+/* Remember the latest occurrence in the window of the search. */
+static int occurrence_search_prev(time_t occ, void *data)
+{
+	struct occurrence_search *os = data;
+
+	if (occ >= os->before)
+		return 1;
+	*os->found = occ;
+	os->n = 0;
+	return 0;
+}
+
 /*
  * Finds the next occurrence of a recurrent item and returns it in the provided
  * buffer. Useful for test of a repeated item.
+ *
+ * The candidate days are generated by recur_item_occurrences(), which jumps
+ * over days, weeks, months and years that cannot contain an occurrence.
  */
-int recur_next_occurrence(time_t s, long d, struct rpt *r, llist_t *e,
+int recur_next_occurrence(time_t s, long d, struct rpt *r, exc_list_t *e,
 			  time_t day, time_t *next)
 {
-	int ret = 0;
+	struct occurrence_search os;
 
 	if (r->until && r->until <= day)
-		return ret;
+		return 0;
 
-	while (!r->until || day < r->until) {
-		day = NEXTDAY(day);
-		if (!check_sec(&day))
-			break;
-		if (recur_item_find_occurrence(s, d, r, e, day, next)) {
-			/* Multi-day appointment. */
-			if (*next < day)
-				continue;
-			ret = 1;
-			break;
-		}
-	}
-	return ret;
+	os.after = NEXTDAY(day);
+	os.n = 1;
+	os.found = next;
+	recur_item_occurrences(s, d, r, e, os.after, occurrence_horizon(),
+			       occurrence_search_next, &os);
+
+	return os.n == 0;
 }
 
 /*
  * Finds the nth occurrence (incl. start)  of a recurrence rule (s, d, r, e)
  * and returns it in the provided buffer.
  */
-int recur_nth_occurrence(time_t s, long d, struct rpt *r, llist_t *e, int n,
+int recur_nth_occurrence(time_t s, long d, struct rpt *r, exc_list_t *e, int n,
 			 time_t *nth)
 {
-	time_t day;
+	struct occurrence_search os;
 
 	if (n <= 0)
 		return 0;
 
-	for (n--, *nth = s; n > 0; n--) {
-		day = DAY(*nth);
-		if (!recur_next_occurrence(s, d, r, e, day, nth))
-			break;
-	}
-	return !n;
+	*nth = s;
+	if (n == 1)
+		return 1;
+	if (r->until && r->until <= DAY(s))
+		return 0;
+
+	/* The start counts as the first occurrence, even if it is excluded. */
+	os.after = NEXTDAY(DAY(s));
+	os.n = n - 1;
+	os.found = nth;
+	recur_item_occurrences(s, d, r, e, os.after, occurrence_horizon(),
+			       occurrence_search_next, &os);
+
+	return os.n == 0;
 }
 
 /*
  * Finds the previous occurrence - the most recent before day - and returns it
  * in the provided buffer.
+ *
+ * Windows of growing length are searched backwards from day.
  */
-int recur_prev_occurrence(time_t s, long d, struct rpt *r, llist_t *e,
+int recur_prev_occurrence(time_t s, long d, struct rpt *r, exc_list_t *e,
 			  time_t day, time_t *prev)
 {
-	int ret = 0;
+	struct occurrence_search os;
+	time_t first = DAY(s), from;
+	int len;
 
-	if (day <= DAY(s))
-		return ret;
+	if (day <= first)
+		return 0;
 
-	while (DAY(s) < day) {
-		day = PREVDAY(day);
-		if (recur_item_find_occurrence(s, d, r, e, day, prev)) {
-			/* Multi-day appointment. */
-			if (d != -1 && *prev < day && day < *prev + d)
-				continue;
-			ret = 1;
-			break;
+	os.before = day;
+	os.n = 1;
+	os.found = prev;
+	for (len = WEEKINDAYS; os.n && os.before > first; len *= 2) {
+		from = date_sec_change(os.before, 0, -len);
+		if (from < first)
+			from = first;
+		recur_item_occurrences(s, d, r, e, from, os.before - 1,
+				       occurrence_search_prev, &os);
+		os.before = from;
+	}
+
+	return os.n == 0;
+}
+
+/*
+ * Return the last day that may be skipped when looking for the month day mday
+ * from the day with number dn and date t.
+ */
+static long skip_to_mday(struct tm *t, long dn, int mday)
+{
+	int mon = t->tm_mon + 1;
+
+	if (t->tm_mday < mday)
+		return dn + mday - t->tm_mday - 1;
+	return days_from_civil(t->tm_year + 1900 + mon / YEARINMONTHS,
+			       mon % YEARINMONTHS + 1, 1) - 1;
+}
+
+/*
+ * Cheap necessary conditions for an occurrence of the rrule (start, rpt) on
+ * the day with number dn (see days_from_civil()) and date t. If the day is
+ * ruled out together with the rest of its week, month or year, the number of
+ * the last day that may be skipped is returned in skip.
+ */
+static int occurrence_candidate(struct rpt *rpt, struct tm *s, long sdn,
+				long dn, struct tm *t, long *skip)
+{
+	long k, wsdn;
+	int mon, mday;
+
+	*skip = dn;
+
+	switch (rpt->type) {
+	case RECUR_DAILY:
+		k = (dn - sdn) % rpt->freq;
+		if (k) {
+			*skip = dn + rpt->freq - k - 1;
+			return 0;
+		}
+		break;
+	case RECUR_WEEKLY:
+		/* Weeks are counted from the first day of the start week. */
+		wsdn = sdn - WDAY(s->tm_wday);
+		k = (dn - wsdn) / WEEKINDAYS % rpt->freq;
+		if (k) {
+			*skip = wsdn + ((dn - wsdn) / WEEKINDAYS + rpt->freq -
+					k) * WEEKINDAYS - 1;
+			return 0;
+		}
+		if (!rpt->bywday.head && t->tm_wday != s->tm_wday) {
+			*skip = dn + (s->tm_wday - t->tm_wday + WEEKINDAYS) %
+				WEEKINDAYS - 1;
+			return 0;
+		}
+		break;
+	case RECUR_MONTHLY:
+		k = ((t->tm_year - s->tm_year) * YEARINMONTHS + t->tm_mon -
+		     s->tm_mon) % rpt->freq;
+		if (k) {
+			mon = t->tm_mon + rpt->freq - k;
+			*skip = days_from_civil(t->tm_year + 1900 +
+						mon / YEARINMONTHS,
+						mon % YEARINMONTHS + 1, 1) - 1;
+			return 0;
+		}
+		if (!rpt->bymonthday.head && !rpt->bywday.head &&
+		    t->tm_mday != s->tm_mday) {
+			*skip = skip_to_mday(t, dn, s->tm_mday);
+			return 0;
+		}
+		break;
+	case RECUR_YEARLY:
+		k = (t->tm_year - s->tm_year) % rpt->freq;
+		if (k) {
+			*skip = days_from_civil(t->tm_year + 1900 +
+						rpt->freq - k, 1, 1) - 1;
+			return 0;
+		}
+		if (!rpt->bymonth.head &&
+		    (!rpt->bywday.head || rpt->bymonthday.head) &&
+		    t->tm_mon != s->tm_mon) {
+			*skip = days_from_civil(t->tm_year + 1900 +
+						(t->tm_mon > s->tm_mon),
+						s->tm_mon + 1, 1) - 1;
+			return 0;
+		}
+		if (!rpt->bymonthday.head && !rpt->bywday.head &&
+		    t->tm_mday != s->tm_mday) {
+			*skip = skip_to_mday(t, dn, s->tm_mday);
+			return 0;
 		}
+		break;
+	default:
+		EXIT(_("unknown item type"));
 	}
-	return ret;
+
+	/* BYMONTH is a reduction or an expansion restricted to its list. */
+	mon = t->tm_mon + 1;
+	if (rpt->bymonth.head && !bymonth_has(rpt, mon)) {
+		*skip = days_from_civil(t->tm_year + 1900 + mon / YEARINMONTHS,
+					mon % YEARINMONTHS + 1, 1) - 1;
+		return 0;
+	}
+
+	/* Likewise for BYMONTHDAY... */
+	if (rpt->bymonthday.head) {
+		mday = opp_mday(t->tm_year + 1900, t->tm_mon + 1, t->tm_mday);
+		if (!bymonthday_has(rpt, t->tm_mday, mday))
+			return 0;
+	}
+
+	/* ... and BYDAY, whatever the order of the weekday. */
+	if (rpt->bywday.head && !rpt->bywday_pos[t->tm_wday] &&
+	    !rpt->bywday_neg[t->tm_wday])
+		return 0;
+
+	return 1;
+}
+
+/*
+ * Call fn for each occurrence of the rrule (start, dur, rpt, exc) that
+ * overlaps the period [from, to], in chronological order. The iteration stops
+ * when fn returns a non-zero value. Return the number of occurrences passed to
+ * fn.
+ *
+ * The days of the period are walked using integer date arithmetic, and whole
+ * weeks, months or years without an occurrence are skipped. Only the remaining
+ * candidate days are submitted to the membership test.
+ */
+int recur_item_occurrences(time_t start, long dur, struct rpt *rpt,
+			   exc_list_t *exc, time_t from, time_t to,
+			   recur_fn_occurrence_t fn, void *data)
+{
+	struct tm s, t;
+	long sdn, dn, last, skip;
+	time_t day, occ, end;
+	int n = 0, y, m, d;
+
+	if (to < from)
+		return 0;
+
+	date_localtime(&start, &s);
+	sdn = days_from_civil(s.tm_year + 1900, s.tm_mon + 1, s.tm_mday);
+
+	/* Occurrences starting before the period may stretch into it. */
+	date_localtime(&from, &t);
+	dn = days_from_civil(t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+	if (dur > 0)
+		dn -= (dur - 1) / DAYINSEC + 1;
+	if (dn < sdn)
+		dn = sdn;
+
+	date_localtime(&to, &t);
+	last = days_from_civil(t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+	if (rpt->until) {
+		date_localtime(&rpt->until, &t);
+		skip = days_from_civil(t.tm_year + 1900, t.tm_mon + 1,
+				       t.tm_mday);
+		if (skip < last)
+			last = skip;
+	}
+
+	for (; dn <= last; dn++) {
+		civil_from_days(dn, &y, &m, &d);
+		memset(&t, 0, sizeof(t));
+		t.tm_year = y - 1900;
+		t.tm_mon = m - 1;
+		t.tm_mday = d;
+		t.tm_wday = wday_from_days(dn);
+
+		if (!occurrence_candidate(rpt, &s, sdn, dn, &t, &skip)) {
+			dn = skip;
+			continue;
+		}
+
+		t.tm_isdst = -1;
+		day = date_mktime(&t);
+		/* A day skipped by a change of offset has no occurrences. */
+		if (t.tm_mday != d)
+			continue;
+		/* A zero duration restricts the test to occurrences on day. */
+		if (!recur_item_find_occurrence(start, 0, rpt, exc, day, &occ))
+			continue;
+
+		if (dur > 0)
+			end = occ + dur - 1;
+		else if (dur == -1)
+			end = ENDOFDAY(occ);
+		else
+			end = occ;
+		if (occ > to || end < from)
+			continue;
+
+		n++;
+		if (fn(occ, data))
+			break;
+	}
+
+	return n;
 }
@@ -233,23 +233,35 @@ void sha1_final(sha1_ctx_t * ctx, uint8_t digest[SHA1_DIGESTLEN])
 	memset(&finalcount, 0, 8);
 }
 
-void sha1_digest(const char *data, char *buffer)
+/*
+ * Hash a buffer. The data is copied in chunks first, since sha1_update()
+ * scrambles its input.
+ */
+void sha1_buffer(const char *data, size_t len, char *buffer)
 {
-	char *buf = strdup(data);
 	sha1_ctx_t ctx;
+	uint8_t chunk[BUFSIZ];
 	uint8_t digest[SHA1_DIGESTLEN];
+	size_t n;
 	int i;
 
 	sha1_init(&ctx);
-	sha1_update(&ctx, (const uint8_t *)buf, strlen(buf));
+	for (; len > 0; data += n, len -= n) {
+		n = len < BUFSIZ ? len : BUFSIZ;
+		memcpy(chunk, data, n);
+		sha1_update(&ctx, chunk, n);
+	}
 	sha1_final(&ctx, (uint8_t *) digest);
 
 	for (i = 0; i < SHA1_DIGESTLEN; i++) {
 		snprintf(buffer, 3, "%02x", digest[i]);
 		buffer += sizeof(char) * 2;
 	}
+}
 
-	free(buf);
+void sha1_digest(const char *data, char *buffer)
+{
+	sha1_buffer(data, strlen(data), buffer);
 }
 
 void sha1_stream(FILE * fp, char *buffer)
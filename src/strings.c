@@ -35,6 +35,7 @@
  */
 
 #include <stdarg.h>
+#include <string.h>
 
 #include "calcurse.h"
 
@@ -72,6 +73,59 @@ char *string_buf(struct string *sb)
 	return sb->buf;
 }
 
+/* Append a character. */
+void string_catc(struct string *sb, char c)
+{
+	string_grow(sb, sb->len + 2);
+	sb->buf[sb->len++] = c;
+	sb->buf[sb->len] = '\0';
+}
+
+/* Append a null-terminated string. */
+void string_cat(struct string *sb, const char *str)
+{
+	int n = strlen(str);
+
+	string_grow(sb, sb->len + n + 1);
+	memcpy(sb->buf + sb->len, str, n + 1);
+	sb->len += n;
+}
+
+/*
+ * Append a decimal number, padded with zeros to at least width digits. This
+ * is the equivalent of "%0*d" without going through vsnprintf().
+ */
+void string_catnum(struct string *sb, long num, int width)
+{
+	char digits[24];
+	unsigned long u = num < 0 ? -(unsigned long)num : (unsigned long)num;
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + u % 10;
+		u /= 10;
+	} while (u);
+	while (n < width && n < (int)sizeof(digits))
+		digits[n++] = '0';
+	if (num < 0)
+		digits[n++] = '-';
+
+	string_grow(sb, sb->len + n + 1);
+	while (n > 0)
+		sb->buf[sb->len++] = digits[--n];
+	sb->buf[sb->len] = '\0';
+}
+
+/* Append a date in the mm/dd/yyyy format of the data files. */
+void string_catdate(struct string *sb, const struct tm *tm)
+{
+	string_catnum(sb, tm->tm_mon + 1, 2);
+	string_catc(sb, '/');
+	string_catnum(sb, tm->tm_mday, 2);
+	string_catc(sb, '/');
+	string_catnum(sb, 1900 + tm->tm_year, 4);
+}
+
 int string_vcatf(struct string *sb, const char *format, va_list ap)
 {
 	va_list ap2;
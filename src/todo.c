@@ -39,7 +39,6 @@
 #include <unistd.h>
 
 #include "calcurse.h"
-#include "sha1.h"
 
 llist_t todolist;
 
@@ -94,34 +93,79 @@ struct todo *todo_add(char *mesg, int id, int completed, char *note)
 	todo->completed = completed;
 	todo->note = (note != NULL
 		      && note[0] != '\0') ? mem_strdup(note) : NULL;
+	todo->digest.valid = 0;
 
 	LLIST_ADD_SORTED(&todolist, todo, todo_cmp);
 
 	return todo;
 }
 
+/* Append a todo item in the format of the data file. */
+void todo_append(struct string *s, struct todo *todo)
+{
+	string_catc(s, '[');
+	if (todo->completed)
+		string_catc(s, '-');
+	string_catnum(s, todo->id, 0);
+	string_catc(s, ']');
+	if (todo->note) {
+		string_catc(s, '>');
+		string_cat(s, todo->note);
+	}
+	string_catc(s, ' ');
+	string_cat(s, todo->mesg);
+}
+
 char *todo_tostr(struct todo *todo)
 {
-	char *res;
-	const char *cstr = todo->completed ? "-" : "";
+	struct string s;
 
-	if (todo->note)
-		asprintf(&res, "[%s%d]>%s %s", cstr, todo->id, todo->note,
-			 todo->mesg);
-	else
-		asprintf(&res, "[%s%d] %s", cstr, todo->id, todo->mesg);
+	string_init(&s);
+	todo_append(&s, todo);
 
-	return res;
+	return string_buf(&s);
+}
+
+/* Return the digest of a todo item, computing it on first use. */
+static struct item_digest *todo_digest(struct todo *todo)
+{
+	if (!todo->digest.valid) {
+		char *raw = todo_tostr(todo);
+		item_digest_compute(&todo->digest, raw);
+	}
+
+	return &todo->digest;
 }
 
 char *todo_hash(struct todo *todo)
 {
-	char *raw = todo_tostr(todo);
-	char *sha1 = mem_malloc(SHA1_DIGESTLEN * 2 + 1);
-	sha1_digest(raw, sha1);
-	mem_free(raw);
+	return item_digest_hex(todo_digest(todo));
+}
+
+/* Check whether a todo item is selected by a filter. */
+static int todo_filter_match(struct todo *todo, struct item_filter *filter)
+{
+	int cond;
+
+	cond = (
+	    !(filter->type_mask & TYPE_MASK_TODO) ||
+	    (filter->regex && regexec(filter->regex, todo->mesg, 0, 0, 0)) ||
+	    (filter->priority && todo->id != filter->priority) ||
+	    (filter->completed && !todo->completed) ||
+	    (filter->uncompleted && todo->completed)
+	);
+	if (filter->hash) {
+		cond = cond ||
+		    !item_digest_matches(filter->hash, todo_digest(todo));
+	}
+
+	return filter->invert ? cond : !cond;
+}
 
-	return sha1;
+/* Drop the todo items that are not selected by a filter. */
+void todo_llist_filter(struct item_filter *filter)
+{
+	LLIST_FILTER(&todolist, filter, todo_filter_match, todo_free);
 }
 
 void todo_write(struct todo *todo, FILE * f)
@@ -137,6 +181,7 @@ void todo_delete_note(struct todo *todo)
 	if (!todo->note)
 		EXIT(_("no note attached"));
 	erase_note(&todo->note);
+	todo->digest.valid = 0;
 }
 
 /* Delete an item from the todo linked list. */
@@ -165,6 +210,7 @@ void todo_resort(struct todo *t)
 void todo_flag(struct todo *t)
 {
 	t->completed = !t->completed;
+	t->digest.valid = 0;
 	todo_resort(t);
 }
 
@@ -198,6 +244,7 @@ int todo_get_position(struct todo *needle, int skip_completed)
 void todo_edit_note(struct todo *i, const char *editor)
 {
 	edit_note(&i->note, editor);
+	i->digest.valid = 0;
 }
 
 /* View a note previously attached to a todo */
@@ -54,11 +54,6 @@ static void draw_weekly_view(struct scrollwin *, struct date *);
 static void (*draw_calendar[CAL_VIEWS]) (struct scrollwin *,
 		struct date *) = {draw_monthly_view, draw_weekly_view};
 
-/* Six weeks cover a month. */
-static int monthly_view_cache[WEEKINDAYS * 6];
-static int monthly_view_cache_valid = 0;
-static int monthly_view_cache_month = 0;
-
 /* Switch between calendar views (monthly view is selected by default). */
 void ui_calendar_view_next(void)
 {
@@ -210,11 +205,6 @@ void ui_calendar_set_slctd_day(struct date day)
 	slctd_day = day;
 }
 
-void ui_calendar_monthly_view_cache_set_invalid(void)
-{
-	monthly_view_cache_valid = 0;
-}
-
 static int weeknum(const struct tm *t, int wday_start)
 {
 	int wday, wnum;
@@ -336,7 +326,7 @@ draw_monthly_view(struct scrollwin *sw, struct date *current_day)
 {
 	struct date c_day;
 	int slctd, w_day, numdays, j, week = 0;
-	unsigned yr, mo;
+	unsigned mo;
 	int w, monthw, weekw, dayw, ofs_x, ofs_y;
 	struct tm t, t_first;
 	char *cp;
@@ -367,7 +357,6 @@ draw_monthly_view(struct scrollwin *sw, struct date *current_day)
 		last_day += WEEKINDAYS;
 
 	mo = slctd_day.mm;
-	yr = slctd_day.yyyy;
 
 	/* a week column plus seven day columns */
 	weekw = 3;
@@ -379,12 +368,6 @@ draw_monthly_view(struct scrollwin *sw, struct date *current_day)
 	ofs_y = 0;
 	ofs_x = (w - monthw) / 2 + ((w - monthw) % 2);
 
-	/* invalidate cache if a new month is selected */
-	if (yr * YEARINMONTHS + mo != monthly_view_cache_month) {
-		monthly_view_cache_month = yr * YEARINMONTHS + mo;
-		monthly_view_cache_valid = 0;
-	}
-
 	WINS_CALENDAR_LOCK;
 	/* Print the day number. */
 	t = date2tm(slctd_day, 0, 0);
@@ -446,12 +429,7 @@ draw_monthly_view(struct scrollwin *sw, struct date *current_day)
 		bc = slctd ? ']' : ' ';
 
 		/* check if the day contains an event or an appointment */
-		if (monthly_view_cache_valid) {
-			day_attr = monthly_view_cache[j];
-		} else {
-			day_attr = monthly_view_cache[j] =
-			    day_check_if_item(c_day);
-		}
+		day_attr = day_check_if_item(c_day);
 
 		/* Set day colours. */
 		if (date_cmp(&c_day, current_day) == 0)
@@ -484,7 +462,6 @@ draw_monthly_view(struct scrollwin *sw, struct date *current_day)
 		}
 		WINS_CALENDAR_UNLOCK;
 	}
-	monthly_view_cache_valid = 1;
 }
 
 /* Draw the weekly view inside calendar panel. */
@@ -288,11 +288,11 @@ static void update_desc(char **desc)
 }
 
 /* Edit a list of exception days for a recurrent item. */
-static int edit_exc(llist_t *exc)
+static int edit_exc(exc_list_t *exc)
 {
 	int updated = 0;
 
-	if (!exc->head)
+	if (!exc->count)
 		return !updated;
 	char *days;
 	enum getstr ret;
@@ -654,8 +654,8 @@ static int edit_ilist(llist_t *ilist, int_list_t list_type, int rule_type)
 	return updated;
 }
 
-static int update_rept(time_t start, long dur, struct rpt **rpt, llist_t *exc,
-			int simple)
+static int update_rept(time_t start, long dur, struct rpt **rpt,
+		       exc_list_t *exc, int simple)
 {
 	int updated = 0, count;
 	struct rpt nrpt;
@@ -666,10 +666,11 @@ static int update_rept(time_t start, long dur, struct rpt **rpt, llist_t *exc,
 	char *outstr = NULL;
 	const char *msg_cont = _("Press any key to continue.");
 
-	LLIST_INIT(&nrpt.exc);
+	recur_exc_init(&nrpt.exc);
 	LLIST_INIT(&nrpt.bywday);
 	LLIST_INIT(&nrpt.bymonth);
 	LLIST_INIT(&nrpt.bymonthday);
+	recur_rpt_compile(&nrpt);
 
 	/* Edit repetition type. */
 	const char *msg_prefix = _("Base period:");
@@ -871,6 +872,8 @@ static int update_rept(time_t start, long dur, struct rpt **rpt, llist_t *exc,
 			goto cleanup;
 	}
 
+	recur_rpt_compile(&nrpt);
+
 	/* The new until may no longer be valid. */
 	if (count) {
 		nrpt.until = 0;
@@ -916,6 +919,7 @@ static int update_rept(time_t start, long dur, struct rpt **rpt, llist_t *exc,
 
 	recur_free_int_list(&(*rpt)->bymonthday);
 	recur_int_list_dup(&(*rpt)->bymonthday, &nrpt.bymonthday);
+	recur_rpt_compile(*rpt);
 
 	updated = 1;
 cleanup:
@@ -940,11 +944,14 @@ void ui_day_item_edit(void)
 	struct recur_apoint *ra;
 	struct apoint *a;
 	int need_check_notify = 0;
+	char *hash;
 
 	if (day_item_count(0) <= 0)
 		return;
 
 	struct day_item *p = ui_day_get_sel();
+	day_occupancy_touch(p);
+	hash = day_item_hash(p);
 
 	switch (p->type) {
 	case RECUR_EVNT:
@@ -962,6 +969,7 @@ void ui_day_item_edit(void)
 			update_rept(re->day, -1, &re->rpt, &re->exc, ADVANCED);
 			break;
 		default:
+			mem_free(hash);
 			return;
 		}
 		break;
@@ -1003,6 +1011,7 @@ void ui_day_item_edit(void)
 			update_start_time(&ra->start, &ra->dur, ra->rpt, 1);
 			break;
 		default:
+			mem_free(hash);
 			return;
 		}
 		break;
@@ -1034,15 +1043,24 @@ void ui_day_item_edit(void)
 			update_start_time(&a->start, &a->dur, NULL, 1);
 			break;
 		default:
+			mem_free(hash);
 			return;
 		}
+		apoint_reorder(a);
 		break;
 	default:
 		break;
 	}
+	day_item_forget_hash(p);
+	io_journal_update(hash, p);
+	mem_free(hash);
 	io_set_modified();
-	ui_calendar_monthly_view_cache_set_invalid();
+	day_occupancy_touch(p);
 
+	if (p->type == RECUR_APPT)
+		notify_queue_recur(p->item.rapt);
+	else if (p->type == APPT)
+		notify_queue_apoint(p->item.apt);
 	if (need_check_notify)
 		notify_check_next_app(1);
 }
@@ -1204,7 +1222,7 @@ void ui_day_item_add(void)
 		if (is_appointment) {
 			item.apt = apoint_new(item_mesg, 0L, start, dur, 0L);
 			if (notify_bar())
-				notify_check_added(item_mesg, start, 0L);
+				notify_check_added(item.apt);
 		} else {
 			item.ev = event_new(item_mesg, 0L, start, 1);
 		}
@@ -1214,10 +1232,11 @@ void ui_day_item_add(void)
 		d.order = start;
 		d.item = item;
 		day_set_sel_data(&d);
+		d.type = is_appointment ? APPT : EVNT;
+		io_journal_update(NULL, &d);
+		day_occupancy_touch(&d);
 	}
 
-	ui_calendar_monthly_view_cache_set_invalid();
-
 	wins_erase_status_bar();
 }
 
@@ -1225,6 +1244,7 @@ void ui_day_item_add(void)
 void ui_day_item_delete(unsigned reg)
 {
 	const char *msg, *choices;
+	char *hash;
 	int nb_choices;
 
 	time_t occurrence;
@@ -1274,6 +1294,8 @@ void ui_day_item_delete(unsigned reg)
 	if (!is_recur && answer == 1)
 		answer = 2;
 
+	day_occupancy_touch(p);
+	hash = day_item_hash(p);
 	switch (answer) {
 	case 1:
 		/* Delete selected occurrence (of a recurrent item) only. */
@@ -1285,26 +1307,30 @@ void ui_day_item_delete(unsigned reg)
 						     &occurrence);
 			day_item_add_exc(p, occurrence);
 		}
+		io_journal_update(hash, p);
 		/* Keep the selection on the same day. */
 		day_set_sel_data(day_get_item(listbox_get_sel(&lb_apt) - 1));
 		break;
 	case 2:
 		/* Delete all occurrences (or a non-recurrent item). */
 		ui_day_item_cut(reg);
+		io_journal_update(hash, NULL);
 		/* Keep the selection on the same day. */
 		day_set_sel_data(day_get_item(listbox_get_sel(&lb_apt) - 1));
 		break;
 	case 3:
 		/* Delete note. */
 		day_item_erase_note(p);
+		io_journal_update(hash, p);
 		break;
 	default:
 		/* User escaped, do nothing. */
+		mem_free(hash);
 		return;
 	}
 
+	mem_free(hash);
 	io_set_modified();
-	ui_calendar_monthly_view_cache_set_invalid();
 }
 
 /*
@@ -1320,6 +1346,7 @@ void ui_day_item_repeat(void)
 	struct day_item *p;
 	long dur;
 	struct rpt rpt, *r;
+	char *hash;
 	const char *already = _("Already repeated.");
 	const char *cont = _("Press any key to continue.");
 	const char *repetition = _("A (s)imple or (a)dvanced repetition?");
@@ -1357,11 +1384,13 @@ void ui_day_item_repeat(void)
 	LLIST_INIT(&rpt.bymonth);
 	LLIST_INIT(&rpt.bywday);
 	LLIST_INIT(&rpt.bymonthday);
-	LLIST_INIT(&rpt.exc);
+	recur_exc_init(&rpt.exc);
 	r = &rpt;
 	if (!update_rept(p->start, dur, &r, &rpt.exc, simple))
 		return;
 
+	day_occupancy_touch(p);
+	hash = day_item_hash(p);
 	struct day_item d = empty_day;
 	if (p->type == EVNT) {
 		struct event *ev = p->item.ev;
@@ -1375,10 +1404,13 @@ void ui_day_item_repeat(void)
 		if (notify_bar())
 			notify_check_repeated(d.item.rapt);
 	}
+	d.type = p->type == EVNT ? RECUR_EVNT : RECUR_APPT;
 	ui_day_item_cut(REG_BLACK_HOLE);
+	io_journal_update(hash, &d);
+	mem_free(hash);
 	day_set_sel_data(&d);
 	io_set_modified();
-	ui_calendar_monthly_view_cache_set_invalid();
+	day_occupancy_touch(&d);
 }
 
 /* Delete an item and save it in a register. */
@@ -1441,10 +1473,11 @@ void ui_day_item_paste(unsigned reg)
 		return;
 
 	day_item_fork(&day_cut[reg], &day);
-	day_paste_item(&day, ui_day_sel_date());
+	if (day_paste_item(&day, ui_day_sel_date()))
+		io_journal_update(NULL, &day);
 	day_set_sel_data(&day);
 	io_set_modified();
-	ui_calendar_monthly_view_cache_set_invalid();
+	day_occupancy_touch(&day);
 }
 
 void ui_day_load_items(void)
@@ -1597,7 +1630,10 @@ void ui_day_flag(void)
 		return;
 
 	struct day_item *item = ui_day_get_sel();
+	char *hash = day_item_hash(item);
 	day_item_switch_notify(item);
+	io_journal_update(hash, item);
+	mem_free(hash);
 	io_set_modified();
 }
 
@@ -1616,6 +1652,9 @@ void ui_day_edit_note(void)
 		return;
 
 	struct day_item *item = ui_day_get_sel();
+	char *hash = day_item_hash(item);
 	day_edit_note(item, conf.editor);
+	io_journal_update(hash, item);
+	mem_free(hash);
 	io_set_modified();
 }
@@ -133,6 +133,7 @@ void ui_todo_edit(void)
 
 	status_mesg(mesg, "");
 	updatestring(win[STA].p, &item->mesg, 0, 1);
+	item->digest.valid = 0;
 	todo_resort(item);
 	ui_todo_load_items();
 	io_set_modified();
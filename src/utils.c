@@ -49,7 +49,6 @@
 #include <termios.h>
 
 #include "calcurse.h"
-#include "sha1.h"
 
 #define FS_EXT_MAXLEN 64
 
@@ -78,6 +77,8 @@ void exit_calcurse(int status)
 		notify_stop_main_thread();
 		ui_calendar_stop_date_thread();
 		io_stop_psave_thread();
+		if (status == EXIT_SUCCESS)
+			io_journal_compact();
 
 		clear();
 		wins_refresh();
@@ -370,7 +371,7 @@ int get_item_hour(time_t date)
 {
 	struct tm lt;
 
-	localtime_r(&date, &lt);
+	date_localtime(&date, &lt);
 	return lt.tm_hour;
 }
 
@@ -378,7 +379,7 @@ int get_item_min(time_t date)
 {
 	struct tm lt;
 
-	localtime_r(&date, &lt);
+	date_localtime(&date, &lt);
 	return lt.tm_min;
 }
 
@@ -387,7 +388,7 @@ struct tm date2tm(struct date day, unsigned hour, unsigned min)
 	time_t t = now();
 	struct tm start;
 
-	localtime_r(&t, &start);
+	date_localtime(&t, &start);
 
 	start.tm_mon = day.mm - 1;
 	start.tm_mday = day.dd;
@@ -403,7 +404,7 @@ struct tm date2tm(struct date day, unsigned hour, unsigned min)
 time_t date2sec(struct date day, unsigned hour, unsigned min)
 {
 	struct tm start = date2tm(day, hour, min);
-	time_t t = mktime(&start);
+	time_t t = date_mktime(&start);
 
 	EXIT_IF(t == -1, _("failure in mktime"));
 
@@ -416,7 +417,7 @@ struct date sec2date(time_t t)
 	struct tm tm;
 	struct date d;
 
-	localtime_r(&t, &tm);
+	date_localtime(&t, &tm);
 	d.dd = tm.tm_mday;
 	d.mm = tm.tm_mon + 1;
 	d.yyyy = tm.tm_year + 1900;
@@ -436,6 +437,7 @@ time_t tzdate2sec(struct date day, unsigned hour, unsigned min, char *tznew)
 		tzold = mem_strdup(tzold);
 	setenv("TZ", tznew, 1);
 	tzset();
+	date_tz_reset();
 
 	t = date2sec(day, hour, min);
 
@@ -446,6 +448,7 @@ time_t tzdate2sec(struct date day, unsigned hour, unsigned min, char *tznew)
 	    unsetenv("TZ");
 	}
 	tzset();
+	date_tz_reset();
 
 	return t;
 }
@@ -473,8 +476,8 @@ int date_cmp_day(time_t d1, time_t d2)
 {
 	struct tm lt1, lt2;
 
-	localtime_r((time_t *)&d1, &lt1);
-	localtime_r((time_t *)&d2, &lt2);
+	date_localtime((time_t *)&d1, &lt1);
+	date_localtime((time_t *)&d2, &lt2);
 
 	if (lt1.tm_year < lt2.tm_year)
 		return -1;
@@ -531,7 +534,7 @@ int date_change(struct tm *date, int delta_month, int delta_day)
 	t.tm_mon += delta_month;
 	t.tm_mday += delta_day;
 	t.tm_isdst = -1;
-	if (mktime(&t) == -1) {
+	if (date_mktime(&t) == -1) {
 		return 1;
 	} else {
 		t.tm_isdst = -1;
@@ -549,11 +552,11 @@ time_t date_sec_change(time_t date, int delta_month, int delta_day)
 	time_t t;
 
 	t = date;
-	localtime_r(&t, &lt);
+	date_localtime(&t, &lt);
 	lt.tm_mon += delta_month;
 	lt.tm_mday += delta_day;
 	lt.tm_isdst = -1;
-	t = mktime(&lt);
+	t = date_mktime(&lt);
 	EXIT_IF(t == -1, _("failure in mktime"));
 
 	return t;
@@ -566,12 +569,12 @@ static time_t update_date_in_date(time_t date, int day, int month, int year)
 {
 	struct tm lt;
 
-	localtime_r(&date, &lt);
+	date_localtime(&date, &lt);
 	lt.tm_mday = day;
 	lt.tm_mon = month - 1;
 	lt.tm_year = year - 1900;
 	lt.tm_isdst = -1;
-	date = mktime(&lt);
+	date = date_mktime(&lt);
 	EXIT_IF(date == -1, _("error in mktime"));
 
 	return date;
@@ -584,12 +587,12 @@ time_t update_time_in_date(time_t date, unsigned hr, unsigned mn)
 {
 	struct tm lt;
 
-	localtime_r(&date, &lt);
+	date_localtime(&date, &lt);
 	lt.tm_hour = hr;
 	lt.tm_min = mn;
 	lt.tm_sec = 0;
 	lt.tm_isdst = -1;
-	date = mktime(&lt);
+	date = date_mktime(&lt);
 	EXIT_IF(date == -1, _("error in mktime"));
 
 	return date;
@@ -733,7 +736,7 @@ time_t get_today(void)
 	struct date day;
 
 	current_time = time(NULL);
-	localtime_r(&current_time, &lt);
+	date_localtime(&current_time, &lt);
 	day.mm = lt.tm_mon + 1;
 	day.dd = lt.tm_mday;
 	day.yyyy = lt.tm_year + 1900;
@@ -846,7 +849,7 @@ static void get_ymd(int *year, int *month, int *day, time_t t)
 {
 	struct tm tm;
 
-	localtime_r(&t, &tm);
+	date_localtime(&t, &tm);
 	*day = tm.tm_mday;
 	*month = tm.tm_mon + 1;
 	*year = tm.tm_year + 1900;
@@ -858,11 +861,11 @@ static void get_weekday_ymd(int *year, int *month, int *day, int weekday)
 	struct tm tm;
 	int delta;
 
-	localtime_r(&t, &tm);
+	date_localtime(&t, &tm);
 	delta = weekday - tm.tm_wday;
 	t = date_sec_change(t, 0, delta > 0 ? delta : 7);
 
-	localtime_r(&t, &tm);
+	date_localtime(&t, &tm);
 	*day = tm.tm_mday;
 	*month = tm.tm_mon + 1;
 	*year = tm.tm_year + 1900;
@@ -885,7 +888,7 @@ int check_date(unsigned year, unsigned month, unsigned day)
 int check_sec(time_t *time)
 {
 	struct tm tm;
-	localtime_r(time, &tm);
+	date_localtime(time, &tm);
 	return check_date(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
 }
 
@@ -2040,6 +2043,57 @@ int hash_matches(const char *pattern, const char *hash)
 	return (starts_with(hash, pattern) != invert);
 }
 
+static const char xdigits[] = "0123456789abcdef";
+
+/* Set the digest of an item from its text representation, and free the text. */
+void item_digest_compute(struct item_digest *d, char *raw)
+{
+	sha1_ctx_t ctx;
+
+	sha1_init(&ctx);
+	sha1_update(&ctx, (uint8_t *)raw, strlen(raw));
+	sha1_final(&ctx, d->sha1);
+	d->valid = 1;
+	mem_free(raw);
+}
+
+/* Return the hash of an item, in hexadecimal, from its digest. */
+char *item_digest_hex(struct item_digest *d)
+{
+	char *hash = mem_malloc(sizeof(d->sha1) * 2 + 1);
+	unsigned i;
+
+	for (i = 0; i < sizeof(d->sha1); i++) {
+		hash[2 * i] = xdigits[d->sha1[i] >> 4];
+		hash[2 * i + 1] = xdigits[d->sha1[i] & 0xf];
+	}
+	hash[2 * i] = '\0';
+
+	return hash;
+}
+
+/* Same as hash_matches(), without converting the digest to a string. */
+int item_digest_matches(const char *pattern, struct item_digest *d)
+{
+	int invert = 0;
+	unsigned i, nibble;
+
+	if (pattern[0] == '!') {
+		invert = 1;
+		pattern++;
+	}
+
+	for (i = 0; pattern[i]; i++) {
+		if (i >= sizeof(d->sha1) * 2)
+			return invert;
+		nibble = i % 2 ? d->sha1[i / 2] & 0xf : d->sha1[i / 2] >> 4;
+		if (pattern[i] != xdigits[nibble])
+			return invert;
+	}
+
+	return !invert;
+}
+
 /*
  * Overflow check for addition with positive second term.
  */
@@ -2081,7 +2135,7 @@ time_t next_wday(time_t day, int weekday)
 {
 	struct tm tm;
 
-	localtime_r(&day, &tm);
+	date_localtime(&day, &tm);
 	return date_sec_change(
 		day, 0, (weekday - tm.tm_wday + WEEKINDAYS) % WEEKINDAYS
 	);
@@ -2093,19 +2147,12 @@ time_t next_wday(time_t day, int weekday)
  */
 int wday_per_year(int year, int weekday)
 {
-	struct tm y_end;
-	struct date day;
+	long n = days_from_civil(year, 12, 31);
 	int last_wday;
 
-	/* Find weekday and yearday of the last day of the year.  */
-	day.dd = 31;
-	day.mm = 12;
-	day.yyyy = year;
-	y_end = date2tm(day, 0, 0);
-	mktime(&y_end);
-
 	/* Find date of the last weekday of the year. */
-	last_wday = (y_end.tm_yday + 1) - (y_end.tm_wday - weekday + 7) % 7;
+	last_wday = (n - days_from_civil(year, 1, 1) + 1) -
+		    (wday_from_days(n) - weekday + 7) % 7;
 
 	return last_wday / 7 + (last_wday % 7 > 0);
 }
@@ -2115,23 +2162,299 @@ int wday_per_year(int year, int weekday)
  */
 int wday_per_month(int month, int year, int weekday)
 {
-	struct tm m_end;
-	struct date day;
 	int last_wday, m_days = days[month - 1] + (month == 2 && ISLEAP(year) ? 1 : 0);
 
-	/* Find weekday of the last day of the month. */
-	day.dd = m_days;
-	day.mm = month;
-	day.yyyy = year;
-	m_end = date2tm(day, 0, 0);
-	mktime(&m_end);
-
 	/* Find date of the last weekday of the month. */
-	last_wday = m_days - (m_end.tm_wday - weekday + 7) % 7;
+	last_wday = m_days -
+		    (wday_from_days(days_from_civil(year, month, m_days)) -
+		     weekday + 7) % 7;
 
 	return last_wday / 7 + (last_wday % 7 > 0);
 }
 
+/*
+ * Return the number of days from 1970-01-01 to the given (proleptic Gregorian)
+ * date. The month is in the range 1-12.
+ */
+long days_from_civil(int year, int month, int day)
+{
+	long era, yoe, doy;
+
+	year -= month <= 2;
+	era = (year >= 0 ? year : year - 399) / 400;
+	yoe = year - era * 400;
+	doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+
+	return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+/*
+ * Inverse of days_from_civil(): convert a number of days since 1970-01-01 to
+ * a (proleptic Gregorian) date.
+ */
+void civil_from_days(long n, int *year, int *month, int *day)
+{
+	long era, doe, yoe, doy, mp;
+
+	n += 719468;
+	era = (n >= 0 ? n : n - 146096) / 146097;
+	doe = n - era * 146097;
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	mp = (5 * doy + 2) / 153;
+
+	*day = doy - (153 * mp + 2) / 5 + 1;
+	*month = mp < 10 ? mp + 3 : mp - 9;
+	*year = yoe + era * 400 + (*month <= 2);
+}
+
+/* Return the weekday (0 is Sunday) of a number of days since 1970-01-01. */
+int wday_from_days(long n)
+{
+	return ((n + 4) % WEEKINDAYS + WEEKINDAYS) % WEEKINDAYS;
+}
+
+/*
+ * Local time is computed with integer arithmetic from the UTC offset. The
+ * offsets are cached as spans of time with a constant offset, in ascending
+ * order; the C library is only asked when a time outside the known spans is
+ * converted. The cache must be reset whenever TZ changes, see date_tz_reset().
+ *
+ * The C library does not tell when the offset changes, so the end of a span
+ * is searched for by asking for the offset a day later, and so on. This
+ * assumes that every offset is in force for at least a day: an offset that
+ * changes and changes back within a day may be missed, and the times in
+ * between converted with the offset on either side of them.
+ */
+struct tz_span {
+	time_t start;		/* first second of the span */
+	time_t end;		/* first second after the span */
+	long off;		/* local time minus UTC, in seconds */
+	int isdst;
+};
+
+/* How far from the time converted a span is searched for at most. */
+#define TZ_HORIZON	(53 * WEEKINSEC)
+
+static struct tz_span *tz_spans;
+static unsigned tz_count, tz_size, tz_last;
+static pthread_mutex_t tz_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Ask the C library for the UTC offset at t. */
+static long tz_probe(time_t t, int *isdst)
+{
+	struct tm tm;
+
+	if (!localtime_r(&t, &tm)) {
+		*isdst = 0;
+		return 0;
+	}
+	*isdst = tm.tm_isdst > 0;
+	return days_from_civil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday) *
+	       DAYINSEC + tm.tm_hour * HOURINSEC + tm.tm_min * MININSEC +
+	       tm.tm_sec - (long)t;
+}
+
+static int tz_same(time_t t, long off, int isdst)
+{
+	int d;
+
+	return tz_probe(t, &d) == off && d == isdst;
+}
+
+/*
+ * Return the span containing t, adding it to the cache if needed. The caller
+ * must hold tz_mutex, and the span is only valid until the next call.
+ */
+static struct tz_span *tz_find(time_t t)
+{
+	unsigned lo = 0, hi = tz_count, mid;
+	time_t start, end, lim, a, b, m;
+	long off;
+	int isdst;
+
+	if (tz_last < tz_count && tz_spans[tz_last].start <= t &&
+	    t < tz_spans[tz_last].end)
+		return &tz_spans[tz_last];
+
+	/* Find the first span starting after t. */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (tz_spans[mid].start <= t)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo > 0 && t < tz_spans[lo - 1].end) {
+		tz_last = lo - 1;
+		return &tz_spans[tz_last];
+	}
+
+	if (!tz_count)
+		tzset();
+	off = tz_probe(t, &isdst);
+
+	/* Search forwards for the first second with another offset. */
+	lim = t + TZ_HORIZON;
+	if (lo < tz_count && tz_spans[lo].start < lim)
+		lim = tz_spans[lo].start;
+	for (a = t;; a = b) {
+		b = lim - a > DAYINSEC ? a + DAYINSEC : lim;
+		if (!tz_same(b, off, isdst)) {
+			while (b - a > 1) {
+				m = a + (b - a) / 2;
+				if (tz_same(m, off, isdst))
+					a = m;
+				else
+					b = m;
+			}
+			break;
+		}
+		if (b == lim)
+			break;
+	}
+	end = b;
+
+	/* Search backwards for the first second with this offset. */
+	lim = t - TZ_HORIZON;
+	if (lo > 0 && tz_spans[lo - 1].end > lim)
+		lim = tz_spans[lo - 1].end;
+	for (b = t;; b = a) {
+		a = b - lim > DAYINSEC ? b - DAYINSEC : lim;
+		if (!tz_same(a, off, isdst)) {
+			while (b - a > 1) {
+				m = a + (b - a) / 2;
+				if (tz_same(m, off, isdst))
+					b = m;
+				else
+					a = m;
+			}
+			a = b;
+			break;
+		}
+		if (a == lim)
+			break;
+	}
+	start = a;
+
+	if (tz_count == tz_size) {
+		tz_size = tz_size ? 2 * tz_size : 8;
+		if (tz_spans)
+			tz_spans = mem_realloc(tz_spans, tz_size,
+					       sizeof(struct tz_span));
+		else
+			tz_spans = mem_malloc(tz_size *
+					      sizeof(struct tz_span));
+	}
+	memmove(tz_spans + lo + 1, tz_spans + lo,
+		(tz_count - lo) * sizeof(struct tz_span));
+	tz_spans[lo].start = start;
+	tz_spans[lo].end = end;
+	tz_spans[lo].off = off;
+	tz_spans[lo].isdst = isdst;
+	tz_count++;
+	tz_last = lo;
+
+	return &tz_spans[lo];
+}
+
+/* Forget the cached UTC offsets, e.g. after a change of TZ. */
+void date_tz_reset(void)
+{
+	pthread_mutex_lock(&tz_mutex);
+	tz_count = tz_last = 0;
+	pthread_mutex_unlock(&tz_mutex);
+}
+
+/*
+ * Replacement for localtime_r(). The fields tm_gmtoff and tm_zone are not
+ * set, hence the result must not be used with strftime("%z") or "%Z".
+ */
+void date_localtime(const time_t *t, struct tm *tm)
+{
+	struct tz_span *sp;
+	long secs, n;
+	int isdst, year, month, day;
+
+	pthread_mutex_lock(&tz_mutex);
+	sp = tz_find(*t);
+	secs = (long)*t + sp->off;
+	isdst = sp->isdst;
+	pthread_mutex_unlock(&tz_mutex);
+
+	n = secs >= 0 ? secs / DAYINSEC : -((DAYINSEC - 1 - secs) / DAYINSEC);
+	secs -= n * DAYINSEC;
+	civil_from_days(n, &year, &month, &day);
+
+	memset(tm, 0, sizeof(struct tm));
+	tm->tm_year = year - 1900;
+	tm->tm_mon = month - 1;
+	tm->tm_mday = day;
+	tm->tm_hour = secs / HOURINSEC;
+	tm->tm_min = secs % HOURINSEC / MININSEC;
+	tm->tm_sec = secs % MININSEC;
+	tm->tm_wday = wday_from_days(n);
+	tm->tm_yday = n - days_from_civil(year, 1, 1);
+	tm->tm_isdst = isdst;
+}
+
+/*
+ * Replacement for mktime(). Out-of-range fields are normalized. A local time
+ * that occurs twice is resolved with tm_isdst if that tells the two apart,
+ * otherwise the earlier one is taken. A local time skipped by a change of
+ * offset is interpreted with the offset before the change. As with mktime(),
+ * -1 is returned if the year cannot be represented.
+ */
+time_t date_mktime(struct tm *tm)
+{
+	struct tz_span *sp;
+	long secs, offa, offb;
+	long long y;
+	time_t ta, tb, t;
+	int year, mon, q, valida, validb, dsta, dstb;
+
+	mon = tm->tm_mon;
+	q = mon >= 0 ? mon / YEARINMONTHS : -((YEARINMONTHS - 1 - mon) /
+					       YEARINMONTHS);
+	y = (long long)tm->tm_year + 1900 + q;
+	if (YEAR1902_2037 ? y < 1902 || y > 2037 :
+	    y < (long long)INT_MIN + 1900 || y > INT_MAX)
+		return -1;
+	year = y;
+	mon -= q * YEARINMONTHS;
+	secs = (days_from_civil(year, mon + 1, 1) + tm->tm_mday - 1) *
+	       DAYINSEC + (long)tm->tm_hour * HOURINSEC +
+	       (long)tm->tm_min * MININSEC + tm->tm_sec;
+
+	/* Try the offsets in force a day before and a day after. */
+	pthread_mutex_lock(&tz_mutex);
+	offa = tz_find(secs - DAYINSEC)->off;
+	offb = tz_find(secs + DAYINSEC)->off;
+	ta = secs - offa;
+	tb = secs - offb;
+	sp = tz_find(ta);
+	valida = sp->off == offa;
+	dsta = sp->isdst;
+	sp = tz_find(tb);
+	validb = sp->off == offb;
+	dstb = sp->isdst;
+	pthread_mutex_unlock(&tz_mutex);
+
+	if (valida && validb && ta != tb) {
+		if (tm->tm_isdst >= 0 && dsta != dstb)
+			t = dsta == (tm->tm_isdst > 0) ? ta : tb;
+		else
+			t = ta < tb ? ta : tb;
+	} else if (validb) {
+		t = tb;
+	} else {
+		t = ta;
+	}
+
+	date_localtime(&t, tm);
+	return t;
+}
+
 /*
  * Return allocated string with day of 't' inserted in 'template' in the user's
  * preferred format; template must be a "printf" template with exactly one
@@ -2146,3 +2469,66 @@ char *day_ins(char **template, time_t t)
 	mem_free(day);
 	return msg;
 }
+
+/*
+ * Helpers to scan the fields of a line of a data file, as an alternative to
+ * the locale-sensitive scanf() family. The line must be NUL-terminated; the
+ * cursor is advanced past whatever was recognized.
+ */
+
+/* Skip blank characters. */
+void scan_blank(char **s)
+{
+	while (**s == ' ' || **s == '\t' || **s == '\r' || **s == '\v' ||
+	       **s == '\f')
+		(*s)++;
+}
+
+/* Scan a decimal integer with an optional sign, after optional blanks. */
+int scan_int(char **s, int *v)
+{
+	char *p;
+	long n = 0;
+	int neg = 0;
+
+	scan_blank(s);
+	p = *s;
+	if (*p == '+' || *p == '-')
+		neg = *p++ == '-';
+	if (*p < '0' || *p > '9')
+		return 0;
+	for (; *p >= '0' && *p <= '9'; p++) {
+		if (n <= INT_MAX)
+			n = n * 10 + (*p - '0');
+	}
+	if (n > INT_MAX)
+		n = INT_MAX;
+	*v = neg ? -n : n;
+	*s = p;
+
+	return 1;
+}
+
+/* Match a literal string, after optional blanks. */
+int scan_literal(char **s, const char *lit)
+{
+	size_t len = strlen(lit);
+
+	scan_blank(s);
+	if (strncmp(*s, lit, len))
+		return 0;
+	*s += len;
+
+	return 1;
+}
+
+/* Scan a date in the "mm/dd/yyyy" format, followed by optional blanks. */
+int scan_date(char **s, int *month, int *day, int *year)
+{
+	if (!scan_int(s, month) || !scan_literal(s, "/") ||
+	    !scan_int(s, day) || !scan_literal(s, "/") || !scan_int(s, year))
+		return 0;
+	scan_blank(s);
+
+	return 1;
+}
@@ -88,6 +88,9 @@ char *path_notes = NULL;
 char *path_keys = NULL;
 char *path_cpid = NULL;
 char *path_dpid = NULL;
+char *path_dsock = NULL;
+char *path_snap = NULL;
+char *path_journal = NULL;
 char *path_dmon_log = NULL;
 char *path_hooks = NULL;
 
@@ -133,6 +136,8 @@ void vars_init(void)
 	conf.auto_save = 1;
 	conf.auto_gc = 0;
 	conf.periodic_save = 0;
+	conf.load_threads = 0;
+	conf.journal = 0;
 	conf.systemevents = 1;
 	conf.default_panel = CAL;
 	conf.compact_panels = 0;
@@ -0,0 +1,9 @@
+#!/bin/sh
+# Lines of items outside the query days are checked too.
+
+. "${TEST_INIT:-./test-init.sh}"
+
+"$CALCURSE" --read-only -D "$DATA_DIR"/ -c "$DATA_DIR/apts-appointment-020" \
+  -Q --from 10/20/2012 --days 60 2>errors && exit 1
+grep -Fq 'syntax error in item state' errors
+rm -f errors
@@ -0,0 +1,12 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  "$CALCURSE" --read-only -D "$DATA_DIR"/ --client -Q --from 01/01/1980 \
+    --days 366
+elif [ "$1" = 'expected' ]; then
+  "$CALCURSE" --read-only -D "$DATA_DIR"/ -Q --from 01/01/1980 --days 366
+else
+  ./run-test "$0"
+fi
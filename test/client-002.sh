@@ -0,0 +1,44 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+query() {
+  TZ="$1" "$CALCURSE" --read-only -D "$tmpdir" $2 -Q --filter-type cal \
+    --from 01/01/1980 --days 366
+}
+
+if [ "$1" = 'actual' ]; then
+  tmpdir=$(mktemp -d)
+  cp "$DATA_DIR"/apts "$DATA_DIR"/todo "$tmpdir"
+  sed '/^daemon\.log=/d' "$DATA_DIR"/conf >"$tmpdir"/conf
+  printf 'daemon.socket=yes\ndaemon.log=yes\n' >>"$tmpdir"/conf
+  TZ=UTC "$CALCURSE" -D "$tmpdir" --daemon
+  i=0
+  while [ ! -S "$tmpdir"/.daemon.sock ] && [ "$i" -lt 50 ]; do
+    sleep 0.1
+    i=$((i + 1))
+  done
+
+  query UTC --client
+  query America/New_York --client
+  grep -c 'answering a query' "$tmpdir"/daemon.log
+  grep -c 'declining a query' "$tmpdir"/daemon.log
+
+  kill "$(cat "$tmpdir"/.daemon.pid)"
+  i=0
+  while [ -f "$tmpdir"/.daemon.pid ] && [ "$i" -lt 50 ]; do
+    sleep 0.1
+    i=$((i + 1))
+  done
+  rm -rf "$tmpdir"
+elif [ "$1" = 'expected' ]; then
+  tmpdir=$(mktemp -d)
+  cp "$DATA_DIR"/apts "$DATA_DIR"/conf "$DATA_DIR"/todo "$tmpdir"
+  query UTC
+  query America/New_York
+  echo 2
+  echo 1
+  rm -rf "$tmpdir"
+else
+  ./run-test "$0"
+fi
@@ -0,0 +1,29 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  "$CALCURSE" --read-only -D "$DATA_DIR"/ -c "$DATA_DIR/apts-filter-001" -G \
+    --filter-type cal --filter-start-from 02/23/2013 --filter-end-to 02/24/2013
+  "$CALCURSE" --read-only -D "$DATA_DIR"/ -c "$DATA_DIR/apts-filter-001" -G \
+    --filter-pattern 'Event.4?'
+  "$CALCURSE" --read-only -D "$DATA_DIR"/ -c "$DATA_DIR/apts-filter-001" -G \
+    --filter-type apt --filter-pattern '^App'
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+02/23/2013 @ 10:00 -> 02/23/2013 @ 12:00|Appointment 2
+02/24/2013 @ 10:00 -> 02/24/2013 @ 12:00|Appointment 3
+02/23/2013 [1] Event 2
+02/24/2013 [1] Event 3
+02/22/2013 [1] Event 1
+02/23/2013 [1] Event 2
+02/24/2013 [1] Event 3
+02/25/2013 [1] Event 4
+02/22/2013 @ 10:00 -> 02/22/2013 @ 12:00|Appointment 1
+02/23/2013 @ 10:00 -> 02/23/2013 @ 12:00|Appointment 2
+02/24/2013 @ 10:00 -> 02/24/2013 @ 12:00|Appointment 3
+02/25/2013 @ 10:00 -> 02/25/2013 @ 12:00|Appointment 4
+EOD
+else
+  ./run-test "$0"
+fi
@@ -0,0 +1,8 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+"$CALCURSE" --read-only -D "$DATA_DIR"/ -c "$DATA_DIR/apts-appointment-020" \
+  -G --filter-pattern 'Event' 2>errors && exit 1
+grep -Fq 'syntax error in item state' errors
+rm -f errors
@@ -0,0 +1,39 @@
+#!/bin/sh
+# A large appointment file is loaded the same way with several threads as
+# with one, and errors are reported with the right line number.
+
+. "${TEST_INIT:-./test-init.sh}"
+dir=$(mktemp -d)
+failed=0
+
+awk 'BEGIN {
+  for (i = 0; i < 12000; i++) {
+    d = sprintf("%02d/%02d/%04d", i % 12 + 1, i % 28 + 1, 2000 + i % 20)
+    if (i % 4 == 0)
+      printf("%s [1] >%040d event %d\n", d, i % 7, i % 50)
+    else if (i % 4 == 1)
+      printf("%s @ 10:00 -> %s @ 11:00 >%040d |appointment %d\n", \
+             d, d, i % 7, i % 50)
+    else if (i % 4 == 2)
+      printf("%s [1] {1W} recurrent event %d\n", d, i % 50)
+    else
+      printf("%s @ 08:30 -> %s @ 09:00 {2D !01/01/2030} !recurrent %d\n", \
+             d, d, i % 50)
+  }
+}' > "$dir/apts"
+touch "$dir/todo"
+
+echo 'general.loadthreads=1' > "$dir/conf"
+"$CALCURSE" --read-only -D "$dir" -G > "$dir/serial" || failed=1
+echo 'general.loadthreads=4' > "$dir/conf"
+"$CALCURSE" --read-only -D "$dir" -G > "$dir/threaded" || failed=1
+cmp -s "$dir/serial" "$dir/threaded" || failed=1
+[ "$(wc -l < "$dir/serial")" -eq 12000 ] || failed=1
+
+sed '11000s/@ 08:30/@ 08h30/' "$dir/apts" > "$dir/apts.new"
+mv "$dir/apts.new" "$dir/apts"
+"$CALCURSE" --read-only -D "$dir" -G 2>&1 >/dev/null | \
+  grep -q "apts:11000: syntax error in item time or duration" || failed=1
+
+rm -rf "$dir"
+exit "$failed"
@@ -0,0 +1,37 @@
+#!/bin/sh
+# The appointment snapshot gives the same items as the appointment file and
+# is not used once the file changed, even with the same size and time, or in
+# another time zone.
+
+. "${TEST_INIT:-./test-init.sh}"
+dir=$(mktemp -d)
+failed=0
+
+cat > "$dir/apts" <<EOD
+01/02/2024 [1] {1W} weekly event
+01/03/2024 @ 10:00 -> 01/03/2024 @ 11:00 {2D !01/31/2024} |recurrent one
+01/04/2024 [1] >0123456789012345678901234567890123456789 single event
+01/05/2024 @ 08:30 -> 01/05/2024 @ 09:00 |appointment one
+EOD
+touch "$dir/todo"
+
+"$CALCURSE" --read-only -D "$dir" -G > "$dir/text" || failed=1
+[ ! -e "$dir/.apts.snapshot" ] || failed=1
+"$CALCURSE" -D "$dir" -G > "$dir/first" || failed=1
+[ -e "$dir/.apts.snapshot" ] || failed=1
+"$CALCURSE" -D "$dir" -G > "$dir/second" || failed=1
+cmp -s "$dir/text" "$dir/first" || failed=1
+cmp -s "$dir/text" "$dir/second" || failed=1
+
+TZ=Asia/Tokyo "$CALCURSE" --read-only -D "$dir" -G > "$dir/text" || failed=1
+TZ=Asia/Tokyo "$CALCURSE" -D "$dir" -G > "$dir/zone" || failed=1
+cmp -s "$dir/text" "$dir/zone" || failed=1
+
+mtime=$(date -r "$dir/apts" +%s)
+sed 's/appointment one/appointment two/' "$dir/apts" > "$dir/apts.new"
+mv "$dir/apts.new" "$dir/apts"
+touch -d "@$mtime" "$dir/apts"
+"$CALCURSE" -D "$dir" -G | grep -q 'appointment two' || failed=1
+
+rm -rf "$dir"
+exit "$failed"
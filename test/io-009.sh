@@ -0,0 +1,37 @@
+#!/bin/sh
+# Changes appended to the appointment journal are applied on load, while a
+# torn last entry or a journal written for another appointment file is not.
+
+. "${TEST_INIT:-./test-init.sh}"
+dir=$(mktemp -d)
+failed=0
+
+cat > "$dir/apts" <<EOD
+01/04/2024 [1] single event
+01/05/2024 @ 08:30 -> 01/05/2024 @ 09:00 |appointment one
+EOD
+touch "$dir/todo"
+
+sha1=$(sha1sum < "$dir/apts" | cut -d' ' -f1)
+del=$(printf '%s' '01/04/2024 [1] single event' | sha1sum | cut -d' ' -f1)
+cat > "$dir/apts.journal" <<EOD
+calcurse journal $sha1
++01/06/2024 [1] added event
+-$del
+EOD
+printf '+01/07/2024 [1] torn event' >> "$dir/apts.journal"
+
+cat > "$dir/expected" <<EOD
+01/05/2024 @ 08:30 -> 01/05/2024 @ 09:00|appointment one
+01/06/2024 [1] added event
+EOD
+"$CALCURSE" --read-only -D "$dir" -G > "$dir/out" || failed=1
+cmp -s "$dir/expected" "$dir/out" || failed=1
+"$CALCURSE" -D "$dir" -G > "$dir/out" || failed=1
+cmp -s "$dir/expected" "$dir/out" || failed=1
+
+echo '01/08/2024 [1] another event' >> "$dir/apts"
+"$CALCURSE" --read-only -D "$dir" -G | grep -q 'added event' && failed=1
+
+rm -rf "$dir"
+exit "$failed"
@@ -0,0 +1,49 @@
+#!/bin/sh
+# Items deleted with -F and -P in journal mode are appended to the journal as
+# deletions, and a torn deletion leaves its item in place. So does a torn edit,
+# whose new item is written before the deletion of the old one.
+
+. "${TEST_INIT:-./test-init.sh}"
+dir=$(mktemp -d)
+failed=0
+
+cat > "$dir/apts" <<EOD
+01/04/2024 [1] event one
+01/05/2024 @ 08:30 -> 01/05/2024 @ 09:00 |appointment two
+01/06/2024 [1] event three
+EOD
+cp "$dir/apts" "$dir/apts.orig"
+touch "$dir/todo"
+echo 'general.journal=yes' > "$dir/conf"
+
+"$CALCURSE" -D "$dir" -F --filter-pattern 'one|three' || failed=1
+"$CALCURSE" -D "$dir" -P --filter-pattern 'three' || failed=1
+cmp -s "$dir/apts" "$dir/apts.orig" || failed=1
+[ "$(grep -c '^-' "$dir/apts.journal")" = 2 ] || failed=1
+
+echo '01/04/2024 [1] event one' > "$dir/expected"
+"$CALCURSE" --read-only -D "$dir" -G > "$dir/out" || failed=1
+cmp -s "$dir/expected" "$dir/out" || failed=1
+
+cp "$dir/apts.journal" "$dir/journal"
+head -c -2 "$dir/journal" > "$dir/apts.journal"
+cat > "$dir/expected" <<EOD
+01/04/2024 [1] event one
+01/06/2024 [1] event three
+EOD
+"$CALCURSE" --read-only -D "$dir" -G > "$dir/out" || failed=1
+cmp -s "$dir/expected" "$dir/out" || failed=1
+
+del=$(printf '%s' '01/04/2024 [1] event one' | sha1sum | cut -d' ' -f1)
+cp "$dir/journal" "$dir/apts.journal"
+echo '+01/04/2024 [1] event one, edited' >> "$dir/apts.journal"
+printf '%s' "-$del" | head -c 20 >> "$dir/apts.journal"
+cat > "$dir/expected" <<EOD
+01/04/2024 [1] event one
+01/04/2024 [1] event one, edited
+EOD
+"$CALCURSE" --read-only -D "$dir" -G > "$dir/out" || failed=1
+cmp -s "$dir/expected" "$dir/out" || failed=1
+
+rm -rf "$dir"
+exit "$failed"
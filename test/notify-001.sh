@@ -0,0 +1,52 @@
+#!/bin/sh
+# The daemon reminds of an appointment added after another one it already
+# reminded of, even if the new appointment starts first.
+
+. "${TEST_INIT:-./test-init.sh}"
+
+apt() {
+  start=$(date -d "@$1" '+%m/%d/%Y @ %H:%M')
+  echo "$start -> $start !$2"
+}
+
+wait_log() {
+  i=0
+  while ! grep -q "$1" "$tmpdir"/daemon.log 2>/dev/null && [ "$i" -lt 50 ]; do
+    sleep 0.1
+    i=$((i + 1))
+  done
+}
+
+if [ "$1" = 'actual' ]; then
+  tmpdir=$(mktemp -d)
+  now=$(date +%s)
+  apt $((now + 180)) 'later appointment' >"$tmpdir"/apts
+  cp "$DATA_DIR"/todo "$tmpdir"
+  cat >"$tmpdir"/conf <<EOD
+daemon.log=yes
+notification.command=true
+notification.warning=3600
+EOD
+  "$CALCURSE" -D "$tmpdir" --daemon
+  wait_log 'for: "later appointment"'
+
+  apt $((now + 120)) 'earlier appointment' >>"$tmpdir"/apts
+  kill -USR1 "$(cat "$tmpdir"/.daemon.pid)"
+  wait_log 'for: "earlier appointment"'
+  grep -o 'for: ".*"' "$tmpdir"/daemon.log
+
+  kill "$(cat "$tmpdir"/.daemon.pid)"
+  i=0
+  while [ -f "$tmpdir"/.daemon.pid ] && [ "$i" -lt 50 ]; do
+    sleep 0.1
+    i=$((i + 1))
+  done
+  rm -rf "$tmpdir"
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+for: "later appointment"
+for: "earlier appointment"
+EOD
+else
+  ./run-test "$0"
+fi
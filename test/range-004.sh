@@ -0,0 +1,42 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  "$CALCURSE" --read-only -D "$DATA_DIR"/ -c "$DATA_DIR/apts-range-004" \
+    -d02/23/2013
+  "$CALCURSE" --read-only -D "$DATA_DIR"/ -c "$DATA_DIR/apts-range-004" \
+    -s02/22/2013 -r2
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+02/23/13:
+ * Monthly event
+ - ..:.. -> 09:00
+	Long appointment
+ - ..:.. -> 01:00
+	Last night
+ - 18:00 -> 19:00
+	Appointment
+ - 22:00 -> ..:..
+	Weekly appointment
+02/22/13:
+ * Ended event
+ - ..:.. -> ..:..
+	Long appointment
+ - 22:00 -> ..:..
+	Last night
+
+02/23/13:
+ * Monthly event
+ - ..:.. -> 09:00
+	Long appointment
+ - ..:.. -> 01:00
+	Last night
+ - 18:00 -> 19:00
+	Appointment
+ - 22:00 -> ..:..
+	Weekly appointment
+EOD
+else
+  ./run-test "$0"
+fi
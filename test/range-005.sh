@@ -0,0 +1,54 @@
+#!/bin/sh
+# Items stay on their day in a long range crossing a skipped midnight (Lord
+# Howe Island, 1 March 1981) or a skipped day (Samoa, 30 December 2011).
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  TZ='Australia/Lord_Howe' "$CALCURSE" --read-only -D "$DATA_DIR"/ \
+    -c "$DATA_DIR/apts-recur" -Q --filter-type cal \
+    --from 01/01/1981 --to 01/03/2000
+  TZ='Pacific/Apia' "$CALCURSE" --read-only -D "$DATA_DIR"/ \
+    -c "$DATA_DIR/apts-recur" -Q --filter-type recur-event \
+    --from 12/29/2011 --to 12/31/2011
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+01/01/00:
+ * Each Saturday since 2000-01-01
+ * Each day since 2000-01-01
+ * Each first day of the month since 2000-01-01
+ * Every 28 days since 2000-01-01
+ * Every second day since 2000-01-01
+ * Every three days in year 2000
+ * Every three days, but not on 2000-01-04
+ * Every year on January, 1st since year 2000
+ * Same as "01/01/2000 [1] {1W}"
+ - 00:00 -> ..:..
+	Another recurrent appointment
+ - 00:00 -> ..:..
+	Third recurrent appointment
+ - 16:00 -> ..:..
+	Recurrent appointment
+
+01/02/00:
+ * Each day since 2000-01-01
+ - ..:.. -> ..:..
+	Another recurrent appointment
+ - ..:.. -> 02:00
+	Recurrent appointment
+ - 00:00 -> ..:..
+	Third recurrent appointment
+12/29/11:
+ * Each day since 2000-01-01
+ * Every second day since 2000-01-01
+ * Every three days, but not on 2000-01-04
+
+12/31/11:
+ * Each Saturday since 2000-01-01
+ * Each day since 2000-01-01
+ * Every second day since 2000-01-01
+ * Same as "01/01/2000 [1] {1W}"
+EOD
+else
+  ./run-test "$0"
+fi
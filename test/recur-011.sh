@@ -0,0 +1,34 @@
+#!/bin/sh
+# A multi-day occurrence continues on the following day even if that day is
+# an exception or lies past the end of the recurrence.
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  "$CALCURSE" --read-only -D "$DATA_DIR"/ -c "$DATA_DIR"/apts-recur-011 -Q \
+    --filter-type recur-apt --from 03/01/2021 --to 03/06/2021
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+03/01/21:
+ - 18:00 -> ..:..
+	night shift
+
+03/02/21:
+ - ..:.. -> 06:00
+	night shift
+
+03/03/21:
+ - 18:00 -> ..:..
+	night shift
+
+03/04/21:
+ - 18:00 -> ..:..
+	night shift
+
+03/05/21:
+ - ..:.. -> 06:00
+	night shift
+EOD
+else
+  ./run-test "$0"
+fi
@@ -0,0 +1,50 @@
+#!/bin/sh
+# Overlapping multi-day occurrences across a skipped midnight (Lord Howe
+# Island, 1 March 1981): only the most recent occurrence is shown on a day,
+# and items stay on their day after the change of offset.
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  TZ='Australia/Lord_Howe' "$CALCURSE" --read-only -D "$DATA_DIR"/ \
+    -c "$DATA_DIR"/apts-recur-012 -Q --filter-type recur-apt \
+    --from 02/26/1981 --to 03/04/1981
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+02/26/81:
+ - 00:15 -> ..:..
+	every other day, lasting three days
+
+02/27/81:
+ - ..:.. -> ..:..
+	every other day, lasting three days
+ - 18:00 -> ..:..
+	daily, lasting 36 hours
+
+02/28/81:
+ - 00:15 -> ..:..
+	every other day, lasting three days
+ - 18:00 -> ..:..
+	daily, lasting 36 hours
+
+03/01/81:
+ - ..:.. -> ..:..
+	every other day, lasting three days
+ - 18:00 -> ..:..
+	daily, lasting 36 hours
+
+03/02/81:
+ - 00:15 -> ..:..
+	every other day, lasting three days
+ - 18:00 -> ..:..
+	daily, lasting 36 hours
+
+03/03/81:
+ - ..:.. -> ..:..
+	every other day, lasting three days
+ - 18:00 -> ..:..
+	daily, lasting 36 hours
+EOD
+else
+  ./run-test "$0"
+fi